@@ -35,17 +35,24 @@ struct Material {
 layout (scalar, set = 0, binding = 0) uniform SceneData {
     mat4 view;
     mat4 proj;
-    mat4 light_transform;
+    // must match max_shadow_cascade_count in renderer.h
+    mat4 cascade_transforms[4];
+    // view space depth each cascade ends at
+    vec4 cascade_splits;
     vec3 eye_pos;
     vec3 sun_dir;
+    uint cascade_count;
+    // keeps the main pass output in range of 16 and 11 bit hdr targets. undone by the histogram and color correction
+    float pre_exposure;
 } scene_data;
 
-layout (set = 1, binding = 0) uniform sampler2D shadow_map;
-
-layout (scalar, set = 1, binding = 1) readonly buffer MaterialBuffer {
+layout (scalar, set = 0, binding = 1) readonly buffer MaterialBuffer {
     Material materials[];
 } material_buf;
 
+// one layer per cascade
+layout (set = 1, binding = 0) uniform sampler2DArray shadow_map;
+
 layout (set = 1, binding = 2) uniform sampler2D tex_samplers[];
 
 struct Vertex {
@@ -60,8 +67,100 @@ layout (scalar, buffer_reference) readonly buffer VertexBuffer {
     Vertex vertices[];
 };
 
+// must match VertexFormat in geometry_encoding.h
+#define VERTEX_FORMAT_FULL 0
+#define VERTEX_FORMAT_COMPACT 1
+#define VERTEX_FORMAT_COMPACT_NO_COLOR 2
+
+// positions are unorm16 across the primitive bounds. the top bit of position_z_tangent_sign is the tangent's w sign.
+// normal and tangent are octahedral snorm16x2 and the uvs are half floats
+struct CompactVertex {
+    uint position_xy;
+    uint position_z_tangent_sign;
+    uint normal;
+    uint tangent;
+    uint tex_coords[2];
+    uint color;
+};
+
+struct CompactVertexNoColor {
+    uint position_xy;
+    uint position_z_tangent_sign;
+    uint normal;
+    uint tangent;
+    uint tex_coords[2];
+};
+
+layout (scalar, buffer_reference) readonly buffer CompactVertexBuffer {
+    CompactVertex vertices[];
+};
+
+layout (scalar, buffer_reference) readonly buffer CompactVertexNoColorBuffer {
+    CompactVertexNoColor vertices[];
+};
+
+vec3 oct_decode(vec2 e) {
+    vec3 n = vec3(e, 1.f - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.f);
+    n.xy += vec2(n.x >= 0.f ? -t : t, n.y >= 0.f ? -t : t);
+    return normalize(n);
+}
+
+vec3 decode_compact_position(uint position_xy, uint position_z_tangent_sign, vec3 position_base, vec3 position_scale) {
+    vec3 quantized = vec3(unpackUnorm2x16(position_xy), float(position_z_tangent_sign & 0xFFFF) / 65535.f);
+    return position_base + position_scale * quantized;
+}
+
+Vertex decode_compact_vertex(uint position_xy, uint position_z_tangent_sign, uint normal, uint tangent, uint tex_coords[2], vec3 position_base,
+                             vec3 position_scale) {
+    Vertex v;
+    v.position = decode_compact_position(position_xy, position_z_tangent_sign, position_base, position_scale);
+    v.normal = oct_decode(unpackSnorm2x16(normal));
+    v.tangent = vec4(oct_decode(unpackSnorm2x16(tangent)), (position_z_tangent_sign & 0x80000000) != 0 ? -1.f : 1.f);
+    v.tex_coords[0] = unpackHalf2x16(tex_coords[0]);
+    v.tex_coords[1] = unpackHalf2x16(tex_coords[1]);
+    v.color = vec4(1.f);
+    return v;
+}
+
+// vertex_buffer is the arena base. index already includes the draw's vertex offset in vertices of this format
+Vertex load_vertex(VertexBuffer vertex_buffer, uint vertex_format, uint index, vec3 position_base, vec3 position_scale) {
+    if (vertex_format == VERTEX_FORMAT_COMPACT) {
+        CompactVertex c = CompactVertexBuffer(vertex_buffer).vertices[index];
+        Vertex v = decode_compact_vertex(c.position_xy, c.position_z_tangent_sign, c.normal, c.tangent, c.tex_coords, position_base, position_scale);
+        v.color = unpackUnorm4x8(c.color);
+        return v;
+    }
+    if (vertex_format == VERTEX_FORMAT_COMPACT_NO_COLOR) {
+        CompactVertexNoColor c = CompactVertexNoColorBuffer(vertex_buffer).vertices[index];
+        return decode_compact_vertex(c.position_xy, c.position_z_tangent_sign, c.normal, c.tangent, c.tex_coords, position_base, position_scale);
+    }
+    return vertex_buffer.vertices[index];
+}
+
+// depth only passes fetch just the position words
+vec3 load_vertex_position(VertexBuffer vertex_buffer, uint vertex_format, uint index, vec3 position_base, vec3 position_scale) {
+    if (vertex_format == VERTEX_FORMAT_COMPACT) {
+        CompactVertexBuffer compact_buffer = CompactVertexBuffer(vertex_buffer);
+        return decode_compact_position(compact_buffer.vertices[index].position_xy, compact_buffer.vertices[index].position_z_tangent_sign,
+                                       position_base, position_scale);
+    }
+    if (vertex_format == VERTEX_FORMAT_COMPACT_NO_COLOR) {
+        CompactVertexNoColorBuffer compact_buffer = CompactVertexNoColorBuffer(vertex_buffer);
+        return decode_compact_position(compact_buffer.vertices[index].position_xy, compact_buffer.vertices[index].position_z_tangent_sign,
+                                       position_base, position_scale);
+    }
+    return vertex_buffer.vertices[index].position;
+}
+
+// shaders with their own push constant layout (or none) define CUSTOM_PUSH_CONSTANTS before including
+#ifndef CUSTOM_PUSH_CONSTANTS
 layout (push_constant) uniform PushConstants {
     mat4 model_transform;
-    VertexBuffer vertex_buffer;
+    vec3 position_base;
     uint material_index;
-} constants;
\ No newline at end of file
+    vec3 position_scale;
+    uint vertex_format;
+    VertexBuffer vertex_buffer;
+} constants;
+#endif
\ No newline at end of file
@@ -0,0 +1,22 @@
+#extension GL_EXT_buffer_reference: enable
+#extension GL_EXT_scalar_block_layout: enable
+
+// must match GpuDrawData in renderer.h
+struct DrawData {
+    mat4 transform;
+    uint material_index;
+    uint first_index;
+    uint index_count;
+    int vertex_offset;
+    uint batch;
+    uint batch_first_command;
+    vec3 bounds_center;
+    vec3 bounds_half_extent;
+    vec3 position_base;
+    vec3 position_scale;
+    uint vertex_format;
+};
+
+layout (scalar, buffer_reference) readonly buffer DrawBuffer {
+    DrawData draws[];
+};
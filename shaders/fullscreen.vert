@@ -0,0 +1,7 @@
+#version 450
+
+// one triangle covering the whole viewport. draw 3 vertices with no vertex buffer
+void main() {
+    vec2 uv = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    gl_Position = vec4(uv * 2.f - 1.f, 0.f, 1.f);
+}
@@ -1,12 +1,12 @@
 #version 450
 #extension GL_ARB_shading_language_include: enable
+#define CUSTOM_PUSH_CONSTANTS
 #include "common.glsl"
 
 layout (location = 0) in vec4 vert_position;
 layout (location = 1) in vec4 vert_color;
 layout (location = 2) in vec4 vert_tangent;
 layout (location = 3) in vec3 vert_normal;
-layout (location = 4) in vec4 vert_light_pos;
 layout (location = 5) in vec2 normal_uv;
 layout (location = 6) in vec2 color_uv;
 layout (location = 7) in vec2 occlusion_uv;
@@ -15,6 +15,7 @@ layout (location = 9) in vec2 emissive_uv;
 layout (location = 10) in vec2 clearcoat_uv;
 layout (location = 11) in vec2 clearcoat_rough_uv;
 layout (location = 12) in vec2 clearcoat_normal_uv;
+layout (location = 13) flat in uint material_index;
 
 layout (location = 0) out vec4 out_color;
 
@@ -114,8 +115,14 @@ float convert_EV100_to_exposure(float EV100) {
 
 
 
+const mat4 bias_mat = mat4(
+0.5, 0.0, 0.0, 0.0,
+0.0, 0.5, 0.0, 0.0,
+0.0, 0.0, 1.0, 0.0,
+0.5, 0.5, 0.0, 1.0);
+
 void main() {
-    Material mat = material_buf.materials[nonuniformEXT (constants.material_index)];
+    Material mat = material_buf.materials[nonuniformEXT (material_index)];
 
     vec3 tex_normal = texture(tex_samplers[nonuniformEXT (mat.normal_texture.index)], normal_uv).xyz;
     vec4 tex_color = texture(tex_samplers[nonuniformEXT (mat.base_color_texture.index)], color_uv).rgba;
@@ -127,7 +134,9 @@ void main() {
     // since this means we read the default texture. aka, there is no normal map.
     mat3 TBN;
     if (tex_normal != vec3(1)){
-        tex_normal = tex_normal* 2.f - 1.f;
+        // bc5 normal maps only store xy, so z is always rebuilt from them
+        tex_normal.xy = tex_normal.xy * 2.f - 1.f;
+        tex_normal.z = sqrt(max(1.f - dot(tex_normal.xy, tex_normal.xy), 0.f));
         tex_normal *= vec3(mat.normal_scale, mat.normal_scale, 1);
         tex_normal = normalize(tex_normal);
         vec3 bitangent = cross(vert_normal, vec3(vert_tangent)) * vert_tangent.w;
@@ -177,7 +186,8 @@ void main() {
         vec3 tex_clearcoat_normal = texture(tex_samplers[nonuniformEXT (mat.clearcoat_normal_texture.index)], clearcoat_normal_uv).xyz;
         // only apply bump mapping if clearcoat normal isn't the default texture
         if (tex_clearcoat_normal != vec3(1)){
-            tex_clearcoat_normal = tex_clearcoat_normal * 2.f - 1.f;
+            tex_clearcoat_normal.xy = tex_clearcoat_normal.xy * 2.f - 1.f;
+            tex_clearcoat_normal.z = sqrt(max(1.f - dot(tex_clearcoat_normal.xy, tex_clearcoat_normal.xy), 0.f));
             tex_clearcoat_normal = normalize(TBN * tex_clearcoat_normal);
         }
 
@@ -186,24 +196,35 @@ void main() {
 
     }
 
+    // pick the first cascade whose far split is past this fragment. nothing past the last cascade is shadowed
+    float view_depth = -(scene_data.view * vert_position).z;
+    uint cascade = 0;
+    while (cascade < scene_data.cascade_count && view_depth > scene_data.cascade_splits[cascade]) {
+        cascade++;
+    }
+
     // PCF shadows
-    int radius = 3;
-    float shadow_texel_count = pow(radius * 2 + 1, 2);
-    float shadow = shadow_texel_count;
-    float texelSize = 1.0 / textureSize(shadow_map, 0).x;
-    vec4 shadow_coords = vert_light_pos / vert_light_pos.w;
-    float slope_bias = 0.0005 * tan(acos(n_dot_l));
-    // Clamp to prevent extreme bias values
-    slope_bias = clamp(slope_bias, 0.0, 0.001);
-    for (int x = -radius; x <= radius; x++) {
-        for (int y = -radius; y <= radius; y++) {
-            vec2 offset = vec2(x, y) * texelSize;
-            if (texture(shadow_map, shadow_coords.xy + offset).r < shadow_coords.z - slope_bias){
-                shadow -= 1;
+    float shadow = 1.f;
+    if (cascade < scene_data.cascade_count) {
+        int radius = 3;
+        float shadow_texel_count = pow(radius * 2 + 1, 2);
+        shadow = shadow_texel_count;
+        float texelSize = 1.0 / textureSize(shadow_map, 0).x;
+        vec4 light_pos = bias_mat * scene_data.cascade_transforms[cascade] * vert_position;
+        vec4 shadow_coords = light_pos / light_pos.w;
+        float slope_bias = 0.0005 * tan(acos(n_dot_l));
+        // Clamp to prevent extreme bias values
+        slope_bias = clamp(slope_bias, 0.0, 0.001);
+        for (int x = -radius; x <= radius; x++) {
+            for (int y = -radius; y <= radius; y++) {
+                vec2 offset = vec2(x, y) * texelSize;
+                if (texture(shadow_map, vec3(shadow_coords.xy + offset, cascade)).r < shadow_coords.z - slope_bias){
+                    shadow -= 1;
+                }
             }
         }
+        shadow /= shadow_texel_count;
     }
-    shadow /= shadow_texel_count;
 
     float iso = 100;
 
@@ -251,5 +272,5 @@ void main() {
     //
     //    final_color = ACESFilm(final_color);
 
-    out_color = vec4(final_color, albedo.a);
+    out_color = vec4(final_color * scene_data.pre_exposure, albedo.a);
 }
\ No newline at end of file
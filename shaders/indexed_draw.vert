@@ -6,7 +6,6 @@ layout (location = 0) out vec4 vert_position;
 layout (location = 1) out vec4 vert_color;
 layout (location = 2) out vec4 vert_tangent;
 layout (location = 3) out vec3 vert_normal;
-layout (location = 4) out vec4 vert_light_pos;
 layout (location = 5) out vec2 normal_uv;
 layout (location = 6) out vec2 color_uv;
 layout (location = 7) out vec2 occlusion_uv;
@@ -15,18 +14,12 @@ layout (location = 9) out vec2 emissive_uv;
 layout (location = 10) out vec2 clearcoat_uv;
 layout (location = 11) out vec2 clearcoat_rough_uv;
 layout (location = 12) out vec2 clearcoat_normal_uv;
-
-const mat4 bias_mat = mat4(
-0.5, 0.0, 0.0, 0.0,
-0.0, 0.5, 0.0, 0.0,
-0.0, 0.0, 1.0, 0.0,
-0.5, 0.5, 0.0, 1.0);
+layout (location = 13) flat out uint material_index;
 
 void main() {
-    Vertex v = constants.vertex_buffer.vertices[gl_VertexIndex];
+    Vertex v = load_vertex(constants.vertex_buffer, constants.vertex_format, gl_VertexIndex, constants.position_base, constants.position_scale);
 
     vert_position = constants.model_transform * vec4(v.position.xyz, 1.f);
-    vert_light_pos = bias_mat * scene_data.light_transform * vert_position;
 
     vert_color = v.color;
     vert_tangent = v.tangent;
@@ -35,6 +28,7 @@ void main() {
 
     gl_Position = scene_data.proj * scene_data.view * vert_position;
 
+    material_index = constants.material_index;
     Material mat = material_buf.materials[nonuniformEXT(constants.material_index)];
 
     normal_uv = v.tex_coords[mat.normal_texture.tex_coord];
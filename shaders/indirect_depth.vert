@@ -0,0 +1,17 @@
+#version 450
+#extension GL_ARB_shading_language_include: enable
+#define CUSTOM_PUSH_CONSTANTS
+#include "common.glsl"
+#include "draw_data.glsl"
+
+layout (push_constant) uniform PushConstants {
+    DrawBuffer draw_buffer;
+    VertexBuffer vertex_buffer;
+} constants;
+
+void main() {
+    DrawData draw = constants.draw_buffer.draws[gl_InstanceIndex];
+    vec3 position = load_vertex_position(constants.vertex_buffer, draw.vertex_format, gl_VertexIndex, draw.position_base, draw.position_scale);
+    vec4 vert_position = draw.transform * vec4(position, 1.f);
+    gl_Position = scene_data.proj * scene_data.view * vert_position;
+}
@@ -0,0 +1,52 @@
+#version 450
+#extension GL_ARB_shading_language_include: enable
+#define CUSTOM_PUSH_CONSTANTS
+#include "common.glsl"
+#include "draw_data.glsl"
+
+layout (push_constant) uniform PushConstants {
+    DrawBuffer draw_buffer;
+    VertexBuffer vertex_buffer;
+} constants;
+
+layout (location = 0) out vec4 vert_position;
+layout (location = 1) out vec4 vert_color;
+layout (location = 2) out vec4 vert_tangent;
+layout (location = 3) out vec3 vert_normal;
+layout (location = 5) out vec2 normal_uv;
+layout (location = 6) out vec2 color_uv;
+layout (location = 7) out vec2 occlusion_uv;
+layout (location = 8) out vec2 metal_rough_uv;
+layout (location = 9) out vec2 emissive_uv;
+layout (location = 10) out vec2 clearcoat_uv;
+layout (location = 11) out vec2 clearcoat_rough_uv;
+layout (location = 12) out vec2 clearcoat_normal_uv;
+layout (location = 13) flat out uint material_index;
+
+void main() {
+    // the cull shader writes the draw index as the first instance
+    DrawData draw = constants.draw_buffer.draws[gl_InstanceIndex];
+    // gl_VertexIndex already includes the draw's vertex offset into the arena
+    Vertex v = load_vertex(constants.vertex_buffer, draw.vertex_format, gl_VertexIndex, draw.position_base, draw.position_scale);
+
+    vert_position = draw.transform * vec4(v.position.xyz, 1.f);
+
+    vert_color = v.color;
+    vert_tangent = v.tangent;
+    vert_normal = normalize(mat3(draw.transform) * v.normal.xyz);
+
+    gl_Position = scene_data.proj * scene_data.view * vert_position;
+
+    material_index = draw.material_index;
+    Material mat = material_buf.materials[nonuniformEXT(draw.material_index)];
+
+    normal_uv = v.tex_coords[mat.normal_texture.tex_coord];
+    color_uv = v.tex_coords[mat.base_color_texture.tex_coord];
+    occlusion_uv = v.tex_coords[mat.occlusion_texture.tex_coord];
+    metal_rough_uv = v.tex_coords[mat.metallic_roughness_texture.tex_coord];
+    emissive_uv = v.tex_coords[mat.emissive_texture.tex_coord];
+
+    clearcoat_uv = v.tex_coords[mat.clearcoat_texture.tex_coord];
+    clearcoat_rough_uv = v.tex_coords[mat.clearcoat_roughness_texture.tex_coord];
+    clearcoat_normal_uv = v.tex_coords[mat.clearcoat_normal_texture.tex_coord];
+}
@@ -5,7 +5,8 @@
 layout (location = 0) out vec4 vert_olor;
 
 void main() {
-    Vertex v = constants.vertex_buffer.vertices[gl_VertexIndex];
-    vec4 vert_position = constants.model_transform * vec4(v.position.xyz, 1.f);
+    vec3 position = load_vertex_position(constants.vertex_buffer, constants.vertex_format, gl_VertexIndex, constants.position_base,
+                                         constants.position_scale);
+    vec4 vert_position = constants.model_transform * vec4(position, 1.f);
     gl_Position = scene_data.proj * scene_data.view * vert_position;
 }
@@ -0,0 +1,11 @@
+#version 450
+#extension GL_ARB_shading_language_include: enable
+#include "tone_map.glsl"
+
+// fallback for swapchains that can't be storage images. writes straight into the swapchain as a color attachment
+
+layout (location = 0) out vec4 out_color;
+
+void main() {
+    out_color = tone_map(ivec2(gl_FragCoord.xy));
+}
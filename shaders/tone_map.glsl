@@ -0,0 +1,60 @@
+#extension GL_EXT_buffer_reference: enable
+#extension GL_EXT_scalar_block_layout: enable
+
+// shared by the compute and full screen fragment versions of the final tone map pass
+
+layout (binding = 0) uniform sampler2D hdr_image;
+
+// pointer to a single float representing average luminance in the scene
+layout (scalar, buffer_reference) buffer readonly AverageLuminance {
+    float luminance[];
+};
+
+layout (push_constant) uniform PushConstants {
+    AverageLuminance luminance_buf;
+    float pre_exposure;
+    // set when the output format doesn't encode srgb on write
+    uint encode_srgb;
+} constants;
+
+float convert_EV100_to_exposure(float EV100) {
+    // Compute the maximum luminance possible with H_sbs sensitivity
+    // maxLum = 78 / ( S * q ) * N ^2 / t
+    // = 78 / ( S * q ) * 2^ EV_100
+    // = 78 / (100 * 0.65) * 2^ EV_100
+    // = 1.2 * 2^ EV
+    // Reference : http :// en . wikipedia . org / wiki / Film_speed
+    float max_luminance = 1.2f * pow(2.f, EV100);
+    return max_luminance;
+}
+
+vec3 ACESFilm(vec3 x)
+{
+    float a = 2.51f;
+    float b = 0.03f;
+    float c = 2.43f;
+    float d = 0.59f;
+    float e = 0.14f;
+    return clamp((x * (a * x + b)) / (x * (c * x + d) + e), 0.f, 1.f);
+}
+
+vec3 linear_to_srgb(vec3 color) {
+    vec3 low = color * 12.92f;
+    vec3 high = 1.055f * pow(color, vec3(1.f / 2.4f)) - 0.055f;
+    return mix(high, low, lessThanEqual(color, vec3(0.0031308f)));
+}
+
+vec4 tone_map(ivec2 pixel_coords) {
+    vec4 hdr_color = texelFetch(hdr_image, pixel_coords, 0);
+
+    float EV100 = log2(constants.luminance_buf.luminance[0] * 100.f / 12.5);
+    float exposure = convert_EV100_to_exposure(EV100);
+
+    vec3 corrected_color = hdr_color.rgb / constants.pre_exposure / exposure;
+    corrected_color = ACESFilm(corrected_color);
+    if (constants.encode_srgb != 0) {
+        corrected_color = linear_to_srgb(corrected_color);
+    }
+
+    return vec4(corrected_color, hdr_color.a);
+}
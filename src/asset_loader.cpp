@@ -0,0 +1,290 @@
+#include "asset_loader.h"
+
+#include "trace.h"
+
+#include <thread>
+
+static constexpr const char* asset_cache_dir = "cache/";
+
+static vk_gltf::GltfAsset load_asset(const AssetLoader* loader, const std::string& gltf_path, VkCommandPool command_pool, VkQueue queue) {
+    TRACE_ZONE("vk_gltf::load_gltf");
+    vk_gltf::LoadOptions gltf_load_options{};
+    gltf_load_options.gltf_path      = gltf_path.c_str();
+    gltf_load_options.cache_dir      = asset_cache_dir;
+    gltf_load_options.create_mipmaps = true;
+
+    return vk_gltf::load_gltf(&gltf_load_options, loader->allocator, loader->device, command_pool, queue);
+}
+
+// moves every image a TextureSource can hold into host memory. create_mipmaps gives each one its full chain
+static std::vector<TextureSource> read_back_images(const AssetLoader* loader, vk_gltf::GltfAsset* asset, VkCommandPool command_pool, VkQueue queue) {
+    TRACE_ZONE("read_back_images");
+    std::vector<TextureSource> texture_sources(asset->images.size());
+    if (!loader->stream_textures && !loader->compress_textures) {
+        return texture_sources;
+    }
+
+    for (uint32_t i = 0; i < asset->images.size(); i++) {
+        vk_gltf::GltfImage* gltf_image = &asset->images[i];
+        if (texture_format_texel_size(gltf_image->image_format) == 0) {
+            continue;
+        }
+        texture_sources[i] = texture_source_read_back(loader->device, loader->allocator, command_pool, queue, gltf_image->image,
+                                                      gltf_image->image_format, gltf_image->extent, gltf_image->layout);
+
+        vkDestroyImageView(loader->device, gltf_image->image_view, nullptr);
+        vmaDestroyImage(loader->allocator, gltf_image->image, gltf_image->allocation);
+        gltf_image->image           = nullptr;
+        gltf_image->image_view      = nullptr;
+        gltf_image->allocation      = nullptr;
+        gltf_image->allocation_info = {};
+    }
+    return texture_sources;
+}
+
+// block compressed format for how the asset's materials sample each image. normal maps keep their xy, which the shader
+// turns back into a unit vector, and images only read for red keep that one channel. everything else is bc7
+static std::vector<VkFormat> compressed_image_formats(const vk_gltf::GltfAsset* asset) {
+    constexpr uint8_t sampled_normal = 1 << 0;
+    constexpr uint8_t sampled_red    = 1 << 1;
+    constexpr uint8_t sampled_rgba   = 1 << 2;
+
+    std::vector<uint8_t> image_usages(asset->images.size());
+
+    const auto add_usage = [&](const auto& texture_info, uint8_t usage) {
+        if (!texture_info.has_value()) {
+            return;
+        }
+        const vk_gltf::GltfTexture* gltf_texture = &asset->textures[texture_info->tex_index];
+        if (gltf_texture->image_index.has_value()) {
+            image_usages[gltf_texture->image_index.value()] |= usage;
+        }
+    };
+    for (const vk_gltf::GltfMaterial& gltf_material : asset->materials) {
+        add_usage(gltf_material.base_color_texture, sampled_rgba);
+        add_usage(gltf_material.metallic_roughness_texture, sampled_rgba);
+        add_usage(gltf_material.normal_texture, sampled_normal);
+        add_usage(gltf_material.occlusion_texture, sampled_red);
+        add_usage(gltf_material.emissive_texture, sampled_rgba);
+        add_usage(gltf_material.clearcoat_texture, sampled_red);
+        add_usage(gltf_material.clearcoat_roughness_texture, sampled_rgba);
+        add_usage(gltf_material.clearcoat_normal_texture, sampled_normal);
+    }
+
+    std::vector<VkFormat> formats(asset->images.size());
+    for (uint32_t i = 0; i < asset->images.size(); i++) {
+        if (image_usages[i] == sampled_normal) {
+            formats[i] = VK_FORMAT_BC5_UNORM_BLOCK;
+        } else if (image_usages[i] == sampled_red) {
+            formats[i] = VK_FORMAT_BC4_UNORM_BLOCK;
+        } else if (asset->images[i].image_format == VK_FORMAT_R8G8B8A8_SRGB || asset->images[i].image_format == VK_FORMAT_B8G8R8A8_SRGB) {
+            formats[i] = VK_FORMAT_BC7_SRGB_BLOCK;
+        } else {
+            formats[i] = VK_FORMAT_BC7_UNORM_BLOCK;
+        }
+    }
+    return formats;
+}
+
+// swaps every read back source for its block compressed chain, from the texture cache when it's there
+static void compress_images(AssetLoader* loader, const vk_gltf::GltfAsset* asset, std::vector<TextureSource>* texture_sources) {
+    if (!loader->compress_textures) {
+        return;
+    }
+    TRACE_ZONE("compress_images");
+
+    const std::vector<VkFormat> formats = compressed_image_formats(asset);
+    for (uint32_t i = 0; i < texture_sources->size(); i++) {
+        TextureSource* source = &(*texture_sources)[i];
+        if (source->mips.empty()) {
+            continue;
+        }
+
+        const uint64_t source_hash = texture_source_hash(source);
+        TextureSource  compressed  = texture_cache_load(asset_cache_dir, source_hash, formats[i], source->mips[0].extent);
+        if (compressed.mips.empty()) {
+            std::lock_guard lock(loader->encode_mutex);
+            compressed = texture_source_compress(source, formats[i], &loader->encode_jobs);
+            texture_cache_store(asset_cache_dir, source_hash, &compressed);
+        }
+        *source = std::move(compressed);
+    }
+}
+
+// encodes every mesh's primitives for the arena. the loader's buffers aren't needed past that
+static EncodedGeometry encode_geometry(const AssetLoader* loader, vk_gltf::GltfAsset* asset, VkCommandPool command_pool, VkQueue queue) {
+    std::vector<const vk_gltf::GltfPrimitive*> gltf_primitives;
+    for (const vk_gltf::GltfMesh& gltf_mesh : asset->meshes) {
+        for (const vk_gltf::GltfPrimitive& gltf_primitive : gltf_mesh.primitives) {
+            gltf_primitives.push_back(&gltf_primitive);
+        }
+    }
+    EncodedGeometry geometry = geometry_encode(loader->device, loader->allocator, command_pool, queue, &loader->geometry_pipelines, gltf_primitives,
+                                               loader->compact_vertices);
+
+    for (vk_gltf::GltfMesh& gltf_mesh : asset->meshes) {
+        for (vk_gltf::GltfPrimitive& gltf_primitive : gltf_mesh.primitives) {
+            vmaDestroyBuffer(loader->allocator, gltf_primitive.vertex_buffer.buffer, gltf_primitive.vertex_buffer.allocation);
+            gltf_primitive.vertex_buffer = {};
+            if (gltf_primitive.index_buffer.has_value()) {
+                vmaDestroyBuffer(loader->allocator, gltf_primitive.index_buffer->buffer, gltf_primitive.index_buffer->allocation);
+                gltf_primitive.index_buffer.reset();
+            }
+        }
+    }
+    return geometry;
+}
+
+// pops the next queued load and marks it loading. returns nullptr once stopping or, without wait, when nothing is queued
+static AssetLoad* begin_next_load(AssetLoader* loader, bool wait, AssetLoadHandle* handle) {
+    std::unique_lock lock(loader->mutex);
+    if (wait) {
+        loader->work_available.wait(lock, [&] { return loader->stopping || !loader->queued_loads.empty(); });
+    }
+    if (loader->stopping || loader->queued_loads.empty()) {
+        return nullptr;
+    }
+
+    *handle         = loader->queued_loads.front();
+    AssetLoad* load = &loader->loads[*handle];
+    loader->queued_loads.pop_front();
+    load->stage = AssetLoadStage::loading;
+    loader->progress.queued--;
+    loader->progress.loading++;
+    return load;
+}
+
+// gltf_path isn't touched again once the load is picked up, so it's read without the lock
+static void run_load(AssetLoader* loader, AssetLoadHandle handle, AssetLoad* load, VkCommandPool command_pool, VkQueue queue) {
+    vk_gltf::GltfAsset         asset           = load_asset(loader, load->gltf_path, command_pool, queue);
+    std::vector<TextureSource> texture_sources = read_back_images(loader, &asset, command_pool, queue);
+    EncodedGeometry            geometry        = encode_geometry(loader, &asset, command_pool, queue);
+    compress_images(loader, &asset, &texture_sources);
+    {
+        std::lock_guard lock(loader->mutex);
+        load->asset           = std::move(asset);
+        load->texture_sources = std::move(texture_sources);
+        load->geometry        = std::move(geometry);
+        load->stage           = AssetLoadStage::loaded;
+        loader->loaded_loads.push_back(handle);
+        loader->progress.loading--;
+        loader->progress.loaded++;
+    }
+    loader->load_finished.notify_all();
+}
+
+static void worker_main(AssetLoader* loader, VkQueue queue) {
+    TRACE_THREAD_NAME("asset_loader");
+
+    const VkCommandPoolCreateInfo command_pool_ci = vk_lib::command_pool_create_info(loader->queue_family, 0);
+    VkCommandPool                 command_pool;
+    VK_CHECK(vkCreateCommandPool(loader->device, &command_pool_ci, nullptr, &command_pool));
+
+    AssetLoadHandle handle;
+    while (AssetLoad* load = begin_next_load(loader, true, &handle)) {
+        run_load(loader, handle, load, command_pool, queue);
+    }
+
+    vkDestroyCommandPool(loader->device, command_pool, nullptr);
+}
+
+void asset_loader_create(AssetLoader* loader, VkDevice device, VmaAllocator allocator, uint32_t queue_family, std::span<const VkQueue> queues,
+                         const GeometryEncodePipelines* geometry_pipelines, bool stream_textures, bool compress_textures, bool compact_vertices) {
+    loader->device             = device;
+    loader->allocator          = allocator;
+    loader->queue_family       = queue_family;
+    loader->stream_textures    = stream_textures;
+    loader->compress_textures  = compress_textures;
+    loader->compact_vertices   = compact_vertices;
+    loader->geometry_pipelines = *geometry_pipelines;
+
+    if (compress_textures) {
+        job_system_create(&loader->encode_jobs, std::max(std::thread::hardware_concurrency(), 2u) - 1);
+    }
+
+    loader->workers.reserve(queues.size());
+    for (VkQueue queue : queues) {
+        loader->workers.emplace_back(worker_main, loader, queue);
+    }
+}
+
+void asset_loader_destroy(AssetLoader* loader) {
+    {
+        std::lock_guard lock(loader->mutex);
+        loader->stopping = true;
+    }
+    loader->work_available.notify_all();
+
+    // loads in progress run to completion
+    for (std::thread& worker : loader->workers) {
+        worker.join();
+    }
+    loader->workers.clear();
+}
+
+AssetLoader::~AssetLoader() { asset_loader_destroy(this); }
+
+AssetLoadHandle asset_loader_enqueue(AssetLoader* loader, const char* gltf_path) {
+    AssetLoadHandle handle;
+    {
+        std::lock_guard lock(loader->mutex);
+        if (loader->free_loads.empty()) {
+            handle = loader->loads.size();
+            loader->loads.emplace_back();
+        } else {
+            handle = loader->free_loads.back();
+            loader->free_loads.pop_back();
+        }
+        loader->loads[handle] = {gltf_path};
+        loader->queued_loads.push_back(handle);
+        loader->progress.queued++;
+    }
+    loader->work_available.notify_one();
+    return handle;
+}
+
+void asset_loader_load_queued(AssetLoader* loader, VkCommandPool command_pool, VkQueue queue) {
+    AssetLoadHandle handle;
+    while (AssetLoad* load = begin_next_load(loader, false, &handle)) {
+        run_load(loader, handle, load, command_pool, queue);
+    }
+}
+
+std::vector<LoadedAsset> asset_loader_take_loaded(AssetLoader* loader) {
+    std::vector<LoadedAsset> assets;
+
+    std::lock_guard lock(loader->mutex);
+    assets.reserve(loader->loaded_loads.size());
+    for (AssetLoadHandle handle : loader->loaded_loads) {
+        AssetLoad* load = &loader->loads[handle];
+        assets.push_back({handle, std::move(load->asset), std::move(load->texture_sources), std::move(load->geometry)});
+        load->asset           = {};
+        load->texture_sources = {};
+        load->geometry        = {};
+        load->stage           = AssetLoadStage::published;
+        loader->free_loads.push_back(handle);
+    }
+    loader->progress.loaded -= loader->loaded_loads.size();
+    loader->progress.published += loader->loaded_loads.size();
+    loader->loaded_loads.clear();
+    return assets;
+}
+
+void asset_loader_wait_idle(AssetLoader* loader) {
+    if (loader->workers.empty()) {
+        return;
+    }
+
+    std::unique_lock lock(loader->mutex);
+    loader->load_finished.wait(lock, [&] { return loader->queued_loads.empty() && loader->progress.loading == 0; });
+}
+
+AssetLoadStage asset_loader_stage(AssetLoader* loader, AssetLoadHandle handle) {
+    std::lock_guard lock(loader->mutex);
+    return loader->loads[handle].stage;
+}
+
+AssetLoadProgress asset_loader_progress(AssetLoader* loader) {
+    std::lock_guard lock(loader->mutex);
+    return loader->progress;
+}
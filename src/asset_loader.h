@@ -0,0 +1,106 @@
+#pragma once
+#include "common.h"
+#include "geometry_encoding.h"
+#include "texture_compression.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vk_gltf/loader.h>
+
+// background glTF loading. every worker owns one of the context's loader queues and a command pool on the graphics
+// family, so vk_gltf::load_gltf parses, decodes and uploads without touching the queue frames are submitted to. workers
+// also encode the geometry for the renderer's arena and drop the loader's primitive buffers. loaded assets wait in the
+// loader until the renderer takes them at a frame boundary. with stream_textures or compress_textures,
+// images in a format a TextureSource can hold are read back into host memory and destroyed before the asset is handed
+// over. compress_textures then swaps them for their block compressed chain from the texture cache, encoding it on a miss
+using AssetLoadHandle = uint32_t;
+
+enum class AssetLoadStage : uint8_t {
+    queued,
+    loading,
+    // on the gpu and waiting for the renderer to take it
+    loaded,
+    published,
+};
+
+struct AssetLoad {
+    std::string        gltf_path{};
+    AssetLoadStage     stage{};
+    vk_gltf::GltfAsset asset{};
+    // parallel to asset.images. images that were read back have no mips here and a null image in the asset
+    std::vector<TextureSource> texture_sources{};
+    // every mesh's primitives in order
+    EncodedGeometry geometry{};
+};
+
+struct LoadedAsset {
+    AssetLoadHandle            handle{};
+    vk_gltf::GltfAsset         asset{};
+    std::vector<TextureSource> texture_sources{};
+    EncodedGeometry            geometry{};
+};
+
+struct AssetLoadProgress {
+    uint32_t queued{};
+    uint32_t loading{};
+    uint32_t loaded{};
+    uint32_t published{};
+};
+
+struct AssetLoader {
+    VkDevice     device{};
+    VmaAllocator allocator{};
+    uint32_t     queue_family{};
+    bool         stream_textures{};
+    bool         compress_textures{};
+    bool         compact_vertices{};
+
+    GeometryEncodePipelines geometry_pipelines{};
+
+    std::vector<std::thread> workers{};
+    // a job system takes one parallel_for at a time, so workers take turns encoding on it
+    JobSystem  encode_jobs{};
+    std::mutex encode_mutex{};
+
+    std::mutex                  mutex{};
+    std::condition_variable     work_available{};
+    std::condition_variable     load_finished{};
+    bool                        stopping{};
+    std::deque<AssetLoadHandle> queued_loads{};
+    // finished loads waiting for asset_loader_take_loaded
+    std::vector<AssetLoadHandle> loaded_loads{};
+    // indexed by handle. a deque so workers can fill in their load while others are added. the entries of taken loads are
+    // handed out again from free_loads
+    std::deque<AssetLoad>        loads{};
+    std::vector<AssetLoadHandle> free_loads{};
+    // loads in each stage. published counts every load taken so far
+    AssetLoadProgress progress{};
+
+    ~AssetLoader();
+};
+
+// one worker per queue. without queues nothing loads in the background and asset_loader_load_queued has to be called
+void asset_loader_create(AssetLoader* loader, VkDevice device, VmaAllocator allocator, uint32_t queue_family, std::span<const VkQueue> queues,
+                         const GeometryEncodePipelines* geometry_pipelines, bool stream_textures, bool compress_textures, bool compact_vertices);
+
+void asset_loader_destroy(AssetLoader* loader);
+
+[[nodiscard]] AssetLoadHandle asset_loader_enqueue(AssetLoader* loader, const char* gltf_path);
+
+// loads everything queued on the calling thread, for loaders without workers
+void asset_loader_load_queued(AssetLoader* loader, VkCommandPool command_pool, VkQueue queue);
+
+// hands over every loaded asset. their handles are reused by later loads, so a handle's stage can't be asked for once
+// it's been taken
+[[nodiscard]] std::vector<LoadedAsset> asset_loader_take_loaded(AssetLoader* loader);
+
+// blocks until nothing is queued or loading. returns right away without workers
+void asset_loader_wait_idle(AssetLoader* loader);
+
+[[nodiscard]] AssetLoadStage asset_loader_stage(AssetLoader* loader, AssetLoadHandle handle);
+
+[[nodiscard]] AssetLoadProgress asset_loader_progress(AssetLoader* loader);
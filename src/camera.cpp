@@ -93,7 +93,7 @@ glm::mat4 camera_view() {
 }
 
 void set_camera_proj(float fov_y_radians, float aspect_ratio) {
-    glm::mat4 proj = glm::perspective(fov_y_radians, aspect_ratio, 1000.f, 0.01f);
+    glm::mat4 proj = glm::perspective(fov_y_radians, aspect_ratio, camera_far_plane, camera_near_plane);
     proj[1][1] *= -1;
 
     global::camera.proj = proj;
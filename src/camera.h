@@ -12,6 +12,10 @@ struct Camera {
     bool                movement_enabled{true};
 };
 
+// reversed depth, so the near plane maps to 1 and the far plane to 0
+inline constexpr float camera_near_plane = 0.01f;
+inline constexpr float camera_far_plane  = 1000.f;
+
 namespace global {
 inline Camera camera{};
 } // namespace global
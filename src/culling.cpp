@@ -0,0 +1,177 @@
+#include "culling.h"
+
+#include <bit>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define CULLING_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CULLING_SSE
+#endif
+
+Frustum frustum_from_view_proj(const glm::mat4& view_proj) {
+    // glm is column major. row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+    const glm::mat4 m = glm::transpose(view_proj);
+
+    Frustum frustum{};
+    frustum.planes[0] = m[3] + m[0]; // left
+    frustum.planes[1] = m[3] - m[0]; // right
+    frustum.planes[2] = m[3] + m[1]; // bottom
+    frustum.planes[3] = m[3] - m[1]; // top
+    frustum.planes[4] = m[2];        // z >= 0
+    frustum.planes[5] = m[3] - m[2]; // z <= w
+
+    for (glm::vec4& plane : frustum.planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    return frustum;
+}
+
+void cull_bounds_add(CullBounds* cull_bounds, const glm::vec3& origin, const glm::vec3& extent, const glm::mat4& transform) {
+    // Arvo's method. the world half extent is the local half extent projected onto the absolute world axes
+    const glm::vec3 center = transform * glm::vec4(origin, 1.f);
+    const glm::mat3 abs_rotation_scale{glm::abs(glm::vec3(transform[0])), glm::abs(glm::vec3(transform[1])), glm::abs(glm::vec3(transform[2]))};
+    const glm::vec3 half_extent = abs_rotation_scale * extent;
+
+    cull_bounds->center_x.push_back(center.x);
+    cull_bounds->center_y.push_back(center.y);
+    cull_bounds->center_z.push_back(center.z);
+    cull_bounds->half_extent_x.push_back(half_extent.x);
+    cull_bounds->half_extent_y.push_back(half_extent.y);
+    cull_bounds->half_extent_z.push_back(half_extent.z);
+}
+
+void cull_bounds_set(CullBounds* cull_bounds, uint32_t index, const glm::vec3& center, const glm::vec3& half_extent) {
+    cull_bounds->center_x[index]      = center.x;
+    cull_bounds->center_y[index]      = center.y;
+    cull_bounds->center_z[index]      = center.z;
+    cull_bounds->half_extent_x[index] = half_extent.x;
+    cull_bounds->half_extent_y[index] = half_extent.y;
+    cull_bounds->half_extent_z[index] = half_extent.z;
+}
+
+void cull_bounds_enclose(const CullBounds* cull_bounds, uint32_t first, glm::vec3* min, glm::vec3* max) {
+    for (uint32_t i = first; i < cull_bounds_count(cull_bounds); i++) {
+        const glm::vec3 center{cull_bounds->center_x[i], cull_bounds->center_y[i], cull_bounds->center_z[i]};
+        const glm::vec3 half_extent{cull_bounds->half_extent_x[i], cull_bounds->half_extent_y[i], cull_bounds->half_extent_z[i]};
+        *min = glm::min(*min, center - half_extent);
+        *max = glm::max(*max, center + half_extent);
+    }
+}
+
+uint32_t cull_bounds_count(const CullBounds* cull_bounds) { return cull_bounds->center_x.size(); }
+
+Frustum shadow_caster_frustum(const Frustum* receiver_frustum, const glm::vec3& light_dir) {
+    Frustum caster_frustum{};
+    for (uint32_t i = 0; i < receiver_frustum->planes.size(); i++) {
+        const glm::vec4& plane = receiver_frustum->planes[i];
+        // a box outside this plane stays outside as it's swept along light_dir only if light_dir doesn't point inwards
+        caster_frustum.planes[i] = glm::dot(glm::vec3(plane), light_dir) <= 0 ? plane : glm::vec4(0, 0, 0, 1);
+    }
+    return caster_frustum;
+}
+
+// a box is outside a plane when even its most positive corner along the plane normal is behind it
+static bool is_box_visible_scalar(const CullBounds* cull_bounds, std::span<const glm::vec4> planes, uint32_t i) {
+    for (const glm::vec4& plane : planes) {
+        const float distance = plane.x * cull_bounds->center_x[i] + plane.y * cull_bounds->center_y[i] + plane.z * cull_bounds->center_z[i] + plane.w;
+        const float radius   = std::abs(plane.x) * cull_bounds->half_extent_x[i] + std::abs(plane.y) * cull_bounds->half_extent_y[i] +
+                             std::abs(plane.z) * cull_bounds->half_extent_z[i];
+        if (distance + radius < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#if defined(CULLING_AVX)
+
+static constexpr uint32_t cull_batch_size = 8;
+
+static uint32_t cull_batch(const CullBounds* cull_bounds, std::span<const glm::vec4> planes, uint32_t first) {
+    const __m256 center_x      = _mm256_loadu_ps(&cull_bounds->center_x[first]);
+    const __m256 center_y      = _mm256_loadu_ps(&cull_bounds->center_y[first]);
+    const __m256 center_z      = _mm256_loadu_ps(&cull_bounds->center_z[first]);
+    const __m256 half_extent_x = _mm256_loadu_ps(&cull_bounds->half_extent_x[first]);
+    const __m256 half_extent_y = _mm256_loadu_ps(&cull_bounds->half_extent_y[first]);
+    const __m256 half_extent_z = _mm256_loadu_ps(&cull_bounds->half_extent_z[first]);
+
+    __m256 outside = _mm256_setzero_ps();
+    for (const glm::vec4& plane : planes) {
+        __m256 distance = _mm256_set1_ps(plane.w);
+        distance        = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(plane.x), center_x));
+        distance        = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(plane.y), center_y));
+        distance        = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(plane.z), center_z));
+        distance        = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(std::abs(plane.x)), half_extent_x));
+        distance        = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(std::abs(plane.y)), half_extent_y));
+        distance        = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(std::abs(plane.z)), half_extent_z));
+        outside         = _mm256_or_ps(outside, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_LT_OQ));
+    }
+    return ~static_cast<uint32_t>(_mm256_movemask_ps(outside)) & 0xFF;
+}
+
+#elif defined(CULLING_SSE)
+
+static constexpr uint32_t cull_batch_size = 4;
+
+static uint32_t cull_batch(const CullBounds* cull_bounds, std::span<const glm::vec4> planes, uint32_t first) {
+    const __m128 center_x      = _mm_loadu_ps(&cull_bounds->center_x[first]);
+    const __m128 center_y      = _mm_loadu_ps(&cull_bounds->center_y[first]);
+    const __m128 center_z      = _mm_loadu_ps(&cull_bounds->center_z[first]);
+    const __m128 half_extent_x = _mm_loadu_ps(&cull_bounds->half_extent_x[first]);
+    const __m128 half_extent_y = _mm_loadu_ps(&cull_bounds->half_extent_y[first]);
+    const __m128 half_extent_z = _mm_loadu_ps(&cull_bounds->half_extent_z[first]);
+
+    __m128 outside = _mm_setzero_ps();
+    for (const glm::vec4& plane : planes) {
+        __m128 distance = _mm_set1_ps(plane.w);
+        distance        = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane.x), center_x));
+        distance        = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane.y), center_y));
+        distance        = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane.z), center_z));
+        distance        = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(std::abs(plane.x)), half_extent_x));
+        distance        = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(std::abs(plane.y)), half_extent_y));
+        distance        = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(std::abs(plane.z)), half_extent_z));
+        outside         = _mm_or_ps(outside, _mm_cmplt_ps(distance, _mm_setzero_ps()));
+    }
+    return ~static_cast<uint32_t>(_mm_movemask_ps(outside)) & 0xF;
+}
+
+#else
+
+static constexpr uint32_t cull_batch_size = 1;
+
+static uint32_t cull_batch(const CullBounds* cull_bounds, std::span<const glm::vec4> planes, uint32_t first) {
+    return is_box_visible_scalar(cull_bounds, planes, first) ? 1 : 0;
+}
+
+#endif
+
+void planes_cull(const CullBounds* cull_bounds, std::span<const glm::vec4> planes, std::vector<uint32_t>* visible_indices) {
+    const uint32_t count = cull_bounds_count(cull_bounds);
+    visible_indices->resize(count);
+    uint32_t* out           = visible_indices->data();
+    uint32_t  visible_count = 0;
+
+    uint32_t i = 0;
+    for (; i + cull_batch_size <= count; i += cull_batch_size) {
+        uint32_t visible_mask = cull_batch(cull_bounds, planes, i);
+        while (visible_mask != 0) {
+            out[visible_count++] = i + std::countr_zero(visible_mask);
+            visible_mask &= visible_mask - 1;
+        }
+    }
+
+    // leftover boxes that don't fill a batch
+    for (; i < count; i++) {
+        if (is_box_visible_scalar(cull_bounds, planes, i)) {
+            out[visible_count++] = i;
+        }
+    }
+
+    visible_indices->resize(visible_count);
+}
+
+void frustum_cull(const CullBounds* cull_bounds, const Frustum* frustum, std::vector<uint32_t>* visible_indices) {
+    planes_cull(cull_bounds, frustum->planes, visible_indices);
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "common.h"
+
+// world space AABBs kept apart from the draw objects in structure-of-arrays form so the frustum test streams through
+// tightly packed floats 4 (SSE) or 8 (AVX) boxes at a time. index i matches draw i of the owning draw list
+struct CullBounds {
+    std::vector<float> center_x{};
+    std::vector<float> center_y{};
+    std::vector<float> center_z{};
+    std::vector<float> half_extent_x{};
+    std::vector<float> half_extent_y{};
+    std::vector<float> half_extent_z{};
+};
+
+// planes point inwards. xyz is the normal, w the distance
+struct Frustum {
+    std::array<glm::vec4, 6> planes{};
+};
+
+// works for standard and reversed depth since both depth planes are extracted
+[[nodiscard]] Frustum frustum_from_view_proj(const glm::mat4& view_proj);
+
+// origin and extent describe a local space box (extent is half the size) that gets transformed into a world space AABB
+void cull_bounds_add(CullBounds* cull_bounds, const glm::vec3& origin, const glm::vec3& extent, const glm::mat4& transform);
+
+// replaces box index with a world space AABB
+void cull_bounds_set(CullBounds* cull_bounds, uint32_t index, const glm::vec3& center, const glm::vec3& half_extent);
+
+// grows min and max to enclose boxes [first, cull_bounds_count) of cull_bounds
+void cull_bounds_enclose(const CullBounds* cull_bounds, uint32_t first, glm::vec3* min, glm::vec3* max);
+
+[[nodiscard]] uint32_t cull_bounds_count(const CullBounds* cull_bounds);
+
+// planes of receiver_frustum that a box's shadow, swept along light_dir, can never cross. the rest are replaced by
+// (0, 0, 0, 1) which every box passes. a box outside the result casts no shadow into receiver_frustum
+[[nodiscard]] Frustum shadow_caster_frustum(const Frustum* receiver_frustum, const glm::vec3& light_dir);
+
+// overwrites visible_indices with the ascending indices of every box on the inner side of all planes
+void planes_cull(const CullBounds* cull_bounds, std::span<const glm::vec4> planes, std::vector<uint32_t>* visible_indices);
+
+// overwrites visible_indices with the ascending indices of every box touching the frustum
+void frustum_cull(const CullBounds* cull_bounds, const Frustum* frustum, std::vector<uint32_t>* visible_indices);
@@ -0,0 +1,58 @@
+#include "draw_sort.h"
+
+#include <bit>
+
+uint64_t draw_sort_key(bool double_sided, VkFrontFace front_face, float view_depth, uint32_t material_index, uint32_t draw_index) {
+    // positive floats order the same as their bit patterns. the top 16 bits give a coarse, roughly logarithmic depth
+    const uint32_t depth_bits = std::bit_cast<uint32_t>(std::max(view_depth, 0.f)) >> 15;
+
+    uint64_t key = 0;
+    key |= static_cast<uint64_t>(double_sided) << 63;
+    key |= static_cast<uint64_t>(front_face == VK_FRONT_FACE_CLOCKWISE) << 62;
+    key |= static_cast<uint64_t>(depth_bits & 0xFFFF) << 46;
+    key |= static_cast<uint64_t>(material_index & 0xFFFF) << 30;
+    key |= draw_index & draw_sort_key_index_mask;
+    return key;
+}
+
+void radix_sort_keys(std::vector<uint64_t>* keys, std::vector<uint64_t>* scratch) {
+    const size_t count = keys->size();
+    if (count < 2) {
+        return;
+    }
+    scratch->resize(count);
+
+    // all 8 histograms in one read over the keys
+    std::array<std::array<uint32_t, 256>, 8> histograms{};
+    for (uint64_t key : *keys) {
+        for (uint32_t pass = 0; pass < 8; pass++) {
+            histograms[pass][(key >> (pass * 8)) & 0xFF]++;
+        }
+    }
+
+    uint64_t* src = keys->data();
+    uint64_t* dst = scratch->data();
+    for (uint32_t pass = 0; pass < 8; pass++) {
+        std::array<uint32_t, 256>& histogram = histograms[pass];
+        const uint32_t             shift     = pass * 8;
+        if (histogram[(src[0] >> shift) & 0xFF] == count) {
+            continue;
+        }
+
+        uint32_t offset = 0;
+        for (uint32_t& bucket : histogram) {
+            const uint32_t bucket_count = bucket;
+            bucket                      = offset;
+            offset += bucket_count;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            dst[histogram[(src[i] >> shift) & 0xFF]++] = src[i];
+        }
+        std::swap(src, dst);
+    }
+
+    if (src != keys->data()) {
+        std::swap(*keys, *scratch);
+    }
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include "common.h"
+
+// 64 bit draw sort keys. most significant first:
+// [63] double sided, [62] clockwise front face, [61:46] view depth, [45:30] material, [29:0] draw index.
+// sorting groups draws by the dynamic raster state they need and orders each group front to back. pipelines and the
+// index buffer don't appear since every draw list has its own pipeline and all indices live in the geometry arena
+inline constexpr uint32_t draw_sort_key_index_bits = 30;
+inline constexpr uint64_t draw_sort_key_index_mask = (uint64_t{1} << draw_sort_key_index_bits) - 1;
+
+[[nodiscard]] uint64_t draw_sort_key(bool double_sided, VkFrontFace front_face, float view_depth, uint32_t material_index, uint32_t draw_index);
+
+[[nodiscard]] inline uint32_t draw_sort_key_draw_index(uint64_t key) { return static_cast<uint32_t>(key & draw_sort_key_index_mask); }
+
+// LSD radix sort over bytes. passes where every key shares the same byte are skipped. scratch is resized as needed
+void radix_sort_keys(std::vector<uint64_t>* keys, std::vector<uint64_t>* scratch);
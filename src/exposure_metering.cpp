@@ -0,0 +1,39 @@
+#include "exposure_metering.h"
+
+float histogram_average_log_luminance(std::span<const uint32_t> bins) {
+    double   weighted_bin_sum = 0;
+    uint64_t sample_count     = 0;
+    for (uint32_t bin = 1; bin < bins.size(); bin++) {
+        weighted_bin_sum += static_cast<double>(bins[bin]) * bin;
+        sample_count += bins[bin];
+    }
+
+    const double weighted_log_average = weighted_bin_sum / static_cast<double>(std::max<uint64_t>(sample_count, 1)) - 1.0;
+    return static_cast<float>(weighted_log_average / 254.0 * exposure_histogram_log_luminance_range + exposure_histogram_min_log_luminance);
+}
+
+static bool histogram_empty(std::span<const uint32_t> bins) {
+    return std::all_of(bins.begin() + 1, bins.end(), [](uint32_t count) { return count == 0; });
+}
+
+void exposure_metering_report_add(ExposureMeteringReport* report, std::span<const uint32_t> metered_bins, std::span<const uint32_t> reference_bins) {
+    if (histogram_empty(metered_bins) || histogram_empty(reference_bins)) {
+        return;
+    }
+
+    const float error = std::abs(histogram_average_log_luminance(metered_bins) - histogram_average_log_luminance(reference_bins));
+    report->error_sum += error;
+    report->max_error = std::max(report->max_error, error);
+    report->frame_count++;
+}
+
+void exposure_metering_report_log(ExposureMeteringReport* report, uint32_t metering_scale) {
+    if (report->frame_count == 0) {
+        return;
+    }
+
+    std::cout << "Exposure metering at 1/" << metering_scale << " scale vs full resolution over " << report->frame_count
+              << " frames: avg error " << report->error_sum / report->frame_count << " EV, max error " << report->max_error << " EV" << std::endl;
+
+    *report = ExposureMeteringReport{};
+}
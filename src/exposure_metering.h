@@ -0,0 +1,27 @@
+#pragma once
+#include "common.h"
+
+#include <span>
+
+// bin layout of build_exposure_histogram.comp. bin 0 holds near black samples, the rest cover log2 luminance
+// [exposure_histogram_min_log_luminance, exposure_histogram_min_log_luminance + exposure_histogram_log_luminance_range]
+inline constexpr uint32_t exposure_histogram_bin_count           = 256;
+inline constexpr float    exposure_histogram_min_log_luminance   = -1.f;
+inline constexpr float    exposure_histogram_log_luminance_range = 15.f;
+
+// log2 of the average luminance a histogram meters, computed the same way average_exposure_histogram.comp does before adaptation
+[[nodiscard]] float histogram_average_log_luminance(std::span<const uint32_t> bins);
+
+// running comparison of the reduced resolution histogram against a full resolution one built from the same frame.
+// errors are in EV, so 1 means the metered luminance is off by a factor of two
+struct ExposureMeteringReport {
+    double   error_sum{};
+    float    max_error{};
+    uint32_t frame_count{};
+};
+
+// frames where either histogram is empty (nothing read back yet) are skipped
+void exposure_metering_report_add(ExposureMeteringReport* report, std::span<const uint32_t> metered_bins, std::span<const uint32_t> reference_bins);
+
+// logs the errors accumulated since the last call and starts over
+void exposure_metering_report_log(ExposureMeteringReport* report, uint32_t metering_scale);
@@ -8,7 +8,10 @@ struct Frame {
     VkFence            in_flight_fence{};
     VkRenderingInfoKHR rendering_info{};
     VkCommandBuffer    command_buffer{};
+    // with async compute the post processing is recorded into compute_command_buffer and submitted to the compute queue once
+    // graphics_finished_semaphore signals
+    VkCommandBuffer compute_command_buffer{};
+    VkSemaphore     graphics_finished_semaphore{};
 };
 
-std::vector<Frame> frames_create(VkDevice device, VkCommandPool command_pool, std::span<const VkImageView> frame_image_views,
-                                 std::span<const VkImage> frame_images, uint32_t queue_family_index, VkImageView msaa_image_view);
+std::vector<Frame> frames_create(VkDevice device, VkCommandPool command_pool, VkCommandPool compute_command_pool, uint32_t frame_count);
@@ -0,0 +1,213 @@
+#include "geometry_encoding.h"
+
+#include "trace.h"
+
+#include <functional>
+
+// largest dispatch the arena copies issue. the shaders loop over whatever doesn't fit
+static constexpr uint32_t arena_copy_max_workgroups = 65535;
+
+// per primitive results of the index copy. matches IndexStatsBuffer in arena_copy.comp
+struct IndexStats {
+    uint32_t max_index{};
+    uint32_t non_white_color{};
+};
+
+static AllocatedBuffer buffer_create(VmaAllocator allocator, VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage,
+                                     VmaMemoryUsage memory_usage, VmaAllocationCreateFlags allocation_flags = 0) {
+    VkBufferCreateInfo      buffer_ci = vk_lib::buffer_create_info(usage | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, size);
+    VmaAllocationCreateInfo allocation_ci{};
+    allocation_ci.usage = memory_usage;
+    allocation_ci.flags = allocation_flags;
+
+    AllocatedBuffer buffer{};
+    VK_CHECK(vmaCreateBuffer(allocator, &buffer_ci, &allocation_ci, &buffer.buffer, &buffer.allocation, &buffer.allocation_info));
+
+    VkBufferDeviceAddressInfo buffer_device_ai = vk_lib::buffer_device_address_info(buffer.buffer);
+    buffer.address                             = vkGetBufferDeviceAddress(device, &buffer_device_ai);
+    return buffer;
+}
+
+static void submit_and_wait(VkDevice device, VkCommandPool command_pool, VkQueue queue, const std::function<void(VkCommandBuffer)>& record) {
+    VkFence                 fence{};
+    const VkFenceCreateInfo fence_ci = vk_lib::fence_create_info();
+    VK_CHECK(vkCreateFence(device, &fence_ci, nullptr, &fence));
+
+    const VkCommandBufferAllocateInfo command_buffer_ai = vk_lib::command_buffer_allocate_info(command_pool);
+    VkCommandBuffer                   cmd_buf;
+    VK_CHECK(vkAllocateCommandBuffers(device, &command_buffer_ai, &cmd_buf));
+
+    const VkCommandBufferBeginInfo command_buffer_bi = vk_lib::command_buffer_begin_info();
+    VK_CHECK(vkBeginCommandBuffer(cmd_buf, &command_buffer_bi));
+    record(cmd_buf);
+    VK_CHECK(vkEndCommandBuffer(cmd_buf));
+
+    const VkCommandBufferSubmitInfo command_buffer_submit_info = vk_lib::command_buffer_submit_info(cmd_buf);
+    const VkSubmitInfo2             submit_info_2              = vk_lib::submit_info_2(&command_buffer_submit_info);
+    VK_CHECK(vkQueueSubmit2(queue, 1, &submit_info_2, fence));
+    VK_CHECK(vkWaitForFences(device, 1, &fence, true, UINT64_MAX));
+
+    vkFreeCommandBuffers(device, command_pool, 1, &cmd_buf);
+    vkDestroyFence(device, fence, nullptr);
+}
+
+static uint32_t arena_copy_group_count(uint32_t element_count) { return std::min((element_count + 255) / 256, arena_copy_max_workgroups); }
+
+static void record_arena_copy(const GeometryEncodePipelines* pipelines, VkCommandBuffer cmd_buf, const ArenaCopyPushConstants* push_constants) {
+    vkCmdPushConstants(cmd_buf, pipelines->arena_copy_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ArenaCopyPushConstants), push_constants);
+    vkCmdDispatch(cmd_buf, arena_copy_group_count(push_constants->element_count), 1, 1);
+}
+
+EncodedGeometry geometry_encode(VkDevice device, VmaAllocator allocator, VkCommandPool command_pool, VkQueue queue,
+                                const GeometryEncodePipelines* pipelines, std::span<const vk_gltf::GltfPrimitive* const> primitives,
+                                bool compact_vertices) {
+    TRACE_ZONE("geometry_encode");
+
+    EncodedGeometry encoded{};
+    encoded.geometries.resize(primitives.size());
+    if (primitives.empty()) {
+        return encoded;
+    }
+
+    for (uint32_t i = 0; i < primitives.size(); i++) {
+        const vk_gltf::GltfPrimitive* primitive = primitives[i];
+        if (!primitive->index_buffer.has_value()) {
+            abort_message("currently not handling GLTF assets without index buffers");
+        }
+        if (primitive->index_type != VK_INDEX_TYPE_UINT16 && primitive->index_type != VK_INDEX_TYPE_UINT32) {
+            abort_message("Only 16 and 32 bit index buffers can be copied into the geometry arena");
+        }
+        encoded.geometries[i].first_index = encoded.index_count;
+        encoded.geometries[i].index_count = primitive->index_count;
+        encoded.index_count += primitive->index_count;
+    }
+
+    if (encoded.index_count > 0) {
+        encoded.index_buffer =
+            buffer_create(allocator, device, static_cast<VkDeviceSize>(encoded.index_count) * sizeof(uint32_t),
+                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE);
+    }
+    AllocatedBuffer index_stats_buffer =
+        buffer_create(allocator, device, primitives.size() * sizeof(IndexStats),
+                      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_AUTO_PREFER_HOST,
+                      VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT);
+
+    submit_and_wait(device, command_pool, queue, [&](VkCommandBuffer cmd_buf) {
+        vkCmdFillBuffer(cmd_buf, index_stats_buffer.buffer, 0, VK_WHOLE_SIZE, 0);
+
+        const VkBufferMemoryBarrier2 index_stats_clear_buffer_memory_barrier = vk_lib::buffer_memory_barrier_2(
+            index_stats_buffer.buffer, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT);
+        const VkDependencyInfo index_stats_clear_dependency_info =
+            vk_lib::dependency_info(nullptr, &index_stats_clear_buffer_memory_barrier, nullptr);
+        vkCmdPipelineBarrier2(cmd_buf, &index_stats_clear_dependency_info);
+
+        vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines->arena_copy);
+
+        for (uint32_t i = 0; i < primitives.size(); i++) {
+            ArenaCopyPushConstants push_constants{};
+            push_constants.src_buf_address         = primitives[i]->index_buffer->address;
+            push_constants.dst_buf_address         = encoded.index_buffer.address + encoded.geometries[i].first_index * sizeof(uint32_t);
+            push_constants.index_stats_buf_address = index_stats_buffer.address + i * sizeof(IndexStats);
+            push_constants.vertex_buf_address      = primitives[i]->vertex_buffer.address;
+            push_constants.element_count           = encoded.geometries[i].index_count;
+            push_constants.src_element_size        = primitives[i]->index_type == VK_INDEX_TYPE_UINT16 ? 2 : 4;
+            record_arena_copy(pipelines, cmd_buf, &push_constants);
+        }
+
+        const VkBufferMemoryBarrier2 index_stats_read_buffer_memory_barrier =
+            vk_lib::buffer_memory_barrier_2(index_stats_buffer.buffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_2_HOST_BIT,
+                                            VK_ACCESS_2_SHADER_WRITE_BIT, VK_ACCESS_2_HOST_READ_BIT);
+        const VkDependencyInfo index_stats_read_dependency_info =
+            vk_lib::dependency_info(nullptr, &index_stats_read_buffer_memory_barrier, nullptr);
+        vkCmdPipelineBarrier2(cmd_buf, &index_stats_read_dependency_info);
+    });
+
+    VK_CHECK(vmaInvalidateAllocation(allocator, index_stats_buffer.allocation, 0, VK_WHOLE_SIZE));
+    const IndexStats* index_stats = static_cast<const IndexStats*>(index_stats_buffer.allocation_info.pMappedData);
+
+    VertexFormat vertex_format = VertexFormat::full;
+    if (compact_vertices) {
+        vertex_format = VertexFormat::compact_no_color;
+        for (uint32_t i = 0; i < primitives.size(); i++) {
+            if (index_stats[i].non_white_color != 0) {
+                vertex_format = VertexFormat::compact;
+                break;
+            }
+        }
+    }
+    const uint32_t vertex_stride = vertex_format_stride(vertex_format);
+
+    // vertices are packed in whole strides, so every primitive's range stays aligned to it wherever the arena puts them
+    uint32_t vertex_count = 0;
+    for (uint32_t i = 0; i < primitives.size(); i++) {
+        ArenaGeometry* geometry = &encoded.geometries[i];
+        geometry->vertex_offset = static_cast<int32_t>(vertex_count);
+        geometry->vertex_count  = geometry->index_count > 0 ? index_stats[i].max_index + 1 : 0;
+        geometry->vertex_format = vertex_format;
+        vertex_count += geometry->vertex_count;
+
+        if (vertex_format != VertexFormat::full) {
+            const glm::vec3 origin   = glm::make_vec3(primitives[i]->bounds.origin);
+            const glm::vec3 extent   = glm::make_vec3(primitives[i]->bounds.extent);
+            geometry->position_base  = origin - extent;
+            geometry->position_scale = extent * 2.f;
+        }
+    }
+    encoded.vertex_word_count = vertex_count * vertex_stride;
+
+    vmaDestroyBuffer(allocator, index_stats_buffer.buffer, index_stats_buffer.allocation);
+
+    if (encoded.vertex_word_count == 0) {
+        return encoded;
+    }
+    encoded.vertex_buffer =
+        buffer_create(allocator, device, static_cast<VkDeviceSize>(encoded.vertex_word_count) * sizeof(uint32_t),
+                      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE);
+
+    submit_and_wait(device, command_pool, queue, [&](VkCommandBuffer cmd_buf) {
+        if (vertex_format == VertexFormat::full) {
+            vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines->arena_copy);
+        } else {
+            vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines->encode_vertices);
+        }
+
+        for (uint32_t i = 0; i < primitives.size(); i++) {
+            const ArenaGeometry* geometry           = &encoded.geometries[i];
+            const VkDeviceSize   vertex_byte_offset = static_cast<VkDeviceSize>(geometry->vertex_offset) * vertex_stride * sizeof(uint32_t);
+
+            if (vertex_format == VertexFormat::full) {
+                // full vertices are copied as 32 bit words
+                ArenaCopyPushConstants push_constants{};
+                push_constants.src_buf_address  = primitives[i]->vertex_buffer.address;
+                push_constants.dst_buf_address  = encoded.vertex_buffer.address + vertex_byte_offset;
+                push_constants.element_count    = geometry->vertex_count * vertex_stride;
+                push_constants.src_element_size = 4;
+                record_arena_copy(pipelines, cmd_buf, &push_constants);
+            } else {
+                EncodeVerticesPushConstants push_constants{};
+                push_constants.src_vertex_buf_address = primitives[i]->vertex_buffer.address;
+                push_constants.dst_vertex_buf_address = encoded.vertex_buffer.address + vertex_byte_offset;
+                push_constants.position_base          = geometry->position_base;
+                push_constants.vertex_count           = geometry->vertex_count;
+                push_constants.position_scale         = geometry->position_scale;
+                push_constants.vertex_format          = static_cast<uint32_t>(vertex_format);
+                vkCmdPushConstants(cmd_buf, pipelines->encode_vertices_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(EncodeVerticesPushConstants),
+                                   &push_constants);
+                vkCmdDispatch(cmd_buf, arena_copy_group_count(geometry->vertex_count), 1, 1);
+            }
+        }
+    });
+
+    return encoded;
+}
+
+void encoded_geometry_destroy(VmaAllocator allocator, EncodedGeometry* geometry) {
+    if (geometry->index_buffer.buffer != nullptr) {
+        vmaDestroyBuffer(allocator, geometry->index_buffer.buffer, geometry->index_buffer.allocation);
+    }
+    if (geometry->vertex_buffer.buffer != nullptr) {
+        vmaDestroyBuffer(allocator, geometry->vertex_buffer.buffer, geometry->vertex_buffer.allocation);
+    }
+    *geometry = {};
+}
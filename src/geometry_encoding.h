@@ -0,0 +1,93 @@
+#pragma once
+#include "common.h"
+
+#include <span>
+#include <vk_gltf/loader.h>
+
+// gpu encoding of glTF primitives into the layout the renderer's geometry arena stores them in: 32 bit indices and
+// vertices in one VertexFormat per asset. runs on the queue the primitives were loaded on and waits for it, so loader
+// threads can do it before an asset is handed over and the render thread only copies the result into the arena
+
+// how an asset's vertices are stored in the geometry arena. picked per asset at load time. matches the VERTEX_FORMAT_
+// defines in common.glsl
+enum class VertexFormat : uint32_t {
+    // Vertex in common.glsl, as written by the loader
+    full,
+    // quantized position, octahedral normal and tangent, half float uvs and unorm8 color
+    compact,
+    // compact without color, for assets whose vertices are all white
+    compact_no_color,
+};
+
+// sizes in 32 bit words. the arena is addressed in words so every format can share it
+[[nodiscard]] constexpr uint32_t vertex_format_stride(VertexFormat format) {
+    switch (format) {
+    case VertexFormat::full:
+        return 18;
+    case VertexFormat::compact:
+        return 7;
+    case VertexFormat::compact_no_color:
+        return 6;
+    }
+    return 0;
+}
+
+struct ArenaCopyPushConstants {
+    VkDeviceAddress src_buf_address{};
+    VkDeviceAddress dst_buf_address{};
+    // receives the largest copied index and whether a referenced vertex isn't white. 0 when copying vertices
+    VkDeviceAddress index_stats_buf_address{};
+    // vertices checked for color while copying indices
+    VkDeviceAddress vertex_buf_address{};
+    uint32_t        element_count{};
+    uint32_t        src_element_size{};
+};
+
+struct EncodeVerticesPushConstants {
+    VkDeviceAddress src_vertex_buf_address{};
+    VkDeviceAddress dst_vertex_buf_address{};
+    glm::vec3       position_base{};
+    uint32_t        vertex_count{};
+    glm::vec3       position_scale{};
+    uint32_t        vertex_format{};
+};
+
+// arena_copy.comp and encode_vertices.comp, created by the renderer
+struct GeometryEncodePipelines {
+    VkPipeline       arena_copy{};
+    VkPipelineLayout arena_copy_layout{};
+    VkPipeline       encode_vertices{};
+    VkPipelineLayout encode_vertices_layout{};
+};
+
+struct ArenaGeometry {
+    uint32_t first_index{};
+    uint32_t index_count{};
+    // in vertices of vertex_format. the vertex range starts at vertex_offset * stride words
+    int32_t      vertex_offset{};
+    uint32_t     vertex_count{};
+    VertexFormat vertex_format{};
+    // compact positions are unorm16 across the primitive bounds. position = base + scale * quantized
+    glm::vec3 position_base{};
+    glm::vec3 position_scale{1.f};
+};
+
+// an asset's primitives, encoded and packed back to back. geometries are offsets into these buffers until the renderer
+// copies them into the arena. the buffers are null when there's nothing to hold
+struct EncodedGeometry {
+    AllocatedBuffer index_buffer{};
+    AllocatedBuffer vertex_buffer{};
+    // in indices and 32 bit words
+    uint32_t                   index_count{};
+    uint32_t                   vertex_word_count{};
+    std::vector<ArenaGeometry> geometries{};
+};
+
+// encodes the primitives in order. vertex counts aren't known up front, so the index copy also finds every primitive's
+// largest index before the vertices get encoded. the vertex format is picked once for all of them: compact unless
+// disabled, without color when every referenced vertex is white. queue has to be of the graphics family
+[[nodiscard]] EncodedGeometry geometry_encode(VkDevice device, VmaAllocator allocator, VkCommandPool command_pool, VkQueue queue,
+                                              const GeometryEncodePipelines* pipelines, std::span<const vk_gltf::GltfPrimitive* const> primitives,
+                                              bool compact_vertices);
+
+void encoded_geometry_destroy(VmaAllocator allocator, EncodedGeometry* geometry);
@@ -0,0 +1,210 @@
+#include "gpu_profiler.h"
+
+#include <iomanip>
+
+const char* gpu_pass_name(GpuPass pass) {
+    switch (pass) {
+    case GpuPass::shadow_map:
+        return "shadow_map";
+    case GpuPass::draw_cull:
+        return "draw_cull";
+    case GpuPass::depth_pre:
+        return "depth_pre";
+    case GpuPass::hiz_build:
+        return "hiz_build";
+    case GpuPass::occlusion_cull:
+        return "occlusion_cull";
+    case GpuPass::main:
+        return "main";
+    case GpuPass::build_histogram:
+        return "build_histogram";
+    case GpuPass::average_histogram:
+        return "average_histogram";
+    case GpuPass::color_correct:
+        return "color_correct";
+    default:
+        return "unknown";
+    }
+}
+
+void gpu_profiler_create(GpuProfiler* profiler, VkPhysicalDevice physical_device, VkDevice device, std::span<const uint32_t> queue_families,
+                         uint32_t frame_count, uint32_t log_interval, const std::filesystem::path& csv_path) {
+    *profiler              = GpuProfiler{};
+    profiler->log_interval = log_interval;
+
+    uint32_t family_property_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_property_count, nullptr);
+    std::vector<VkQueueFamilyProperties> queue_family_properties(family_property_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_property_count, queue_family_properties.data());
+
+    uint32_t valid_bits = 64;
+    for (uint32_t queue_family : queue_families) {
+        valid_bits = std::min(valid_bits, queue_family_properties[queue_family].timestampValidBits);
+    }
+    if (valid_bits == 0) {
+        std::cout << "GPU profiler disabled: a queue family does not support timestamps" << std::endl;
+        return;
+    }
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+    profiler->timestamp_period = properties.limits.timestampPeriod;
+    profiler->timestamp_mask   = valid_bits >= 64 ? UINT64_MAX : (uint64_t{1} << valid_bits) - 1;
+
+    VkQueryPoolCreateInfo query_pool_ci{};
+    query_pool_ci.sType      = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    query_pool_ci.queryType  = VK_QUERY_TYPE_TIMESTAMP;
+    query_pool_ci.queryCount = gpu_pass_count * 2;
+
+    profiler->query_pools.resize(frame_count);
+    profiler->pool_written.resize(frame_count, false);
+    for (VkQueryPool& query_pool : profiler->query_pools) {
+        VK_CHECK(vkCreateQueryPool(device, &query_pool_ci, nullptr, &query_pool));
+    }
+
+    if (!csv_path.empty()) {
+        profiler->csv_file.open(csv_path);
+        if (!profiler->csv_file.is_open()) {
+            abort_message("Failed to open GPU profiler csv file");
+        }
+        profiler->csv_file << "frame";
+        for (uint32_t i = 0; i < gpu_pass_count; i++) {
+            profiler->csv_file << "," << gpu_pass_name(static_cast<GpuPass>(i)) << "_ms";
+        }
+        profiler->csv_file << "\n";
+    }
+
+    profiler->enabled = true;
+}
+
+void gpu_profiler_destroy(GpuProfiler* profiler, VkDevice device) {
+    for (VkQueryPool query_pool : profiler->query_pools) {
+        vkDestroyQueryPool(device, query_pool, nullptr);
+    }
+    *profiler = GpuProfiler{};
+}
+
+static void update_pass_stats(GpuProfiler* profiler, uint32_t pass_index) {
+    const uint32_t                                      count   = profiler->history_count[pass_index];
+    const std::array<float, gpu_profiler_history_size>& history = profiler->history[pass_index];
+
+    std::array<float, gpu_profiler_history_size> sorted_history;
+    std::copy_n(history.begin(), count, sorted_history.begin());
+    std::sort(sorted_history.begin(), sorted_history.begin() + count);
+
+    float sum = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        sum += sorted_history[i];
+    }
+
+    GpuPassStats* stats = &profiler->stats[pass_index];
+    stats->min_ms       = sorted_history[0];
+    stats->avg_ms       = sum / static_cast<float>(count);
+    stats->p99_ms       = sorted_history[std::min(count - 1, (count * 99) / 100)];
+}
+
+static void resolve_queries(GpuProfiler* profiler, VkDevice device, uint32_t frame_index) {
+    // each query is a (timestamp, availability) pair
+    std::array<uint64_t, gpu_pass_count * 2 * 2> query_results{};
+
+    const VkResult result = vkGetQueryPoolResults(device, profiler->query_pools[frame_index], 0, gpu_pass_count * 2, sizeof(query_results),
+                                                  query_results.data(), sizeof(uint64_t) * 2,
+                                                  VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if (result != VK_SUCCESS && result != VK_NOT_READY) {
+        VK_CHECK(result);
+    }
+
+    if (profiler->csv_file.is_open()) {
+        profiler->csv_file << profiler->resolved_frames;
+    }
+
+    for (uint32_t pass_index = 0; pass_index < gpu_pass_count; pass_index++) {
+        const uint64_t* begin_query = &query_results[pass_index * 4];
+        const uint64_t* end_query   = &query_results[pass_index * 4 + 2];
+
+        // passes that were skipped this frame never wrote their queries
+        if (begin_query[1] == 0 || end_query[1] == 0) {
+            if (profiler->csv_file.is_open()) {
+                profiler->csv_file << ",";
+            }
+            continue;
+        }
+
+        const uint64_t ticks = (end_query[0] - begin_query[0]) & profiler->timestamp_mask;
+        const float    ms    = static_cast<float>(static_cast<double>(ticks) * profiler->timestamp_period / 1'000'000.0);
+
+        uint32_t* head                       = &profiler->history_head[pass_index];
+        profiler->history[pass_index][*head] = ms;
+        *head                                = (*head + 1) % gpu_profiler_history_size;
+        profiler->history_count[pass_index]  = std::min(profiler->history_count[pass_index] + 1, gpu_profiler_history_size);
+        profiler->stats[pass_index].last_ms  = ms;
+
+        update_pass_stats(profiler, pass_index);
+
+        if (profiler->csv_file.is_open()) {
+            profiler->csv_file << "," << ms;
+        }
+    }
+
+    if (profiler->csv_file.is_open()) {
+        profiler->csv_file << "\n";
+    }
+
+    profiler->resolved_frames++;
+
+    if (profiler->log_interval != 0 && profiler->resolved_frames % profiler->log_interval == 0) {
+        gpu_profiler_log(profiler);
+    }
+}
+
+void gpu_profiler_begin_frame(GpuProfiler* profiler, VkDevice device, VkCommandBuffer command_buffer, uint32_t frame_index) {
+    if (!profiler->enabled) {
+        return;
+    }
+
+    if (profiler->pool_written[frame_index]) {
+        resolve_queries(profiler, device, frame_index);
+    }
+
+    vkCmdResetQueryPool(command_buffer, profiler->query_pools[frame_index], 0, gpu_pass_count * 2);
+    profiler->pool_written[frame_index] = true;
+}
+
+void gpu_profiler_begin_pass(const GpuProfiler* profiler, VkCommandBuffer command_buffer, uint32_t frame_index, GpuPass pass) {
+    if (!profiler->enabled) {
+        return;
+    }
+    vkCmdWriteTimestamp2(command_buffer, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, profiler->query_pools[frame_index], static_cast<uint32_t>(pass) * 2);
+}
+
+void gpu_profiler_end_pass(const GpuProfiler* profiler, VkCommandBuffer command_buffer, uint32_t frame_index, GpuPass pass) {
+    if (!profiler->enabled) {
+        return;
+    }
+    vkCmdWriteTimestamp2(command_buffer, VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT, profiler->query_pools[frame_index],
+                         static_cast<uint32_t>(pass) * 2 + 1);
+}
+
+const GpuPassStats& gpu_profiler_pass_stats(const GpuProfiler* profiler, GpuPass pass) {
+    return profiler->stats[static_cast<uint32_t>(pass)];
+}
+
+void gpu_profiler_log(const GpuProfiler* profiler) {
+    std::cout << "GPU pass timings over the last " << gpu_profiler_history_size << " frames (ms)" << std::endl;
+    std::cout << std::left << std::setw(20) << "pass" << std::right << std::setw(10) << "last" << std::setw(10) << "min" << std::setw(10) << "avg"
+              << std::setw(10) << "p99" << std::endl;
+
+    float total_avg = 0;
+    for (uint32_t i = 0; i < gpu_pass_count; i++) {
+        if (profiler->history_count[i] == 0) {
+            continue;
+        }
+        const GpuPassStats* stats = &profiler->stats[i];
+        total_avg += stats->avg_ms;
+        std::cout << std::left << std::setw(20) << gpu_pass_name(static_cast<GpuPass>(i)) << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(10) << stats->last_ms << std::setw(10) << stats->min_ms << std::setw(10) << stats->avg_ms << std::setw(10)
+                  << stats->p99_ms << std::endl;
+    }
+    std::cout << std::left << std::setw(20) << "total" << std::right << std::setw(30) << total_avg << std::defaultfloat << std::endl;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include "common.h"
+
+#include <span>
+
+enum class GpuPass : uint32_t {
+    shadow_map,
+    draw_cull,
+    depth_pre,
+    hiz_build,
+    occlusion_cull,
+    main,
+    build_histogram,
+    average_histogram,
+    color_correct,
+    count,
+};
+
+inline constexpr uint32_t gpu_pass_count = static_cast<uint32_t>(GpuPass::count);
+
+struct GpuPassStats {
+    float last_ms{};
+    float min_ms{};
+    float avg_ms{};
+    float p99_ms{};
+};
+
+// number of resolved frames the rolling min/avg/p99 are computed over
+inline constexpr uint32_t gpu_profiler_history_size = 256;
+
+struct GpuProfiler {
+    // one pool per frame in flight. each pass owns a begin and end query
+    std::vector<VkQueryPool> query_pools{};
+    std::vector<bool>        pool_written{};
+    float                    timestamp_period{};
+    uint64_t                 timestamp_mask{};
+    bool                     enabled{};
+
+    std::array<std::array<float, gpu_profiler_history_size>, gpu_pass_count> history{};
+    std::array<uint32_t, gpu_pass_count>                                      history_count{};
+    std::array<uint32_t, gpu_pass_count>                                      history_head{};
+    std::array<GpuPassStats, gpu_pass_count>                                  stats{};
+
+    uint64_t      resolved_frames{};
+    uint32_t      log_interval{};
+    std::ofstream csv_file{};
+};
+
+[[nodiscard]] const char* gpu_pass_name(GpuPass pass);
+
+// log_interval is in resolved frames, 0 disables the periodic log. an empty csv path disables the csv output. queue_families are
+// every family passes are recorded on. a pass begins and ends on the same queue, so only its own timestamps get compared
+void gpu_profiler_create(GpuProfiler* profiler, VkPhysicalDevice physical_device, VkDevice device, std::span<const uint32_t> queue_families,
+                         uint32_t frame_count, uint32_t log_interval, const std::filesystem::path& csv_path);
+
+void gpu_profiler_destroy(GpuProfiler* profiler, VkDevice device);
+
+// must be called after the frame's fence has been waited on. the queries of this slot were written frame_count frames ago, so reading
+// them back never stalls. also resets the slot's pool for the new frame
+void gpu_profiler_begin_frame(GpuProfiler* profiler, VkDevice device, VkCommandBuffer command_buffer, uint32_t frame_index);
+
+void gpu_profiler_begin_pass(const GpuProfiler* profiler, VkCommandBuffer command_buffer, uint32_t frame_index, GpuPass pass);
+
+void gpu_profiler_end_pass(const GpuProfiler* profiler, VkCommandBuffer command_buffer, uint32_t frame_index, GpuPass pass);
+
+[[nodiscard]] const GpuPassStats& gpu_profiler_pass_stats(const GpuProfiler* profiler, GpuPass pass);
+
+void gpu_profiler_log(const GpuProfiler* profiler);
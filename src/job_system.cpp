@@ -0,0 +1,101 @@
+#include "job_system.h"
+
+#include "trace.h"
+
+// job and job_count are copies taken under the mutex along with generation
+static void run_jobs(JobSystem* job_system, const JobFunction* job, uint32_t job_count, uint32_t generation, uint32_t thread_index) {
+    uint64_t next_job = job_system->next_job.load(std::memory_order_relaxed);
+    for (;;) {
+        const uint32_t job_index = static_cast<uint32_t>(next_job);
+        if (static_cast<uint32_t>(next_job >> 32) != generation || job_index >= job_count) {
+            return;
+        }
+        if (!job_system->next_job.compare_exchange_weak(next_job, next_job + 1, std::memory_order_relaxed)) {
+            continue;
+        }
+        (*job)(job_index, thread_index);
+
+        if (job_system->remaining_jobs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::lock_guard lock(job_system->mutex);
+            job_system->work_done.notify_all();
+        }
+    }
+}
+
+static void worker_main(JobSystem* job_system, uint32_t thread_index) {
+    TRACE_THREAD_NAME("job_worker");
+
+    uint32_t seen_generation = 0;
+    for (;;) {
+        const JobFunction* job;
+        uint32_t           job_count;
+        {
+            std::unique_lock lock(job_system->mutex);
+            job_system->work_available.wait(lock, [&] { return job_system->stopping || job_system->generation != seen_generation; });
+            if (job_system->stopping) {
+                return;
+            }
+            seen_generation = job_system->generation;
+            job             = job_system->job;
+            job_count       = job_system->job_count;
+        }
+
+        run_jobs(job_system, job, job_count, seen_generation, thread_index);
+    }
+}
+
+void job_system_create(JobSystem* job_system, uint32_t worker_count) {
+    job_system->workers.reserve(worker_count);
+    for (uint32_t i = 0; i < worker_count; i++) {
+        job_system->workers.emplace_back(worker_main, job_system, i + 1);
+    }
+}
+
+void job_system_destroy(JobSystem* job_system) {
+    {
+        std::lock_guard lock(job_system->mutex);
+        job_system->stopping = true;
+    }
+    job_system->work_available.notify_all();
+
+    for (std::thread& worker : job_system->workers) {
+        worker.join();
+    }
+    job_system->workers.clear();
+}
+
+JobSystem::~JobSystem() { job_system_destroy(this); }
+
+uint32_t job_system_thread_count(const JobSystem* job_system) { return job_system->workers.size() + 1; }
+
+void job_system_parallel_for(JobSystem* job_system, uint32_t job_count, const JobFunction& job) {
+    if (job_count == 0) {
+        return;
+    }
+    // not worth waking anyone up
+    if (job_count == 1 || job_system->workers.empty()) {
+        for (uint32_t i = 0; i < job_count; i++) {
+            job(i, 0);
+        }
+        return;
+    }
+
+    uint32_t generation;
+    {
+        std::lock_guard lock(job_system->mutex);
+        generation            = ++job_system->generation;
+        job_system->job       = &job;
+        job_system->job_count = job_count;
+        job_system->next_job.store(static_cast<uint64_t>(generation) << 32, std::memory_order_relaxed);
+        job_system->remaining_jobs.store(job_count, std::memory_order_relaxed);
+    }
+    job_system->work_available.notify_all();
+
+    run_jobs(job_system, &job, job_count, generation, 0);
+
+    // a worker that claimed an index holds remaining_jobs above 0 until its job returns. late ones find the generation
+    // moved on and claim nothing
+    std::unique_lock lock(job_system->mutex);
+    job_system->work_done.wait(lock, [&] { return job_system->remaining_jobs.load(std::memory_order_acquire) == 0; });
+    job_system->job = nullptr;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "common.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// fixed pool of worker threads for fork-join work inside a frame. the calling thread joins in, so thread index 0 is
+// always the caller and workers are 1..worker_count
+using JobFunction = std::function<void(uint32_t job_index, uint32_t thread_index)>;
+
+struct JobSystem {
+    std::vector<std::thread> workers{};
+
+    std::mutex              mutex{};
+    std::condition_variable work_available{};
+    std::condition_variable work_done{};
+    uint32_t                generation{};
+    bool                    stopping{};
+
+    const JobFunction* job{};
+    uint32_t           job_count{};
+    // generation in the high 32 bits, next job index in the low ones. a worker only claims indices of the generation it
+    // woke up for, so one that wakes late can't run jobs of the next parallel_for
+    std::atomic<uint64_t> next_job{};
+    std::atomic<uint32_t> remaining_jobs{};
+
+    ~JobSystem();
+};
+
+void job_system_create(JobSystem* job_system, uint32_t worker_count);
+
+void job_system_destroy(JobSystem* job_system);
+
+[[nodiscard]] uint32_t job_system_thread_count(const JobSystem* job_system);
+
+// runs job(i, thread_index) for i in [0, job_count) and returns once every job finished
+void job_system_parallel_for(JobSystem* job_system, uint32_t job_count, const JobFunction& job);
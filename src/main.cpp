@@ -2,10 +2,101 @@
 
 #include "renderer.h"
 
-int main() {
+#include <cstring>
+#include <string>
+
+// usage: photometric_camera [--headless] [--width W] [--height H] [--frames N] [--output image.ppm] [--gpu-profile-csv timings.csv]
+//        [--gpu-driven] [--full-vertices] [--record-threads N] [--shadow-cascades N] [--shadow-resolution R] [--shadow-distance D]
+//        [--no-occlusion-cull] [--hdr-format rgba32f|rgba16f|rg11b10f] [--metering-scale 1|2|4|8] [--metering-report]
+//        [--async-compute] [--asset-memory-budget F] [--no-texture-streaming]
+//        [--no-texture-compression] [--trace trace.json] (needs a PHOTOMETRIC_TRACE build)
+static VkFormat parse_hdr_format(const char* name) {
+    if (strcmp(name, "rgba32f") == 0) {
+        return VK_FORMAT_R32G32B32A32_SFLOAT;
+    }
+    if (strcmp(name, "rgba16f") == 0) {
+        return VK_FORMAT_R16G16B16A16_SFLOAT;
+    }
+    if (strcmp(name, "rg11b10f") == 0) {
+        return VK_FORMAT_B10G11R11_UFLOAT_PACK32;
+    }
+    abort_message(std::string("Unknown hdr format: ") + name);
+}
+
+int main(int argc, char** argv) {
+    TRACE_THREAD_NAME("main");
+
+    RendererOptions options{};
+    uint32_t        headless_frames = 100;
+    const char*     output_path     = nullptr;
+    const char*     trace_path      = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        const bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--headless") == 0) {
+            options.headless = true;
+        } else if (strcmp(argv[i], "--width") == 0 && has_value) {
+            options.headless_extent.width = std::stoul(argv[++i]);
+        } else if (strcmp(argv[i], "--height") == 0 && has_value) {
+            options.headless_extent.height = std::stoul(argv[++i]);
+        } else if (strcmp(argv[i], "--frames") == 0 && has_value) {
+            headless_frames = std::stoul(argv[++i]);
+        } else if (strcmp(argv[i], "--output") == 0 && has_value) {
+            output_path = argv[++i];
+        } else if (strcmp(argv[i], "--gpu-profile-csv") == 0 && has_value) {
+            options.gpu_profiler_csv_path = argv[++i];
+        } else if (strcmp(argv[i], "--gpu-driven") == 0) {
+            options.gpu_driven = true;
+        } else if (strcmp(argv[i], "--full-vertices") == 0) {
+            options.compact_vertices = false;
+        } else if (strcmp(argv[i], "--record-threads") == 0 && has_value) {
+            options.record_thread_count = std::stoul(argv[++i]);
+        } else if (strcmp(argv[i], "--shadow-cascades") == 0 && has_value) {
+            options.shadow_cascade_count = std::stoul(argv[++i]);
+        } else if (strcmp(argv[i], "--shadow-resolution") == 0 && has_value) {
+            options.shadow_cascade_resolution = std::stoul(argv[++i]);
+        } else if (strcmp(argv[i], "--shadow-distance") == 0 && has_value) {
+            options.shadow_distance = std::stof(argv[++i]);
+        } else if (strcmp(argv[i], "--no-occlusion-cull") == 0) {
+            options.occlusion_culling = false;
+        } else if (strcmp(argv[i], "--hdr-format") == 0 && has_value) {
+            options.hdr_format = parse_hdr_format(argv[++i]);
+        } else if (strcmp(argv[i], "--metering-scale") == 0 && has_value) {
+            options.exposure_metering_scale = std::stoul(argv[++i]);
+        } else if (strcmp(argv[i], "--metering-report") == 0) {
+            options.exposure_metering_report = true;
+        } else if (strcmp(argv[i], "--async-compute") == 0) {
+            options.async_compute = true;
+        } else if (strcmp(argv[i], "--asset-memory-budget") == 0 && has_value) {
+            options.asset_memory_budget_fraction = std::stof(argv[++i]);
+        } else if (strcmp(argv[i], "--no-texture-streaming") == 0) {
+            options.stream_textures = false;
+        } else if (strcmp(argv[i], "--no-texture-compression") == 0) {
+            options.compress_textures = false;
+        } else if (strcmp(argv[i], "--trace") == 0 && has_value) {
+            trace_path = argv[++i];
+        } else {
+            abort_message(std::string("Unknown argument: ") + argv[i]);
+        }
+    }
 
     Renderer renderer{};
-    renderer_create(&renderer);
+    renderer_create(&renderer, &options);
+
+    if (options.headless) {
+        // captures have to show the whole scene
+        renderer_wait_for_asset_loads(&renderer);
+        for (uint32_t i = 0; i < headless_frames; i++) {
+            renderer_draw(&renderer);
+        }
+        if (output_path != nullptr) {
+            renderer_save_headless_image(&renderer, output_path);
+        }
+        if (trace_path != nullptr) {
+            trace_write_chrome_json(trace_path);
+        }
+        return 0;
+    }
 
     while (!glfwWindowShouldClose(renderer.window.glfw_window)) {
         glfwPollEvents();
@@ -17,4 +108,8 @@ int main() {
         }
         renderer_draw(&renderer);
     }
-}
\ No newline at end of file
+
+    if (trace_path != nullptr) {
+        trace_write_chrome_json(trace_path);
+    }
+}
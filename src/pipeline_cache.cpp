@@ -0,0 +1,116 @@
+#include "pipeline_cache.h"
+
+#include "trace.h"
+
+#include <cstring>
+
+// bumped whenever the file layout changes
+static constexpr uint32_t pipeline_cache_version = 1;
+static constexpr uint32_t pipeline_cache_magic   = 0x43505050; // "PPPC"
+
+struct PipelineCacheHeader {
+    uint32_t                          magic{};
+    uint32_t                          version{};
+    uint32_t                          vendor_id{};
+    uint32_t                          device_id{};
+    uint32_t                          driver_version{};
+    std::array<uint8_t, VK_UUID_SIZE> pipeline_cache_uuid{};
+    uint64_t                          data_size{};
+};
+
+static PipelineCacheHeader pipeline_cache_header(VkPhysicalDevice physical_device) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+    PipelineCacheHeader header{};
+    header.magic          = pipeline_cache_magic;
+    header.version        = pipeline_cache_version;
+    header.vendor_id      = properties.vendorID;
+    header.device_id      = properties.deviceID;
+    header.driver_version = properties.driverVersion;
+    memcpy(header.pipeline_cache_uuid.data(), properties.pipelineCacheUUID, VK_UUID_SIZE);
+    return header;
+}
+
+// the driver's own header repeats the device and cache uuid. checked too, so a truncated or foreign blob is never passed on
+static bool pipeline_cache_data_matches(const std::vector<char>& data, const PipelineCacheHeader* expected) {
+    VkPipelineCacheHeaderVersionOne driver_header;
+    if (data.size() < sizeof(driver_header)) {
+        return false;
+    }
+    memcpy(&driver_header, data.data(), sizeof(driver_header));
+    return driver_header.headerSize >= sizeof(driver_header) && driver_header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           driver_header.vendorID == expected->vendor_id && driver_header.deviceID == expected->device_id &&
+           memcmp(driver_header.pipelineCacheUUID, expected->pipeline_cache_uuid.data(), VK_UUID_SIZE) == 0;
+}
+
+static std::vector<char> pipeline_cache_read(VkPhysicalDevice physical_device, const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return {};
+    }
+
+    PipelineCacheHeader header{};
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+    const PipelineCacheHeader expected = pipeline_cache_header(physical_device);
+    if (!file || header.magic != expected.magic || header.version != expected.version || header.vendor_id != expected.vendor_id ||
+        header.device_id != expected.device_id || header.driver_version != expected.driver_version ||
+        header.pipeline_cache_uuid != expected.pipeline_cache_uuid) {
+        return {};
+    }
+
+    // a truncated or corrupt header could ask for any size, so it has to account for exactly the rest of the file
+    std::error_code error;
+    const uintmax_t file_size = std::filesystem::file_size(path, error);
+    if (error || file_size < sizeof(header) || header.data_size != file_size - sizeof(header)) {
+        return {};
+    }
+
+    std::vector<char> data(header.data_size);
+    file.read(data.data(), data.size());
+    if (!file || !pipeline_cache_data_matches(data, &expected)) {
+        return {};
+    }
+    return data;
+}
+
+VkPipelineCache pipeline_cache_load(VkDevice device, VkPhysicalDevice physical_device, const std::filesystem::path& path) {
+    TRACE_ZONE("pipeline_cache_load");
+    const std::vector<char> data = pipeline_cache_read(physical_device, path);
+
+    VkPipelineCacheCreateInfo pipeline_cache_ci{VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
+    pipeline_cache_ci.initialDataSize = data.size();
+    pipeline_cache_ci.pInitialData    = data.data();
+
+    VkPipelineCache pipeline_cache;
+    VK_CHECK(vkCreatePipelineCache(device, &pipeline_cache_ci, nullptr, &pipeline_cache));
+    return pipeline_cache;
+}
+
+void pipeline_cache_save(VkDevice device, VkPhysicalDevice physical_device, VkPipelineCache pipeline_cache, const std::filesystem::path& path) {
+    TRACE_ZONE("pipeline_cache_save");
+    size_t data_size = 0;
+    VK_CHECK(vkGetPipelineCacheData(device, pipeline_cache, &data_size, nullptr));
+    std::vector<char> data(data_size);
+    VK_CHECK(vkGetPipelineCacheData(device, pipeline_cache, &data_size, data.data()));
+
+    PipelineCacheHeader header = pipeline_cache_header(physical_device);
+    header.data_size           = data_size;
+
+    std::error_code error;
+    std::filesystem::create_directories(path.parent_path(), error);
+
+    // written next to the cache and moved over it, so a load never sees half a file
+    std::filesystem::path temp_path = path;
+    temp_path += ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(data.data(), data_size);
+        if (!file) {
+            return;
+        }
+    }
+    std::filesystem::rename(temp_path, path, error);
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include "common.h"
+
+// VkPipelineCache kept on disk between runs. the driver's data is stored behind a header naming the device and driver
+// that wrote it, so another gpu or a driver update starts from an empty cache instead of handing the driver stale data
+
+// the cache saved at path when this device and driver wrote it, otherwise an empty one
+[[nodiscard]] VkPipelineCache pipeline_cache_load(VkDevice device, VkPhysicalDevice physical_device, const std::filesystem::path& path);
+
+// failing to write the cache only costs compiling the pipelines again next run, so errors are ignored
+void pipeline_cache_save(VkDevice device, VkPhysicalDevice physical_device, VkPipelineCache pipeline_cache, const std::filesystem::path& path);
@@ -0,0 +1,91 @@
+#include "range_allocator.h"
+
+RangeAllocator range_allocator_create(uint32_t capacity) {
+    RangeAllocator allocator{};
+    allocator.capacity = capacity;
+    if (capacity > 0) {
+        allocator.free_ranges.push_back({0, capacity});
+    }
+    return allocator;
+}
+
+bool range_allocator_allocate(RangeAllocator* allocator, uint32_t size, uint32_t alignment, uint32_t* offset) {
+    if (size == 0) {
+        *offset = 0;
+        return true;
+    }
+
+    for (auto it = allocator->free_ranges.begin(); it != allocator->free_ranges.end(); ++it) {
+        const uint32_t aligned_offset = (it->offset + alignment - 1) / alignment * alignment;
+        const uint32_t padding        = aligned_offset - it->offset;
+        if (it->size < padding + size) {
+            continue;
+        }
+        *offset = aligned_offset;
+
+        // the padding in front stays free
+        const Range remaining{aligned_offset + size, it->size - padding - size};
+        if (padding > 0) {
+            it->size = padding;
+            if (remaining.size > 0) {
+                allocator->free_ranges.insert(std::next(it), remaining);
+            }
+        } else if (remaining.size > 0) {
+            *it = remaining;
+        } else {
+            allocator->free_ranges.erase(it);
+        }
+        allocator->used += size;
+        return true;
+    }
+    return false;
+}
+
+void range_allocator_free(RangeAllocator* allocator, uint32_t offset, uint32_t size) {
+    if (size == 0) {
+        return;
+    }
+
+    std::vector<Range>& free_ranges = allocator->free_ranges;
+
+    auto next = std::lower_bound(free_ranges.begin(), free_ranges.end(), offset, [](const Range& range, uint32_t o) { return range.offset < o; });
+
+    const bool merges_prev = next != free_ranges.begin() && std::prev(next)->offset + std::prev(next)->size == offset;
+    const bool merges_next = next != free_ranges.end() && offset + size == next->offset;
+
+    if (merges_prev && merges_next) {
+        std::prev(next)->size += size + next->size;
+        free_ranges.erase(next);
+    } else if (merges_prev) {
+        std::prev(next)->size += size;
+    } else if (merges_next) {
+        next->offset = offset;
+        next->size += size;
+    } else {
+        free_ranges.insert(next, {offset, size});
+    }
+    allocator->used -= size;
+}
+
+bool range_allocator_is_allocated(const RangeAllocator* allocator, uint32_t offset) {
+    if (offset >= allocator->capacity) {
+        return false;
+    }
+
+    const std::vector<Range>& free_ranges = allocator->free_ranges;
+
+    // the last free range starting at or before offset is the only one that can contain it
+    auto next = std::upper_bound(free_ranges.begin(), free_ranges.end(), offset, [](uint32_t o, const Range& range) { return o < range.offset; });
+    return next == free_ranges.begin() || offset >= std::prev(next)->offset + std::prev(next)->size;
+}
+
+void range_allocator_grow(RangeAllocator* allocator, uint32_t new_capacity) {
+    if (new_capacity <= allocator->capacity) {
+        return;
+    }
+    const uint32_t old_capacity = allocator->capacity;
+    allocator->capacity         = new_capacity;
+    // the new tail is freed like any other range so it merges with a free range at the old end
+    allocator->used += new_capacity - old_capacity;
+    range_allocator_free(allocator, old_capacity, new_capacity - old_capacity);
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include "common.h"
+
+// first-fit sub-allocator over an abstract [0, capacity) range, e.g. elements of a large gpu buffer.
+// freed ranges are merged with their neighbours so the arena doesn't fragment as assets come and go
+struct Range {
+    uint32_t offset{};
+    uint32_t size{};
+};
+
+struct RangeAllocator {
+    uint32_t capacity{};
+    uint32_t used{};
+    // sorted by offset, never adjacent
+    std::vector<Range> free_ranges{};
+};
+
+[[nodiscard]] RangeAllocator range_allocator_create(uint32_t capacity);
+
+// offset is a multiple of alignment. returns false when no free range is large enough. the caller can grow and retry
+[[nodiscard]] bool range_allocator_allocate(RangeAllocator* allocator, uint32_t size, uint32_t alignment, uint32_t* offset);
+
+void range_allocator_free(RangeAllocator* allocator, uint32_t offset, uint32_t size);
+
+// whether the element at offset is part of an allocated range
+[[nodiscard]] bool range_allocator_is_allocated(const RangeAllocator* allocator, uint32_t offset);
+
+// extends the range. existing allocations keep their offsets
+void range_allocator_grow(RangeAllocator* allocator, uint32_t new_capacity);
@@ -1,10 +1,18 @@
 #include "renderer.h"
 
+#include <bit>
 #include <camera.h>
 #include <functional>
+#include <limits>
 
 static Renderer* active_renderer = nullptr;
 
+// headless renderers have no swapchain to derive a frame count from
+static constexpr uint32_t headless_frame_count = 3;
+// single uploads above a quarter of this are split, and images have to fit in a quarter
+static constexpr VkDeviceSize upload_staging_capacity = 64 << 20;
+static constexpr const char*  pipeline_cache_path     = "cache/pipeline_cache.bin";
+
 static void vk_command_immediate_submit(VkDevice device, VkCommandPool command_pool, VkQueue queue,
                                         std::function<void(VkCommandBuffer command_buffer)>&& function) {
 
@@ -35,6 +43,23 @@ static void vk_command_immediate_submit(VkDevice device, VkCommandPool command_p
     vkDestroyFence(device, fence, nullptr);
 }
 
+static AllocatedBuffer allocated_buffer_create(VmaAllocator allocator, VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage,
+                                               VmaMemoryUsage memory_usage, VmaAllocationCreateFlags allocation_flags = 0) {
+    VkBufferCreateInfo      buffer_ci = vk_lib::buffer_create_info(usage, size);
+    VmaAllocationCreateInfo allocation_ci{};
+    allocation_ci.usage = memory_usage;
+    allocation_ci.flags = allocation_flags;
+
+    AllocatedBuffer buffer{};
+    VK_CHECK(vmaCreateBuffer(allocator, &buffer_ci, &allocation_ci, &buffer.buffer, &buffer.allocation, &buffer.allocation_info));
+
+    if (usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
+        VkBufferDeviceAddressInfo buffer_device_ai = vk_lib::buffer_device_address_info(buffer.buffer);
+        buffer.address                             = vkGetBufferDeviceAddress(device, &buffer_device_ai);
+    }
+    return buffer;
+}
+
 static VkShaderModule load_shader(VkDevice device, const std::filesystem::path& path) {
     std::ifstream file(path, std::ios::ate | std::ios::binary);
     if (!file.is_open()) {
@@ -50,12 +75,45 @@ static VkShaderModule load_shader(VkDevice device, const std::filesystem::path&
     return shader_module;
 }
 
+// one pipeline per job, so the driver compiles them on every thread of the job system. the cache is internally synchronized
+static void create_compute_pipelines(Renderer* renderer, std::span<const VkComputePipelineCreateInfo> pipeline_cis,
+                                     std::span<VkPipeline* const> pipelines) {
+    TRACE_ZONE("create_compute_pipelines");
+    VkDevice device = renderer->vk_context.device;
+    job_system_parallel_for(renderer->job_system.get(), pipeline_cis.size(), [&](uint32_t job_index, uint32_t) {
+        VK_CHECK(vkCreateComputePipelines(device, renderer->pipeline_cache, 1, &pipeline_cis[job_index], nullptr, pipelines[job_index]));
+    });
+}
+
+static void create_graphics_pipelines(Renderer* renderer, std::span<const VkGraphicsPipelineCreateInfo> pipeline_cis,
+                                      std::span<VkPipeline* const> pipelines) {
+    TRACE_ZONE("create_graphics_pipelines");
+    VkDevice device = renderer->vk_context.device;
+    job_system_parallel_for(renderer->job_system.get(), pipeline_cis.size(), [&](uint32_t job_index, uint32_t) {
+        VK_CHECK(vkCreateGraphicsPipelines(device, renderer->pipeline_cache, 1, &pipeline_cis[job_index], nullptr, pipelines[job_index]));
+    });
+}
+
+// the tone map writes the swapchain image or headless target from a compute pass when it can be a storage image, and from
+// a full screen draw otherwise. the compute pass stores without a format qualifier, so the device has to allow that too
+static bool renderer_output_storage(const Renderer* renderer) {
+    if (!renderer->vk_context.storage_write_without_format) {
+        return false;
+    }
+    return renderer->options.headless || renderer->swapchain_context.storage_output;
+}
+
 static void renderer_create_compute_pipelines(Renderer* renderer) {
+    TRACE_ZONE("renderer_create_compute_pipelines");
     VkDevice device = renderer->vk_context.device;
 
+    // every pipeline is created together at the end
+    std::vector<VkComputePipelineCreateInfo> pipeline_cis;
+    std::vector<VkPipeline*>                 pipelines;
+
     // BUILD EXPOSURE HISTOGRAM PIPELINE
 
-    VkShaderModule                  build_exposure_histogram_shader = load_shader(device, "../shaders/build_exposure_histogram.comp.spv");
+    VkShaderModule                  build_exposure_histogram_shader = load_shader(device, "shaders/build_exposure_histogram.comp.spv");
     VkPipelineShaderStageCreateInfo build_exposure_histogram_shader_stage =
         vk_lib::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, build_exposure_histogram_shader);
 
@@ -70,19 +128,17 @@ static void renderer_create_compute_pipelines(Renderer* renderer) {
     VkComputePipelineCreateInfo build_hist_pipeline_ci =
         vk_lib::compute_pipeline_create_info(build_hist_pipeline_layout, build_exposure_histogram_shader_stage);
 
-    VkPipeline build_hist_pipeline;
-    VK_CHECK(vkCreateComputePipelines(device, nullptr, 1, &build_hist_pipeline_ci, nullptr, &build_hist_pipeline));
-
     ComputePipeline build_hist_comp_pipeline{};
-    build_hist_comp_pipeline.pipeline        = build_hist_pipeline;
     build_hist_comp_pipeline.pipeline_layout = build_hist_pipeline_layout;
     build_hist_comp_pipeline.shader          = build_exposure_histogram_shader;
 
     renderer->build_exposure_hist_compute_pipeline = build_hist_comp_pipeline;
+    pipeline_cis.push_back(build_hist_pipeline_ci);
+    pipelines.push_back(&renderer->build_exposure_hist_compute_pipeline.pipeline);
 
     // AVERAGE EXPOSURE HISTOGRAM PIPELINE
 
-    VkShaderModule                  avg_exposure_histogram_shader = load_shader(device, "../shaders/average_exposure_histogram.comp.spv");
+    VkShaderModule                  avg_exposure_histogram_shader = load_shader(device, "shaders/average_exposure_histogram.comp.spv");
     VkPipelineShaderStageCreateInfo avg_exposure_histogram_shader_stage =
         vk_lib::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, avg_exposure_histogram_shader);
 
@@ -95,49 +151,167 @@ static void renderer_create_compute_pipelines(Renderer* renderer) {
     VkComputePipelineCreateInfo avg_hist_pipeline_ci =
         vk_lib::compute_pipeline_create_info(avg_hist_pipeline_layout, avg_exposure_histogram_shader_stage);
 
-    VkPipeline avg_hist_pipeline;
-    VK_CHECK(vkCreateComputePipelines(device, nullptr, 1, &avg_hist_pipeline_ci, nullptr, &avg_hist_pipeline));
-
     ComputePipeline avg_hist_comp_pipeline{};
-    avg_hist_comp_pipeline.pipeline        = avg_hist_pipeline;
     avg_hist_comp_pipeline.pipeline_layout = avg_hist_pipeline_layout;
     avg_hist_comp_pipeline.shader          = avg_exposure_histogram_shader;
 
     renderer->average_exposure_hist_compute_pipeline = avg_hist_comp_pipeline;
+    pipeline_cis.push_back(avg_hist_pipeline_ci);
+    pipelines.push_back(&renderer->average_exposure_hist_compute_pipeline.pipeline);
+
+    // COLOR CORRECTION PIPELINE. only created when the tone map writes a storage image, which the device may not allow
+
+    if (renderer_output_storage(renderer)) {
+        VkShaderModule                  color_correct_histogram_shader = load_shader(device, "shaders/final_color_correction.comp.spv");
+        VkPipelineShaderStageCreateInfo color_correct_histogram_shader_stage =
+            vk_lib::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, color_correct_histogram_shader);
+
+        std::array          color_correct_set_layouts = {renderer->color_correct_descriptor_set_layout};
+        VkPushConstantRange color_correct_push_constant_range =
+            vk_lib::push_constant_range(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(ColorCorrectPushConstants));
+        std::array                 color_correct_constant_ranges = {color_correct_push_constant_range};
+        VkPipelineLayoutCreateInfo color_correct_pipeline_layout_ci =
+            vk_lib::pipeline_layout_create_info(color_correct_set_layouts, color_correct_constant_ranges);
+
+        VkPipelineLayout color_correct_pipeline_layout;
+        VK_CHECK(vkCreatePipelineLayout(device, &color_correct_pipeline_layout_ci, nullptr, &color_correct_pipeline_layout));
+        VkComputePipelineCreateInfo color_correct_pipeline_ci =
+            vk_lib::compute_pipeline_create_info(color_correct_pipeline_layout, color_correct_histogram_shader_stage);
+
+        ComputePipeline color_correct_comp_pipeline{};
+        color_correct_comp_pipeline.pipeline_layout = color_correct_pipeline_layout;
+        color_correct_comp_pipeline.shader          = color_correct_histogram_shader;
+
+        renderer->color_correct_compute_pipeline = color_correct_comp_pipeline;
+        pipeline_cis.push_back(color_correct_pipeline_ci);
+        pipelines.push_back(&renderer->color_correct_compute_pipeline.pipeline);
+    }
+
+    // GPU DRAW CULLING PIPELINE
+
+    VkShaderModule                  cull_draws_shader       = load_shader(device, "shaders/cull_draws.comp.spv");
+    VkPipelineShaderStageCreateInfo cull_draws_shader_stage = vk_lib::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, cull_draws_shader);
+
+    std::array          cull_draws_set_layouts         = {renderer->occlusion_cull_descriptor_set_layout};
+    VkPushConstantRange cull_draws_push_constant_range = vk_lib::push_constant_range(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(CullDrawsPushConstants));
+    std::array          cull_draws_constant_ranges     = {cull_draws_push_constant_range};
+    VkPipelineLayoutCreateInfo cull_draws_pipeline_layout_ci =
+        vk_lib::pipeline_layout_create_info(cull_draws_set_layouts, cull_draws_constant_ranges);
+
+    VkPipelineLayout cull_draws_pipeline_layout;
+    VK_CHECK(vkCreatePipelineLayout(device, &cull_draws_pipeline_layout_ci, nullptr, &cull_draws_pipeline_layout));
+    VkComputePipelineCreateInfo cull_draws_pipeline_ci = vk_lib::compute_pipeline_create_info(cull_draws_pipeline_layout, cull_draws_shader_stage);
+
+    ComputePipeline cull_draws_comp_pipeline{};
+    cull_draws_comp_pipeline.pipeline_layout = cull_draws_pipeline_layout;
+    cull_draws_comp_pipeline.shader          = cull_draws_shader;
+
+    renderer->cull_draws_compute_pipeline = cull_draws_comp_pipeline;
+    pipeline_cis.push_back(cull_draws_pipeline_ci);
+    pipelines.push_back(&renderer->cull_draws_compute_pipeline.pipeline);
+
+    // HI-Z PIPELINES
+
+    std::array          hiz_set_layouts         = {renderer->hiz_descriptor_set_layout};
+    VkPushConstantRange hiz_push_constant_range = vk_lib::push_constant_range(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(HizPushConstants));
+    std::array          hiz_constant_ranges     = {hiz_push_constant_range};
+
+    VkShaderModule                  resolve_hiz_shader = load_shader(device, "shaders/resolve_hiz_depth.comp.spv");
+    VkPipelineShaderStageCreateInfo resolve_hiz_shader_stage =
+        vk_lib::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, resolve_hiz_shader);
+    VkPipelineLayoutCreateInfo resolve_hiz_pipeline_layout_ci = vk_lib::pipeline_layout_create_info(hiz_set_layouts, hiz_constant_ranges);
+
+    VkPipelineLayout resolve_hiz_pipeline_layout;
+    VK_CHECK(vkCreatePipelineLayout(device, &resolve_hiz_pipeline_layout_ci, nullptr, &resolve_hiz_pipeline_layout));
+    VkComputePipelineCreateInfo resolve_hiz_pipeline_ci = vk_lib::compute_pipeline_create_info(resolve_hiz_pipeline_layout, resolve_hiz_shader_stage);
+
+    ComputePipeline resolve_hiz_comp_pipeline{};
+    resolve_hiz_comp_pipeline.pipeline_layout = resolve_hiz_pipeline_layout;
+    resolve_hiz_comp_pipeline.shader          = resolve_hiz_shader;
 
-    // COLOR CORRECTION PIPELINE
+    renderer->resolve_hiz_compute_pipeline = resolve_hiz_comp_pipeline;
+    pipeline_cis.push_back(resolve_hiz_pipeline_ci);
+    pipelines.push_back(&renderer->resolve_hiz_compute_pipeline.pipeline);
 
-    VkShaderModule                  color_correct_histogram_shader = load_shader(device, "../shaders/final_color_correction.comp.spv");
-    VkPipelineShaderStageCreateInfo color_correct_histogram_shader_stage =
-        vk_lib::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, color_correct_histogram_shader);
+    VkShaderModule                  downsample_hiz_shader = load_shader(device, "shaders/downsample_hiz.comp.spv");
+    VkPipelineShaderStageCreateInfo downsample_hiz_shader_stage =
+        vk_lib::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, downsample_hiz_shader);
+    VkPipelineLayoutCreateInfo downsample_hiz_pipeline_layout_ci = vk_lib::pipeline_layout_create_info(hiz_set_layouts, hiz_constant_ranges);
 
-    std::array          color_correct_set_layouts = {renderer->color_correct_descriptor_set_layout};
-    VkPushConstantRange color_correct_push_constant_range =
-        vk_lib::push_constant_range(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(ColorCorrectPushConstants));
-    std::array                 color_correct_constant_ranges = {color_correct_push_constant_range};
-    VkPipelineLayoutCreateInfo color_correct_pipeline_layout_ci =
-        vk_lib::pipeline_layout_create_info(color_correct_set_layouts, color_correct_constant_ranges);
+    VkPipelineLayout downsample_hiz_pipeline_layout;
+    VK_CHECK(vkCreatePipelineLayout(device, &downsample_hiz_pipeline_layout_ci, nullptr, &downsample_hiz_pipeline_layout));
+    VkComputePipelineCreateInfo downsample_hiz_pipeline_ci =
+        vk_lib::compute_pipeline_create_info(downsample_hiz_pipeline_layout, downsample_hiz_shader_stage);
 
-    VkPipelineLayout color_correct_pipeline_layout;
-    VK_CHECK(vkCreatePipelineLayout(device, &color_correct_pipeline_layout_ci, nullptr, &color_correct_pipeline_layout));
-    VkComputePipelineCreateInfo color_correct_pipeline_ci =
-        vk_lib::compute_pipeline_create_info(color_correct_pipeline_layout, color_correct_histogram_shader_stage);
+    ComputePipeline downsample_hiz_comp_pipeline{};
+    downsample_hiz_comp_pipeline.pipeline_layout = downsample_hiz_pipeline_layout;
+    downsample_hiz_comp_pipeline.shader          = downsample_hiz_shader;
 
-    VkPipeline color_correct_pipeline;
-    VK_CHECK(vkCreateComputePipelines(device, nullptr, 1, &color_correct_pipeline_ci, nullptr, &color_correct_pipeline));
+    renderer->downsample_hiz_compute_pipeline = downsample_hiz_comp_pipeline;
+    pipeline_cis.push_back(downsample_hiz_pipeline_ci);
+    pipelines.push_back(&renderer->downsample_hiz_compute_pipeline.pipeline);
 
-    ComputePipeline color_correct_comp_pipeline{};
-    color_correct_comp_pipeline.pipeline        = color_correct_pipeline;
-    color_correct_comp_pipeline.pipeline_layout = color_correct_pipeline_layout;
-    color_correct_comp_pipeline.shader          = build_exposure_histogram_shader;
+    // ARENA COPY PIPELINE
 
-    renderer->color_correct_compute_pipeline = color_correct_comp_pipeline;
+    VkShaderModule                  arena_copy_shader = load_shader(device, "shaders/arena_copy.comp.spv");
+    VkPipelineShaderStageCreateInfo arena_copy_shader_stage =
+        vk_lib::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, arena_copy_shader);
+
+    VkPushConstantRange arena_copy_push_constant_range =
+        vk_lib::push_constant_range(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(ArenaCopyPushConstants));
+    std::array                 arena_copy_constant_ranges    = {arena_copy_push_constant_range};
+    VkPipelineLayoutCreateInfo arena_copy_pipeline_layout_ci = vk_lib::pipeline_layout_create_info({}, arena_copy_constant_ranges);
+
+    VkPipelineLayout arena_copy_pipeline_layout;
+    VK_CHECK(vkCreatePipelineLayout(device, &arena_copy_pipeline_layout_ci, nullptr, &arena_copy_pipeline_layout));
+    VkComputePipelineCreateInfo arena_copy_pipeline_ci =
+        vk_lib::compute_pipeline_create_info(arena_copy_pipeline_layout, arena_copy_shader_stage);
+
+    ComputePipeline arena_copy_comp_pipeline{};
+    arena_copy_comp_pipeline.pipeline_layout = arena_copy_pipeline_layout;
+    arena_copy_comp_pipeline.shader          = arena_copy_shader;
+
+    renderer->arena_copy_compute_pipeline = arena_copy_comp_pipeline;
+    pipeline_cis.push_back(arena_copy_pipeline_ci);
+    pipelines.push_back(&renderer->arena_copy_compute_pipeline.pipeline);
+
+    // ENCODE VERTICES PIPELINE
+
+    VkShaderModule                  encode_vertices_shader = load_shader(device, "shaders/encode_vertices.comp.spv");
+    VkPipelineShaderStageCreateInfo encode_vertices_shader_stage =
+        vk_lib::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, encode_vertices_shader);
+
+    VkPushConstantRange encode_vertices_push_constant_range =
+        vk_lib::push_constant_range(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(EncodeVerticesPushConstants));
+    std::array                 encode_vertices_constant_ranges    = {encode_vertices_push_constant_range};
+    VkPipelineLayoutCreateInfo encode_vertices_pipeline_layout_ci = vk_lib::pipeline_layout_create_info({}, encode_vertices_constant_ranges);
+
+    VkPipelineLayout encode_vertices_pipeline_layout;
+    VK_CHECK(vkCreatePipelineLayout(device, &encode_vertices_pipeline_layout_ci, nullptr, &encode_vertices_pipeline_layout));
+    VkComputePipelineCreateInfo encode_vertices_pipeline_ci =
+        vk_lib::compute_pipeline_create_info(encode_vertices_pipeline_layout, encode_vertices_shader_stage);
+
+    ComputePipeline encode_vertices_comp_pipeline{};
+    encode_vertices_comp_pipeline.pipeline_layout = encode_vertices_pipeline_layout;
+    encode_vertices_comp_pipeline.shader          = encode_vertices_shader;
+
+    renderer->encode_vertices_compute_pipeline = encode_vertices_comp_pipeline;
+    pipeline_cis.push_back(encode_vertices_pipeline_ci);
+    pipelines.push_back(&renderer->encode_vertices_compute_pipeline.pipeline);
+
+    create_compute_pipelines(renderer, pipeline_cis, pipelines);
 }
 
 static void renderer_create_graphics_pipelines(Renderer* renderer) {
+    TRACE_ZONE("renderer_create_graphics_pipelines");
 
     VkDevice device = renderer->vk_context.device;
 
+    // every pipeline but the tone map is created together once their state is filled in. the create infos are copied,
+    // so the gpu driven variants below can reuse them with a different layout and stages
+    std::vector<VkGraphicsPipelineCreateInfo> pipeline_cis;
+    std::vector<VkPipeline*>                  pipelines;
+
     std::array                 set_layouts          = {renderer->scene_descriptor_set_layout, renderer->asset_descriptor_set_layout};
     VkPushConstantRange        push_constant_range  = vk_lib::push_constant_range(VK_SHADER_STAGE_ALL, sizeof(DrawPushConstants));
     std::array                 push_constant_ranges = {push_constant_range};
@@ -149,8 +323,8 @@ static void renderer_create_graphics_pipelines(Renderer* renderer) {
     const VkPipelineRenderingCreateInfoKHR rendering_create_info =
         vk_lib::pipeline_rendering_create_info(color_attachment_formats, VK_FORMAT_D32_SFLOAT);
 
-    VkShaderModule                         vert_shader        = load_shader(device, "../shaders/indexed_draw.vert.spv");
-    VkShaderModule                         frag_shader        = load_shader(device, "../shaders/gltf_pbr.frag.spv");
+    VkShaderModule                         vert_shader        = load_shader(device, "shaders/indexed_draw.vert.spv");
+    VkShaderModule                         frag_shader        = load_shader(device, "shaders/gltf_pbr.frag.spv");
     VkPipelineShaderStageCreateInfo        vert_shader_stage  = vk_lib::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, vert_shader);
     VkPipelineShaderStageCreateInfo        frag_shader_stage  = vk_lib::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, frag_shader);
     std::array                             shader_stages      = {vert_shader_stage, frag_shader_stage};
@@ -172,16 +346,14 @@ static void renderer_create_graphics_pipelines(Renderer* renderer) {
         pipeline_layout, nullptr, shader_stages, &vertex_input_state, &input_assembly_state, &viewport_state, &rasterization_state,
         &multisample_state, &opaque_color_blend_state, &depth_stencil_state, &dynamic_state, nullptr, 0, 0, nullptr, 0, &rendering_create_info);
 
-    VkPipeline opaque_pipeline;
-    VK_CHECK(vkCreateGraphicsPipelines(device, nullptr, 1, &opaque_graphics_pipeline_ci, nullptr, &opaque_pipeline));
-
     GraphicsPipeline opaque_graphics_pipeline{};
-    opaque_graphics_pipeline.pipeline        = opaque_pipeline;
     opaque_graphics_pipeline.pipeline_layout = pipeline_layout;
     opaque_graphics_pipeline.vert_shader     = vert_shader;
     opaque_graphics_pipeline.frag_shader     = frag_shader;
 
     renderer->opaque_graphics_pipeline = opaque_graphics_pipeline;
+    pipeline_cis.push_back(opaque_graphics_pipeline_ci);
+    pipelines.push_back(&renderer->opaque_graphics_pipeline.pipeline);
 
     VkPipelineColorBlendAttachmentState transparent_color_blend_attachment_state = vk_lib::pipeline_color_blend_attachment_state(true);
     std::array                          transparent_color_blends                 = {transparent_color_blend_attachment_state};
@@ -191,19 +363,17 @@ static void renderer_create_graphics_pipelines(Renderer* renderer) {
         pipeline_layout, nullptr, shader_stages, &vertex_input_state, &input_assembly_state, &viewport_state, &rasterization_state,
         &multisample_state, &transparent_color_blend_state, &depth_stencil_state, &dynamic_state, nullptr, 0, 0, nullptr, 0, &rendering_create_info);
 
-    VkPipeline transparent_pipeline;
-    VK_CHECK(vkCreateGraphicsPipelines(device, nullptr, 1, &transparent_graphics_pipeline_ci, nullptr, &transparent_pipeline));
-
     GraphicsPipeline transparent_graphics_pipeline{};
-    transparent_graphics_pipeline.pipeline        = transparent_pipeline;
     transparent_graphics_pipeline.pipeline_layout = pipeline_layout;
     transparent_graphics_pipeline.vert_shader     = vert_shader;
     transparent_graphics_pipeline.frag_shader     = frag_shader;
 
     renderer->transparent_graphics_pipeline = transparent_graphics_pipeline;
+    pipeline_cis.push_back(transparent_graphics_pipeline_ci);
+    pipelines.push_back(&renderer->transparent_graphics_pipeline.pipeline);
 
     // create offscreen shadow map pipeline
-    VkShaderModule                  shadow_vert_shader = load_shader(device, "../shaders/shadow_map_gen.vert.spv");
+    VkShaderModule                  shadow_vert_shader = load_shader(device, "shaders/shadow_map_gen.vert.spv");
     VkPipelineShaderStageCreateInfo shadow_map_shader_stage =
         vk_lib::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, shadow_vert_shader);
     std::array shadow_map_shader_stages = {shadow_map_shader_stage};
@@ -231,20 +401,18 @@ static void renderer_create_graphics_pipelines(Renderer* renderer) {
         &shadow_map_rasterization_state, &shadow_map_multisample_state, &shadow_map_color_blend_state, &shadow_map_depth_stencil_state,
         &dynamic_state, nullptr, 0, 0, nullptr, 0, &shadow_map_rendering_ci);
 
-    VkPipeline shadow_map_pipeline;
-    VK_CHECK(vkCreateGraphicsPipelines(device, nullptr, 1, &shadow_map_graphics_pipeline_ci, nullptr, &shadow_map_pipeline));
-
     GraphicsPipeline shadow_map_graphics_pipeline{};
-    shadow_map_graphics_pipeline.pipeline        = shadow_map_pipeline;
     shadow_map_graphics_pipeline.pipeline_layout = shadow_map_pipeline_layout;
     shadow_map_graphics_pipeline.vert_shader     = shadow_vert_shader;
 
     renderer->shadow_map_graphics_pipeline = shadow_map_graphics_pipeline;
+    pipeline_cis.push_back(shadow_map_graphics_pipeline_ci);
+    pipelines.push_back(&renderer->shadow_map_graphics_pipeline.pipeline);
 
     // create depth pre-pass pipeline
 
     // todo: make shader
-    VkShaderModule                  depth_pre_vert_shader = load_shader(device, "../shaders/shadow_map_gen.vert.spv");
+    VkShaderModule                  depth_pre_vert_shader = load_shader(device, "shaders/shadow_map_gen.vert.spv");
     VkPipelineShaderStageCreateInfo depth_pre_shader_stage =
         vk_lib::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, depth_pre_vert_shader);
     std::array depth_pre_shader_stages = {depth_pre_shader_stage};
@@ -273,15 +441,131 @@ static void renderer_create_graphics_pipelines(Renderer* renderer) {
         &depth_pre_rasterization_state, &depth_pre_multisample_state, &depth_pre_color_blend_state, &depth_pre_depth_stencil_state, &dynamic_state,
         nullptr, 0, 0, nullptr, 0, &depth_pre_rendering_ci);
 
-    VkPipeline depth_pre_pipeline;
-    VK_CHECK(vkCreateGraphicsPipelines(device, nullptr, 1, &depth_pre_graphics_pipeline_ci, nullptr, &depth_pre_pipeline));
-
     GraphicsPipeline depth_pre_graphics_pipeline{};
-    depth_pre_graphics_pipeline.pipeline        = depth_pre_pipeline;
     depth_pre_graphics_pipeline.pipeline_layout = depth_pre_pipeline_layout;
     depth_pre_graphics_pipeline.vert_shader     = depth_pre_vert_shader;
 
     renderer->depth_pre_graphics_pipeline = depth_pre_graphics_pipeline;
+    pipeline_cis.push_back(depth_pre_graphics_pipeline_ci);
+    pipelines.push_back(&renderer->depth_pre_graphics_pipeline.pipeline);
+
+    // create gpu driven pipelines. same state as above, but vertex shaders fetch their draw data by instance index
+
+    VkPushConstantRange indirect_push_constant_range  = vk_lib::push_constant_range(VK_SHADER_STAGE_ALL, sizeof(IndirectDrawPushConstants));
+    std::array          indirect_push_constant_ranges = {indirect_push_constant_range};
+
+    VkPipelineLayoutCreateInfo indirect_layout_create_info = vk_lib::pipeline_layout_create_info(set_layouts, indirect_push_constant_ranges);
+    VkPipelineLayout           indirect_pipeline_layout;
+    VK_CHECK(vkCreatePipelineLayout(device, &indirect_layout_create_info, nullptr, &indirect_pipeline_layout));
+
+    VkShaderModule                  indirect_vert_shader = load_shader(device, "shaders/indirect_draw.vert.spv");
+    VkPipelineShaderStageCreateInfo indirect_vert_shader_stage =
+        vk_lib::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, indirect_vert_shader);
+    std::array indirect_shader_stages = {indirect_vert_shader_stage, frag_shader_stage};
+
+    opaque_graphics_pipeline_ci.layout     = indirect_pipeline_layout;
+    opaque_graphics_pipeline_ci.stageCount = indirect_shader_stages.size();
+    opaque_graphics_pipeline_ci.pStages    = indirect_shader_stages.data();
+
+    pipeline_cis.push_back(opaque_graphics_pipeline_ci);
+    pipelines.push_back(&renderer->indirect_opaque_graphics_pipeline.pipeline);
+
+    transparent_graphics_pipeline_ci.layout     = indirect_pipeline_layout;
+    transparent_graphics_pipeline_ci.stageCount = indirect_shader_stages.size();
+    transparent_graphics_pipeline_ci.pStages    = indirect_shader_stages.data();
+
+    pipeline_cis.push_back(transparent_graphics_pipeline_ci);
+    pipelines.push_back(&renderer->indirect_transparent_graphics_pipeline.pipeline);
+
+    renderer->indirect_opaque_graphics_pipeline.pipeline_layout = indirect_pipeline_layout;
+    renderer->indirect_opaque_graphics_pipeline.vert_shader     = indirect_vert_shader;
+    renderer->indirect_opaque_graphics_pipeline.frag_shader     = frag_shader;
+
+    renderer->indirect_transparent_graphics_pipeline.pipeline_layout = indirect_pipeline_layout;
+    renderer->indirect_transparent_graphics_pipeline.vert_shader     = indirect_vert_shader;
+    renderer->indirect_transparent_graphics_pipeline.frag_shader     = frag_shader;
+
+    // shadow map and depth pre-pass share the depth only vertex shader and layout
+    VkPushConstantRange indirect_depth_push_constant_range =
+        vk_lib::push_constant_range(VK_SHADER_STAGE_VERTEX_BIT, sizeof(IndirectDrawPushConstants));
+    std::array indirect_depth_push_constant_ranges = {indirect_depth_push_constant_range};
+
+    VkPipelineLayoutCreateInfo indirect_depth_layout_create_info =
+        vk_lib::pipeline_layout_create_info(shadow_map_set_layouts, indirect_depth_push_constant_ranges);
+    VkPipelineLayout indirect_depth_pipeline_layout;
+    VK_CHECK(vkCreatePipelineLayout(device, &indirect_depth_layout_create_info, nullptr, &indirect_depth_pipeline_layout));
+
+    VkShaderModule                  indirect_depth_vert_shader = load_shader(device, "shaders/indirect_depth.vert.spv");
+    VkPipelineShaderStageCreateInfo indirect_depth_shader_stage =
+        vk_lib::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, indirect_depth_vert_shader);
+    std::array indirect_depth_shader_stages = {indirect_depth_shader_stage};
+
+    shadow_map_graphics_pipeline_ci.layout  = indirect_depth_pipeline_layout;
+    shadow_map_graphics_pipeline_ci.pStages = indirect_depth_shader_stages.data();
+
+    pipeline_cis.push_back(shadow_map_graphics_pipeline_ci);
+    pipelines.push_back(&renderer->indirect_shadow_map_graphics_pipeline.pipeline);
+
+    depth_pre_graphics_pipeline_ci.layout  = indirect_depth_pipeline_layout;
+    depth_pre_graphics_pipeline_ci.pStages = indirect_depth_shader_stages.data();
+
+    pipeline_cis.push_back(depth_pre_graphics_pipeline_ci);
+    pipelines.push_back(&renderer->indirect_depth_pre_graphics_pipeline.pipeline);
+
+    renderer->indirect_shadow_map_graphics_pipeline.pipeline_layout = indirect_depth_pipeline_layout;
+    renderer->indirect_shadow_map_graphics_pipeline.vert_shader     = indirect_depth_vert_shader;
+
+    renderer->indirect_depth_pre_graphics_pipeline.pipeline_layout = indirect_depth_pipeline_layout;
+    renderer->indirect_depth_pre_graphics_pipeline.vert_shader     = indirect_depth_vert_shader;
+
+    create_graphics_pipelines(renderer, pipeline_cis, pipelines);
+
+    // create tone map pipeline. fallback for outputs that can't be storage images, so the tone map writes them as a color attachment
+    if (renderer_output_storage(renderer)) {
+        return;
+    }
+
+    std::array          tone_map_set_layouts          = {renderer->color_correct_descriptor_set_layout};
+    VkPushConstantRange tone_map_push_constant_range  = vk_lib::push_constant_range(VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(ColorCorrectPushConstants));
+    std::array          tone_map_push_constant_ranges = {tone_map_push_constant_range};
+
+    VkPipelineLayoutCreateInfo tone_map_layout_create_info = vk_lib::pipeline_layout_create_info(tone_map_set_layouts, tone_map_push_constant_ranges);
+    VkPipelineLayout           tone_map_pipeline_layout;
+    VK_CHECK(vkCreatePipelineLayout(device, &tone_map_layout_create_info, nullptr, &tone_map_pipeline_layout));
+
+    VkShaderModule                  tone_map_vert_shader = load_shader(device, "shaders/fullscreen.vert.spv");
+    VkShaderModule                  tone_map_frag_shader = load_shader(device, "shaders/tone_map.frag.spv");
+    VkPipelineShaderStageCreateInfo tone_map_vert_shader_stage =
+        vk_lib::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, tone_map_vert_shader);
+    VkPipelineShaderStageCreateInfo tone_map_frag_shader_stage =
+        vk_lib::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, tone_map_frag_shader);
+    std::array tone_map_shader_stages = {tone_map_vert_shader_stage, tone_map_frag_shader_stage};
+
+    const VkFormat output_format =
+        renderer->options.headless ? renderer->headless_target_image.image_format : renderer->swapchain_context.surface_format.format;
+
+    std::array                       tone_map_color_formats = {output_format};
+    VkPipelineRenderingCreateInfoKHR tone_map_rendering_ci  = vk_lib::pipeline_rendering_create_info(tone_map_color_formats, VK_FORMAT_UNDEFINED);
+
+    VkPipelineMultisampleStateCreateInfo  tone_map_multisample_state = vk_lib::pipeline_multisample_state_create_info(VK_SAMPLE_COUNT_1_BIT);
+    VkPipelineColorBlendStateCreateInfo   tone_map_color_blend_state = vk_lib::pipeline_color_blend_state_create_info(opaque_color_blends);
+    VkPipelineDepthStencilStateCreateInfo tone_map_depth_stencil_state =
+        vk_lib::pipeline_depth_stencil_state_create_info(false, false, VK_COMPARE_OP_ALWAYS);
+    VkPipelineRasterizationStateCreateInfo tone_map_rasterization_state =
+        vk_lib::pipeline_rasterization_state_create_info(VK_POLYGON_MODE_FILL, VK_FRONT_FACE_COUNTER_CLOCKWISE, VK_CULL_MODE_NONE);
+
+    VkGraphicsPipelineCreateInfo tone_map_graphics_pipeline_ci = vk_lib::graphics_pipeline_create_info(
+        tone_map_pipeline_layout, nullptr, tone_map_shader_stages, &vertex_input_state, &input_assembly_state, &viewport_state,
+        &tone_map_rasterization_state, &tone_map_multisample_state, &tone_map_color_blend_state, &tone_map_depth_stencil_state, &dynamic_state,
+        nullptr, 0, 0, nullptr, 0, &tone_map_rendering_ci);
+
+    VkPipeline tone_map_pipeline;
+    VK_CHECK(vkCreateGraphicsPipelines(device, renderer->pipeline_cache, 1, &tone_map_graphics_pipeline_ci, nullptr, &tone_map_pipeline));
+
+    renderer->tone_map_graphics_pipeline.pipeline        = tone_map_pipeline;
+    renderer->tone_map_graphics_pipeline.pipeline_layout = tone_map_pipeline_layout;
+    renderer->tone_map_graphics_pipeline.vert_shader     = tone_map_vert_shader;
+    renderer->tone_map_graphics_pipeline.frag_shader     = tone_map_frag_shader;
 }
 
 static void vma_allocation_callback(VmaAllocator allocator, uint32_t memoryType, VkDeviceMemory memory, VkDeviceSize size, void* pUserData) {
@@ -327,6 +611,9 @@ static VmaAllocator allocator_create(const VkContext* vk_context) {
     allocator_create_info.instance               = vk_context->instance;
     allocator_create_info.pVulkanFunctions       = &vma_vulkan_functions;
     allocator_create_info.flags                  = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+    if (vk_context->memory_budget) {
+        allocator_create_info.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+    }
     VmaDeviceMemoryCallbacks vma_device_memory_callbacks{};
     vma_device_memory_callbacks.pfnAllocate      = &vma_allocation_callback;
     allocator_create_info.pDeviceMemoryCallbacks = &vma_device_memory_callbacks;
@@ -337,10 +624,27 @@ static VmaAllocator allocator_create(const VkContext* vk_context) {
     return allocator;
 }
 
+// average scene luminance in cd/m^2 the auto exposure adapts from
+static constexpr float initial_average_luminance = 1026.f;
+
+// inverse of convert_EV100_to_exposure in final_color_correction.comp at the EV100 of this average luminance
+static float pre_exposure_from_luminance(float luminance) {
+    const float EV100         = std::log2(luminance * 100.f / 12.5f);
+    const float max_luminance = 1.2f * std::exp2(EV100);
+    return 1.f / max_luminance;
+}
+
+// srgb formats encode on write, anything else gets encoded by the tone map itself
+static bool is_srgb_format(VkFormat format) {
+    return format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_A8B8G8R8_SRGB_PACK32;
+}
+
 static void create_compute_resources(Renderer* renderer) {
 
-    VkBufferCreateInfo histogram_buffer_ci = vk_lib::buffer_create_info(
-        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, 256 * sizeof(uint32_t));
+    VkBufferCreateInfo histogram_buffer_ci =
+        vk_lib::buffer_create_info(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                                       VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                   exposure_histogram_bin_count * sizeof(uint32_t));
 
     VmaAllocationCreateInfo dev_local_buffer_allocation_ci{};
     dev_local_buffer_allocation_ci.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
@@ -353,23 +657,142 @@ static void create_compute_resources(Renderer* renderer) {
     renderer->exposure_histogram.address                 = vkGetBufferDeviceAddress(renderer->vk_context.device, &histogram_buffer_device_ai);
 
     VkBufferCreateInfo avg_luminance_buffer_ci =
-        vk_lib::buffer_create_info(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, 1 * sizeof(float));
+        vk_lib::buffer_create_info(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                                       VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                   1 * sizeof(float));
 
     VK_CHECK(vmaCreateBuffer(renderer->allocator, &avg_luminance_buffer_ci, &dev_local_buffer_allocation_ci, &renderer->average_luminance_buf.buffer,
                              &renderer->average_luminance_buf.allocation, &renderer->average_luminance_buf.allocation_info));
 
     VkBufferDeviceAddressInfo avg_luminance_buffer_device_ai = vk_lib::buffer_device_address_info(renderer->average_luminance_buf.buffer);
     renderer->average_luminance_buf.address                  = vkGetBufferDeviceAddress(renderer->vk_context.device, &avg_luminance_buffer_device_ai);
+
+    // adaptation and pre-exposure both start from the same luminance instead of whatever the allocation held. filled on the
+    // queue post processing runs on, which owns the buffer from then on
+    vk_command_immediate_submit(renderer->vk_context.device, renderer->vk_context.compute_command_pool, renderer->vk_context.compute_queue,
+                                [&](VkCommandBuffer cmd_buf) {
+                                    vkCmdFillBuffer(cmd_buf, renderer->average_luminance_buf.buffer, 0, VK_WHOLE_SIZE,
+                                                    std::bit_cast<uint32_t>(initial_average_luminance));
+                                });
+
+    for (uint32_t i = 0; i < renderer->frames.size(); i++) {
+        AllocatedBuffer readback_buffer =
+            allocated_buffer_create(renderer->allocator, renderer->vk_context.device, sizeof(float), VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                    VMA_MEMORY_USAGE_AUTO, VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT);
+        memcpy(readback_buffer.allocation_info.pMappedData, &initial_average_luminance, sizeof(float));
+        renderer->luminance_readback_buffers.push_back(readback_buffer);
+    }
+    renderer->pre_exposure = pre_exposure_from_luminance(initial_average_luminance);
+
+    if (!renderer->options.exposure_metering_report) {
+        return;
+    }
+
+    VK_CHECK(vmaCreateBuffer(renderer->allocator, &histogram_buffer_ci, &dev_local_buffer_allocation_ci,
+                             &renderer->reference_exposure_histogram.buffer, &renderer->reference_exposure_histogram.allocation,
+                             &renderer->reference_exposure_histogram.allocation_info));
+
+    VkBufferDeviceAddressInfo reference_histogram_device_ai = vk_lib::buffer_device_address_info(renderer->reference_exposure_histogram.buffer);
+    renderer->reference_exposure_histogram.address          = vkGetBufferDeviceAddress(renderer->vk_context.device, &reference_histogram_device_ai);
+
+    // metered bins followed by reference bins. zeroed so frames that haven't been read back yet get skipped
+    for (uint32_t i = 0; i < renderer->frames.size(); i++) {
+        AllocatedBuffer readback_buffer = allocated_buffer_create(
+            renderer->allocator, renderer->vk_context.device, 2 * exposure_histogram_bin_count * sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VMA_MEMORY_USAGE_AUTO, VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT);
+        memset(readback_buffer.allocation_info.pMappedData, 0, 2 * exposure_histogram_bin_count * sizeof(uint32_t));
+        renderer->metering_readback_buffers.push_back(readback_buffer);
+    }
+}
+
+static void create_indirect_draw_resources(Renderer* renderer) {
+    // command buffers depend on the draw count and are sized in renderer_update_gpu_draws
+    for (uint32_t i = 0; i < renderer->frames.size(); i++) {
+        renderer->indirect_count_buffers.push_back(allocated_buffer_create(
+            renderer->allocator, renderer->vk_context.device, indirect_batch_count * sizeof(uint32_t),
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+            VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE));
+
+        renderer->occlusion_count_buffers.push_back(allocated_buffer_create(
+            renderer->allocator, renderer->vk_context.device, indirect_batch_count * sizeof(uint32_t),
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+            VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE));
+
+        renderer->cull_data_buffers.push_back(allocated_buffer_create(
+            renderer->allocator, renderer->vk_context.device, sizeof(GpuCullData),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VMA_MEMORY_USAGE_AUTO,
+            VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT));
+    }
+}
+
+// the hdr targets are rendered and blended into, resolved, then sampled by the histogram and the tone map
+static void validate_hdr_format(const Renderer* renderer) {
+    const VkFormat hdr_format = renderer->options.hdr_format;
+    if (hdr_format != VK_FORMAT_R32G32B32A32_SFLOAT && hdr_format != VK_FORMAT_R16G16B16A16_SFLOAT &&
+        hdr_format != VK_FORMAT_B10G11R11_UFLOAT_PACK32) {
+        abort_message("Unsupported hdr format");
+    }
+
+    VkFormatProperties format_properties;
+    vkGetPhysicalDeviceFormatProperties(renderer->vk_context.physical_device, hdr_format, &format_properties);
+
+    constexpr VkFormatFeatureFlags required_features = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BLEND_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+    if ((format_properties.optimalTilingFeatures & required_features) != required_features) {
+        abort_message("Hdr format can't be used as a blended and sampled render target on this device");
+    }
+}
+
+// the histogram pass merges bins across the subgroup with ballots before its shared memory atomics
+static void validate_exposure_metering(const Renderer* renderer) {
+    const uint32_t metering_scale = renderer->options.exposure_metering_scale;
+    if (metering_scale != 1 && metering_scale != 2 && metering_scale != 4 && metering_scale != 8) {
+        abort_message("Exposure metering scale must be 1, 2, 4 or 8");
+    }
+
+    VkPhysicalDeviceSubgroupProperties subgroup_properties{};
+    subgroup_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 properties_2{};
+    properties_2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties_2.pNext = &subgroup_properties;
+    vkGetPhysicalDeviceProperties2(renderer->vk_context.physical_device, &properties_2);
+
+    constexpr VkSubgroupFeatureFlags required_operations = VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_BALLOT_BIT;
+    if ((subgroup_properties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) == 0 ||
+        (subgroup_properties.supportedOperations & required_operations) != required_operations) {
+        abort_message("Exposure histogram needs subgroup ballot operations in compute shaders");
+    }
+}
+
+// the fragment tone map fallback can only run on the graphics queue. without a storage output the compute family goes unused and
+// the context falls back to doing everything on the graphics queue
+static void validate_async_compute(Renderer* renderer) {
+    VkContext* vk_ctx = &renderer->vk_context;
+    if (!vk_context_has_async_compute(vk_ctx) || renderer_output_storage(renderer)) {
+        return;
+    }
+    std::cout << "Async compute disabled: the output image can't be written by a compute pass" << std::endl;
+    vk_ctx->compute_queue        = vk_ctx->graphics_queue;
+    vk_ctx->compute_queue_family = vk_ctx->queue_family;
+}
+
+// with async compute the swapchain images are written on the compute queue and presented from the graphics family
+static std::vector<uint32_t> renderer_queue_families(const VkContext* vk_ctx) {
+    if (vk_context_has_async_compute(vk_ctx)) {
+        return {vk_ctx->queue_family, vk_ctx->compute_queue_family};
+    }
+    return {vk_ctx->queue_family};
 }
 
 static void create_render_resources(Renderer* renderer) {
-    VkContext*              vk_ctx        = &renderer->vk_context;
-    const SwapchainContext* swapchain_ctx = &renderer->swapchain_context;
+    VkContext* vk_ctx = &renderer->vk_context;
 
-    VkExtent3D image_extent = vk_lib::extent_3d(swapchain_ctx->extent.width, swapchain_ctx->extent.height);
+    VkExtent3D image_extent = vk_lib::extent_3d(renderer->render_extent.width, renderer->render_extent.height);
 
     // create main msaa color image
-    VkFormat          hdr_format    = VK_FORMAT_R32G32B32A32_SFLOAT;
+    VkFormat          hdr_format    = renderer->options.hdr_format;
     VkImageCreateInfo msaa_image_ci = vk_lib::image_create_info(hdr_format, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
                                                                 image_extent, 1, 1, VK_SAMPLE_COUNT_4_BIT);
 
@@ -387,9 +810,8 @@ static void create_render_resources(Renderer* renderer) {
     vkCreateImageView(vk_ctx->device, &msaa_image_view_ci, nullptr, &renderer->msaa_color_image.image_view);
 
     // create resolve image for hdr msaa image
-    VkImageCreateInfo resolve_image_ci = vk_lib::image_create_info(
-        hdr_format, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT,
-        image_extent);
+    VkImageCreateInfo resolve_image_ci =
+        vk_lib::image_create_info(hdr_format, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, image_extent);
 
     VK_CHECK(vmaCreateImage(renderer->allocator, &resolve_image_ci, &allocation_ci, &renderer->resolve_color_image.image,
                             &renderer->resolve_color_image.allocation, &renderer->resolve_color_image.allocation_info));
@@ -400,9 +822,9 @@ static void create_render_resources(Renderer* renderer) {
         vk_lib::image_view_create_info(hdr_format, renderer->resolve_color_image.image, &color_subresource_range);
     vkCreateImageView(vk_ctx->device, &resolve_image_view_ci, nullptr, &renderer->resolve_color_image.image_view);
 
-    // create depth image for the msaa color image. requires sample sample count
-    VkImageCreateInfo depth_image_ci =
-        vk_lib::image_create_info(VK_FORMAT_D32_SFLOAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, image_extent, 1, 1, VK_SAMPLE_COUNT_4_BIT);
+    // create depth image for the msaa color image. requires sample sample count. sampled when building the hi-z pyramid
+    VkImageCreateInfo depth_image_ci = vk_lib::image_create_info(
+        VK_FORMAT_D32_SFLOAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, image_extent, 1, 1, VK_SAMPLE_COUNT_4_BIT);
 
     VK_CHECK(vmaCreateImage(renderer->allocator, &depth_image_ci, &allocation_ci, &renderer->depth_image.image, &renderer->depth_image.allocation,
                             &renderer->depth_image.allocation_info));
@@ -415,6 +837,54 @@ static void create_render_resources(Renderer* renderer) {
         vk_lib::image_view_create_info(VK_FORMAT_D32_SFLOAT, renderer->depth_image.image, &depth_subresource_range);
 
     VK_CHECK(vkCreateImageView(vk_ctx->device, &depth_image_view_ci, nullptr, &renderer->depth_image.image_view));
+
+    // hi-z pyramid. power of two sized so every mip halves exactly and a uv maps to the same footprint on every mip
+    const VkExtent3D hiz_extent = vk_lib::extent_3d(std::bit_floor(renderer->render_extent.width), std::bit_floor(renderer->render_extent.height));
+    renderer->hiz_mip_count     = std::min(static_cast<uint32_t>(std::bit_width(std::max(hiz_extent.width, hiz_extent.height))), max_hiz_mip_count);
+
+    VkImageCreateInfo hiz_image_ci = vk_lib::image_create_info(VK_FORMAT_R32_SFLOAT, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                                                               hiz_extent, renderer->hiz_mip_count);
+
+    VK_CHECK(vmaCreateImage(renderer->allocator, &hiz_image_ci, &allocation_ci, &renderer->hiz_image.image, &renderer->hiz_image.allocation,
+                            &renderer->hiz_image.allocation_info));
+
+    renderer->hiz_image.image_format = VK_FORMAT_R32_SFLOAT;
+    renderer->hiz_image.extent       = hiz_extent;
+
+    VkImageSubresourceRange hiz_subresource_range = vk_lib::image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT);
+    hiz_subresource_range.levelCount              = renderer->hiz_mip_count;
+
+    VkImageViewCreateInfo hiz_image_view_ci = vk_lib::image_view_create_info(VK_FORMAT_R32_SFLOAT, renderer->hiz_image.image, &hiz_subresource_range);
+    VK_CHECK(vkCreateImageView(vk_ctx->device, &hiz_image_view_ci, nullptr, &renderer->hiz_image.image_view));
+
+    for (uint32_t mip = 0; mip < renderer->hiz_mip_count; mip++) {
+        VkImageSubresourceRange mip_subresource_range = vk_lib::image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT);
+        mip_subresource_range.baseMipLevel            = mip;
+
+        VkImageViewCreateInfo mip_view_ci = vk_lib::image_view_create_info(VK_FORMAT_R32_SFLOAT, renderer->hiz_image.image, &mip_subresource_range);
+        VK_CHECK(vkCreateImageView(vk_ctx->device, &mip_view_ci, nullptr, &renderer->hiz_mip_views[mip]));
+    }
+
+    if (!renderer->options.headless) {
+        return;
+    }
+
+    // headless frames end up here instead of a swapchain image. the tone map writes srgb encoded values into it, so the 8 bit
+    // contents can be read back directly
+    const VkImageUsageFlags output_usage = renderer_output_storage(renderer) ? VK_IMAGE_USAGE_STORAGE_BIT : VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    VkFormat                target_format   = VK_FORMAT_R8G8B8A8_UNORM;
+    VkImageCreateInfo       target_image_ci = vk_lib::image_create_info(target_format, output_usage | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, image_extent);
+
+    VK_CHECK(vmaCreateImage(renderer->allocator, &target_image_ci, &allocation_ci, &renderer->headless_target_image.image,
+                            &renderer->headless_target_image.allocation, &renderer->headless_target_image.allocation_info));
+
+    renderer->headless_target_image.image_format = target_format;
+    renderer->headless_target_image.extent       = image_extent;
+    renderer->headless_target_image.layout       = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    VkImageViewCreateInfo target_image_view_ci =
+        vk_lib::image_view_create_info(target_format, renderer->headless_target_image.image, &color_subresource_range);
+    VK_CHECK(vkCreateImageView(vk_ctx->device, &target_image_view_ci, nullptr, &renderer->headless_target_image.image_view));
 }
 
 static void renderer_create_shadow_map(Renderer* renderer) {
@@ -424,21 +894,34 @@ static void renderer_create_shadow_map(Renderer* renderer) {
     VmaAllocationCreateInfo allocation_ci{};
     allocation_ci.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
 
-    renderer->shadow_map_extent = vk_lib::extent_3d(4096, 4096);
+    const uint32_t cascade_count = renderer->shadow_cascade_count;
+    renderer->shadow_map_extent  = vk_lib::extent_3d(renderer->options.shadow_cascade_resolution, renderer->options.shadow_cascade_resolution);
 
-    VkImageCreateInfo shadow_map_image_ci = vk_lib::image_create_info(
-        VK_FORMAT_D32_SFLOAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, renderer->shadow_map_extent);
+    const VkImageUsageFlags shadow_map_usage    = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    VkImageCreateInfo       shadow_map_image_ci =
+        vk_lib::image_create_info(VK_FORMAT_D32_SFLOAT, shadow_map_usage, renderer->shadow_map_extent, 1, cascade_count);
 
     VK_CHECK(vmaCreateImage(renderer->allocator, &shadow_map_image_ci, &allocation_ci, &renderer->shadow_map_image.image,
                             &renderer->shadow_map_image.allocation, &renderer->shadow_map_image.allocation_info));
 
     renderer->shadow_map_image.image_format = VK_FORMAT_D32_SFLOAT;
 
+    depth_subresource_range.layerCount = cascade_count;
     VkImageViewCreateInfo shadow_map_image_view_ci =
         vk_lib::image_view_create_info(VK_FORMAT_D32_SFLOAT, renderer->shadow_map_image.image, &depth_subresource_range);
+    shadow_map_image_view_ci.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
 
     VK_CHECK(vkCreateImageView(renderer->vk_context.device, &shadow_map_image_view_ci, nullptr, &renderer->shadow_map_image.image_view));
 
+    for (uint32_t cascade = 0; cascade < cascade_count; cascade++) {
+        VkImageSubresourceRange cascade_subresource_range = vk_lib::image_subresource_range(VK_IMAGE_ASPECT_DEPTH_BIT);
+        cascade_subresource_range.baseArrayLayer          = cascade;
+
+        VkImageViewCreateInfo cascade_view_ci =
+            vk_lib::image_view_create_info(VK_FORMAT_D32_SFLOAT, renderer->shadow_map_image.image, &cascade_subresource_range);
+        VK_CHECK(vkCreateImageView(renderer->vk_context.device, &cascade_view_ci, nullptr, &renderer->shadow_cascade_views[cascade]));
+    }
+
     VkDescriptorImageInfo shadow_map_desc_info =
         vk_lib::descriptor_image_info(renderer->shadow_map_image.image_view, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL, renderer->default_sampler);
     VkWriteDescriptorSet shadow_map_tex_write =
@@ -455,58 +938,227 @@ static void destroy_render_resources(Renderer* renderer) {
 
     vmaDestroyImage(renderer->allocator, renderer->depth_image.image, renderer->depth_image.allocation);
     vkDestroyImageView(renderer->vk_context.device, renderer->depth_image.image_view, nullptr);
+
+    for (uint32_t mip = 0; mip < renderer->hiz_mip_count; mip++) {
+        vkDestroyImageView(renderer->vk_context.device, renderer->hiz_mip_views[mip], nullptr);
+    }
+    vmaDestroyImage(renderer->allocator, renderer->hiz_image.image, renderer->hiz_image.allocation);
+    vkDestroyImageView(renderer->vk_context.device, renderer->hiz_image.image_view, nullptr);
+
+    if (renderer->headless_target_image.image != nullptr) {
+        vmaDestroyImage(renderer->allocator, renderer->headless_target_image.image, renderer->headless_target_image.allocation);
+        vkDestroyImageView(renderer->vk_context.device, renderer->headless_target_image.image_view, nullptr);
+        renderer->headless_target_image = {};
+    }
 }
 
-static void renderer_add_materials(Renderer* renderer, std::span<Material> materials) {
-    uint64_t           new_material_alloc_size = renderer->material_buffer.allocation_info.size + materials.size() * sizeof(Material);
-    VkBufferCreateInfo material_buf_ci         = vk_lib::buffer_create_info(
-        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, new_material_alloc_size);
-    VmaAllocationCreateInfo material_buf_allocation_ci{};
-    material_buf_allocation_ci.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
-    AllocatedBuffer new_material_buffer{};
-    VK_CHECK(vmaCreateBuffer(renderer->allocator, &material_buf_ci, &material_buf_allocation_ci, &new_material_buffer.buffer,
-                             &new_material_buffer.allocation, &new_material_buffer.allocation_info));
-
-    VkBufferCreateInfo      staging_buf_ci = vk_lib::buffer_create_info(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, materials.size_bytes());
-    VmaAllocationCreateInfo staging_buf_allocation_ci{};
-    staging_buf_allocation_ci.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
-    staging_buf_allocation_ci.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
-    AllocatedBuffer staging_buffer;
-    VK_CHECK(vmaCreateBuffer(renderer->allocator, &staging_buf_ci, &staging_buf_allocation_ci, &staging_buffer.buffer, &staging_buffer.allocation,
-                             &staging_buffer.allocation_info));
-
-    memcpy(staging_buffer.allocation_info.pMappedData, materials.data(), materials.size_bytes());
-
-    if (renderer->material_buffer.allocation_info.size > 0) {
-        vk_command_immediate_submit(
-            renderer->vk_context.device, renderer->vk_context.frame_command_pool, renderer->vk_context.graphics_queue, [&](VkCommandBuffer cmd_buf) {
-                VkBufferCopy old_buffer_copy = vk_lib::buffer_copy(sizeof(Material) * renderer->material_count);
-                vkCmdCopyBuffer(cmd_buf, renderer->material_buffer.buffer, new_material_buffer.buffer, 1, &old_buffer_copy);
-
-                VkBufferCopy staging_buffer_copy = vk_lib::buffer_copy(materials.size_bytes(), 0, sizeof(Material) * renderer->material_count);
-                vkCmdCopyBuffer(cmd_buf, staging_buffer.buffer, new_material_buffer.buffer, 1, &staging_buffer_copy);
-            });
-        vmaDestroyBuffer(renderer->allocator, renderer->material_buffer.buffer, renderer->material_buffer.allocation);
-    } else {
-        vk_command_immediate_submit(renderer->vk_context.device, renderer->vk_context.frame_command_pool, renderer->vk_context.graphics_queue,
-                                    [&](VkCommandBuffer cmd_buf) {
-                                        VkBufferCopy staging_buffer_copy = vk_lib::buffer_copy(materials.size_bytes());
-                                        vkCmdCopyBuffer(cmd_buf, staging_buffer.buffer, new_material_buffer.buffer, 1, &staging_buffer_copy);
-                                    });
+// destroys the buffer once no frame in flight can read it anymore
+static void renderer_retire_buffer(Renderer* renderer, const AllocatedBuffer* buffer) {
+    upload_manager_forget_buffer(&renderer->upload_manager, buffer->buffer);
+    renderer->retiring_buffers.push_back({*buffer, renderer->curr_frame + renderer->frames.size()});
+}
+
+static void retiring_buffers_retire(Renderer* renderer) {
+    std::erase_if(renderer->retiring_buffers, [&](const RetiringBuffer& retiring) {
+        if (retiring.retire_frame > renderer->curr_frame) {
+            return false;
+        }
+        vmaDestroyBuffer(renderer->allocator, retiring.buffer.buffer, retiring.buffer.allocation);
+        return true;
+    });
+}
+
+// smallest material buffer, in materials. it at least doubles when it runs out so streaming in assets doesn't replace it
+// every time
+static constexpr uint32_t material_store_min_capacity = 256;
+
+// largest write vkCmdUpdateBuffer takes
+static constexpr uint32_t material_update_max_count = 65536 / sizeof(Material);
+
+// moves the store into a buffer of new_capacity materials. the old contents come from the host copy, so nothing is
+// copied on the device. each frame points its scene set at the current buffer, and the old one retires once the frames
+// still reading it are done
+static void material_store_grow(Renderer* renderer, uint32_t new_capacity) {
+    TRACE_ZONE("material_store_grow");
+    MaterialStore* store        = &renderer->material_store;
+    const uint32_t old_capacity = store->slots.capacity;
+
+    AllocatedBuffer new_buffer = allocated_buffer_create(renderer->allocator, renderer->vk_context.device, new_capacity * sizeof(Material),
+                                                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                         VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE);
+    upload_manager_upload_buffer(&renderer->upload_manager, new_buffer.buffer, 0, std::as_bytes(std::span(store->materials)));
+    store->dirty_ranges.clear();
+
+    if (old_capacity > 0) {
+        renderer_retire_buffer(renderer, &store->buffer);
+    }
+    store->buffer = new_buffer;
+    store->materials.resize(new_capacity);
+    range_allocator_grow(&store->slots, new_capacity);
+}
+
+// copies materials into a free range of the store and returns the first index. the next frame writes them to the buffer
+static uint32_t material_store_allocate(Renderer* renderer, std::span<const Material> materials) {
+    MaterialStore* store          = &renderer->material_store;
+    const uint32_t material_count = materials.size();
+    if (material_count == 0) {
+        return 0;
+    }
+
+    uint32_t first_material;
+    if (!range_allocator_allocate(&store->slots, material_count, 1, &first_material)) {
+        const uint32_t old_capacity = store->slots.capacity;
+        material_store_grow(renderer, std::max({old_capacity * 2, old_capacity + material_count, material_store_min_capacity}));
+        if (!range_allocator_allocate(&store->slots, material_count, 1, &first_material)) {
+            abort_message("Failed to allocate from the material store");
+        }
+    }
+
+    std::ranges::copy(materials, store->materials.begin() + first_material);
+    store->dirty_ranges.push_back({first_material, material_count});
+    return first_material;
+}
+
+// allocated and not freed yet. freed ranges stay allocated until they retire
+static bool material_store_holds(const MaterialStore* store, uint32_t material_index) {
+    if (material_index >= store->slots.capacity || !range_allocator_is_allocated(&store->slots, material_index)) {
+        return false;
+    }
+    return std::ranges::none_of(store->retiring, [&](const RetiringRange& retiring) {
+        return material_index >= retiring.range.offset && material_index < retiring.range.offset + retiring.range.size;
+    });
+}
+
+void renderer_update_material(Renderer* renderer, uint32_t material_index, const Material* material) {
+    MaterialStore* store = &renderer->material_store;
+    if (!material_store_holds(store, material_index)) {
+        abort_message("Updated a material that isn't allocated");
     }
-    vmaDestroyBuffer(renderer->allocator, staging_buffer.buffer, staging_buffer.allocation);
 
-    renderer->material_buffer = new_material_buffer;
-    renderer->material_count += materials.size();
+    store->materials[material_index] = *material;
+    store->dirty_ranges.push_back({material_index, 1});
+}
+
+void renderer_free_materials(Renderer* renderer, Range materials) {
+    renderer->material_store.retiring.push_back({materials, renderer->curr_frame + renderer->frames.size()});
+}
+
+// hands freed ranges back to the allocator once no frame in flight can read them anymore
+static void material_store_retire(Renderer* renderer) {
+    MaterialStore* store = &renderer->material_store;
+    std::erase_if(store->retiring, [&](const RetiringRange& retiring) {
+        if (retiring.retire_frame > renderer->curr_frame) {
+            return false;
+        }
+        range_allocator_free(&store->slots, retiring.range.offset, retiring.range.size);
+        return true;
+    });
+}
+
+// writes the materials added or edited since the last frame in place. earlier frames on this queue may still read the
+// slots being rewritten, so the writes wait for them
+static void renderer_record_material_updates(Renderer* renderer, VkCommandBuffer command_buffer) {
+    MaterialStore* store = &renderer->material_store;
+    if (store->dirty_ranges.empty()) {
+        return;
+    }
+
+    const VkBufferMemoryBarrier2 update_buffer_memory_barrier =
+        vk_lib::buffer_memory_barrier_2(store->buffer.buffer, VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT, VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                        VK_ACCESS_2_SHADER_STORAGE_READ_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT);
+    const VkDependencyInfo update_dependency_info = vk_lib::dependency_info(nullptr, &update_buffer_memory_barrier, nullptr);
+    vkCmdPipelineBarrier2(command_buffer, &update_dependency_info);
+
+    for (const Range& range : store->dirty_ranges) {
+        for (uint32_t first = range.offset; first < range.offset + range.size; first += material_update_max_count) {
+            const uint32_t count = std::min(range.offset + range.size - first, material_update_max_count);
+            vkCmdUpdateBuffer(command_buffer, store->buffer.buffer, first * sizeof(Material), count * sizeof(Material), &store->materials[first]);
+        }
+    }
+    store->dirty_ranges.clear();
+
+    const VkBufferMemoryBarrier2 read_buffer_memory_barrier =
+        vk_lib::buffer_memory_barrier_2(store->buffer.buffer, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT,
+                                        VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+    const VkDependencyInfo read_dependency_info = vk_lib::dependency_info(nullptr, &read_buffer_memory_barrier, nullptr);
+    vkCmdPipelineBarrier2(command_buffer, &read_dependency_info);
+}
 
-    // update the descriptor for the materials
-    VkDescriptorBufferInfo descriptor_buffer_info = vk_lib::descriptor_buffer_info(renderer->material_buffer.buffer);
-    VkWriteDescriptorSet   descriptor_write =
-        vk_lib::write_descriptor_set(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, renderer->asset_descriptor_set, nullptr, &descriptor_buffer_info);
-    vkUpdateDescriptorSets(renderer->vk_context.device, 1, &descriptor_write, 0, nullptr);
+// largest bindless texture table. most devices allow far more, but every slot costs pool memory and is written once at
+// startup
+static constexpr uint32_t max_texture_table_capacity = 1 << 16;
+
+// fewer slots than this won't hold the textures of one large scene
+static constexpr uint32_t min_texture_table_capacity = 256;
+
+// sampled images the pipelines reading the texture table bind next to it, like the shadow map
+static constexpr uint32_t texture_table_reserved_descriptors = 8;
+
+// as many slots as an update after bind set can hold in every stage
+static uint32_t texture_table_capacity(VkPhysicalDevice physical_device) {
+    VkPhysicalDeviceVulkan12Properties vk_1_2_properties{};
+    vk_1_2_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 properties_2{};
+    properties_2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties_2.pNext = &vk_1_2_properties;
+    vkGetPhysicalDeviceProperties2(physical_device, &properties_2);
+
+    // combined image samplers count against both the sampler and the sampled image limits
+    const VkPhysicalDeviceVulkan12Properties* limits       = &vk_1_2_properties;
+    const uint32_t                            device_limit = std::min({limits->maxDescriptorSetUpdateAfterBindSampledImages,
+                                                                       limits->maxDescriptorSetUpdateAfterBindSamplers,
+                                                                       limits->maxPerStageDescriptorUpdateAfterBindSampledImages,
+                                                                       limits->maxPerStageDescriptorUpdateAfterBindSamplers});
+    const uint32_t capacity = device_limit > texture_table_reserved_descriptors ? device_limit - texture_table_reserved_descriptors : 0;
+    if (capacity < min_texture_table_capacity) {
+        abort_message("The device can't bind enough update after bind textures for the texture table");
+    }
+    return std::min(capacity, max_texture_table_capacity);
+}
+
+static void texture_table_write(const Renderer* renderer, uint32_t first_slot, std::span<const VkDescriptorImageInfo> image_infos) {
+    VkWriteDescriptorSet write_descriptor_set =
+        vk_lib::write_descriptor_set(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, renderer->asset_descriptor_set, image_infos.data(), nullptr,
+                                     nullptr, first_slot, image_infos.size());
+    vkUpdateDescriptorSets(renderer->vk_context.device, 1, &write_descriptor_set, 0, nullptr);
+}
+
+// points the slots at the default texture
+static void texture_table_clear(const Renderer* renderer, Range slots) {
+    if (slots.size == 0) {
+        return;
+    }
+    const VkDescriptorImageInfo default_image_info =
+        vk_lib::descriptor_image_info(renderer->default_texture_image.image_view, renderer->default_texture_image.layout, renderer->default_sampler);
+    const std::vector<VkDescriptorImageInfo> image_infos(slots.size, default_image_info);
+    texture_table_write(renderer, slots.offset, image_infos);
+}
+
+// hands freed ranges back to the allocator once no frame in flight can sample them anymore
+static void texture_table_retire(Renderer* renderer) {
+    TextureTable* table = &renderer->texture_table;
+    std::erase_if(table->retiring, [&](const RetiringRange& retiring) {
+        if (retiring.retire_frame > renderer->curr_frame) {
+            return false;
+        }
+        texture_table_clear(renderer, retiring.range);
+        range_allocator_free(&table->slots, retiring.range.offset, retiring.range.size);
+        return true;
+    });
 }
 
-static void renderer_add_textures(Renderer* renderer, std::span<Texture> textures) {
+// takes a range of the texture table for textures and returns its first slot
+static uint32_t renderer_add_textures(Renderer* renderer, std::span<const Texture> textures) {
+    TRACE_ZONE("renderer_add_textures");
+    if (textures.empty()) {
+        return 0;
+    }
+
+    uint32_t first_texture;
+    if (!range_allocator_allocate(&renderer->texture_table.slots, textures.size(), 1, &first_texture)) {
+        abort_message("The texture table is full");
+    }
 
     std::vector<VkDescriptorImageInfo> descriptor_image_infos;
     descriptor_image_infos.reserve(textures.size());
@@ -515,30 +1167,42 @@ static void renderer_add_textures(Renderer* renderer, std::span<Texture> texture
         VkDescriptorImageInfo image_info = vk_lib::descriptor_image_info(texture.image.image_view, texture.image.layout, sampler);
         descriptor_image_infos.push_back(image_info);
     }
+    texture_table_write(renderer, first_texture, descriptor_image_infos);
+    return first_texture;
+}
 
-    VkWriteDescriptorSet write_descriptor_set =
-        vk_lib::write_descriptor_set(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, renderer->asset_descriptor_set, descriptor_image_infos.data(),
-                                     nullptr, nullptr, renderer->texture_count, descriptor_image_infos.size());
-    vkUpdateDescriptorSets(renderer->vk_context.device, 1, &write_descriptor_set, 0, nullptr);
-    renderer->texture_count += textures.size();
+void renderer_free_textures(Renderer* renderer, Range textures) {
+    renderer->texture_table.retiring.push_back({textures, renderer->curr_frame + renderer->frames.size()});
 }
 
 static void renderer_init_shader_data(Renderer* renderer) {
+    TRACE_ZONE("renderer_init_shader_data");
     const VkContext* vk_ctx = &renderer->vk_context;
 
-    constexpr uint32_t variable_texture_count = 300;
+    const uint32_t texture_count    = texture_table_capacity(vk_ctx->physical_device);
+    const uint32_t shadow_set_count = renderer->frames.size() * renderer->shadow_cascade_count;
 
-    VkDescriptorPoolSize       shadow_scene_data_pool_size   = vk_lib::descriptor_pool_size(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3);
+    VkDescriptorPoolSize       shadow_scene_data_pool_size   = vk_lib::descriptor_pool_size(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, shadow_set_count);
     VkDescriptorPoolSize       scene_data_pool_size          = vk_lib::descriptor_pool_size(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3);
     VkDescriptorPoolSize       shadow_map_textures_pool_size = vk_lib::descriptor_pool_size(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1);
-    VkDescriptorPoolSize       materials_pool_size           = vk_lib::descriptor_pool_size(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1);
+    VkDescriptorPoolSize       materials_pool_size           = vk_lib::descriptor_pool_size(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3);
     VkDescriptorPoolSize       histogram_pool_size           = vk_lib::descriptor_pool_size(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1);
-    VkDescriptorPoolSize       color_correct_pool_size       = vk_lib::descriptor_pool_size(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1);
-    VkDescriptorPoolSize       textures_pool_size = vk_lib::descriptor_pool_size(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, variable_texture_count);
-    std::array                 pool_sizes = {shadow_scene_data_pool_size, scene_data_pool_size, shadow_map_textures_pool_size, materials_pool_size,
-                                             textures_pool_size,          histogram_pool_size,  color_correct_pool_size};
+    VkDescriptorPoolSize       textures_pool_size            = vk_lib::descriptor_pool_size(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, texture_count);
+    // color correct sets are per frame since each one points at that frame's swapchain image
+    VkDescriptorPoolSize       color_correct_sampled_pool_size =
+        vk_lib::descriptor_pool_size(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, renderer->frames.size());
+    VkDescriptorPoolSize       color_correct_storage_pool_size =
+        vk_lib::descriptor_pool_size(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, renderer->frames.size());
+    // one set per hi-z mip plus the set the occlusion cull samples the whole pyramid through
+    VkDescriptorPoolSize       hiz_sampled_pool_size = vk_lib::descriptor_pool_size(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, max_hiz_mip_count + 1);
+    VkDescriptorPoolSize       hiz_storage_pool_size = vk_lib::descriptor_pool_size(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, max_hiz_mip_count);
+    std::array                 pool_sizes = {shadow_scene_data_pool_size,     scene_data_pool_size,            shadow_map_textures_pool_size,
+                                             materials_pool_size,             textures_pool_size,              histogram_pool_size,
+                                             color_correct_sampled_pool_size, color_correct_storage_pool_size, hiz_sampled_pool_size,
+                                             hiz_storage_pool_size};
+    const uint32_t             max_sets   = 5 + renderer->frames.size() + shadow_set_count + max_hiz_mip_count + 1;
     VkDescriptorPoolCreateInfo descriptor_pool_ci =
-        vk_lib::descriptor_pool_create_info(9, pool_sizes, VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT);
+        vk_lib::descriptor_pool_create_info(max_sets, pool_sizes, VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT);
 
     VK_CHECK(vkCreateDescriptorPool(vk_ctx->device, &descriptor_pool_ci, nullptr, &renderer->descriptor_pool));
 
@@ -554,40 +1218,58 @@ static void renderer_init_shader_data(Renderer* renderer) {
     VkDescriptorSetLayoutCreateInfo build_histogram_set_layout_ci = vk_lib::descriptor_set_layout_create_info(build_histogram_bindings);
     vkCreateDescriptorSetLayout(vk_ctx->device, &build_histogram_set_layout_ci, nullptr, &renderer->build_histogram_descriptor_set_layout);
 
-    // build histogram descriptor layout
-    VkDescriptorSetLayoutBinding    hdr_image_binding           = vk_lib::descriptor_set_layout_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-    std::array                      color_correct_bindings      = {hdr_image_binding};
+    // color correct descriptor layout. samples the resolved hdr image and stores the tone mapped result into the output image
+    VkDescriptorSetLayoutBinding    hdr_image_binding           = vk_lib::descriptor_set_layout_binding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    VkDescriptorSetLayoutBinding    output_image_binding        = vk_lib::descriptor_set_layout_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+    std::array                      color_correct_bindings      = {hdr_image_binding, output_image_binding};
     VkDescriptorSetLayoutCreateInfo color_correct_set_layout_ci = vk_lib::descriptor_set_layout_create_info(color_correct_bindings);
     vkCreateDescriptorSetLayout(vk_ctx->device, &color_correct_set_layout_ci, nullptr, &renderer->color_correct_descriptor_set_layout);
 
-    // main scene descriptor layout
+    // hi-z build descriptor layout. reads the previous level and writes the next
+    VkDescriptorSetLayoutBinding    hiz_src_binding   = vk_lib::descriptor_set_layout_binding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    VkDescriptorSetLayoutBinding    hiz_dst_binding   = vk_lib::descriptor_set_layout_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+    std::array                      hiz_bindings      = {hiz_src_binding, hiz_dst_binding};
+    VkDescriptorSetLayoutCreateInfo hiz_set_layout_ci = vk_lib::descriptor_set_layout_create_info(hiz_bindings);
+    vkCreateDescriptorSetLayout(vk_ctx->device, &hiz_set_layout_ci, nullptr, &renderer->hiz_descriptor_set_layout);
+
+    // occlusion cull descriptor layout
+    VkDescriptorSetLayoutBinding    hiz_pyramid_binding = vk_lib::descriptor_set_layout_binding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    std::array                      occlusion_cull_bindings = {hiz_pyramid_binding};
+    VkDescriptorSetLayoutCreateInfo occlusion_cull_set_layout_ci = vk_lib::descriptor_set_layout_create_info(occlusion_cull_bindings);
+    vkCreateDescriptorSetLayout(vk_ctx->device, &occlusion_cull_set_layout_ci, nullptr, &renderer->occlusion_cull_descriptor_set_layout);
+
+    // main scene descriptor layout. the materials live here rather than in the asset set so a frame's binding can move to
+    // a grown store while earlier frames still read the old one
     VkDescriptorSetLayoutBinding    scene_data_layout_binding      = vk_lib::descriptor_set_layout_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-    std::array                      scene_layout_bindings          = {scene_data_layout_binding};
+    VkDescriptorSetLayoutBinding    materials_layout_binding       = vk_lib::descriptor_set_layout_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    std::array                      scene_layout_bindings          = {scene_data_layout_binding, materials_layout_binding};
     VkDescriptorSetLayoutCreateInfo scene_descriptor_set_layout_ci = vk_lib::descriptor_set_layout_create_info(scene_layout_bindings);
     vkCreateDescriptorSetLayout(vk_ctx->device, &scene_descriptor_set_layout_ci, nullptr, &renderer->scene_descriptor_set_layout);
 
     // assets descriptor layout
     VkDescriptorSetLayoutBinding shadow_map_layout_binding = vk_lib::descriptor_set_layout_binding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-    VkDescriptorSetLayoutBinding materials_layout_binding  = vk_lib::descriptor_set_layout_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
     VkDescriptorSetLayoutBinding textures_layout_binding =
-        vk_lib::descriptor_set_layout_binding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, variable_texture_count);
-    std::array                              asset_layout_bindings = {shadow_map_layout_binding, materials_layout_binding, textures_layout_binding};
-    std::array<VkDescriptorBindingFlags, 3> asset_binding_flags   = {0, 0, VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT};
+        vk_lib::descriptor_set_layout_binding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, texture_count);
+    // texture slots are written while frames that don't sample them are still in flight
+    constexpr VkDescriptorBindingFlags texture_binding_flags = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                                                               VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT |
+                                                               VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT;
+    std::array                              asset_layout_bindings = {shadow_map_layout_binding, textures_layout_binding};
+    std::array<VkDescriptorBindingFlags, 2> asset_binding_flags   = {0, texture_binding_flags};
     VkDescriptorSetLayoutBindingFlagsCreateInfo asset_binding_flags_ci{};
     asset_binding_flags_ci.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
     asset_binding_flags_ci.bindingCount  = asset_binding_flags.size();
     asset_binding_flags_ci.pBindingFlags = asset_binding_flags.data();
     asset_binding_flags_ci.pNext         = nullptr;
-    VkDescriptorSetLayoutCreateInfo descriptor_set_layout_ci =
-        vk_lib::descriptor_set_layout_create_info(asset_layout_bindings, 0, &asset_binding_flags_ci);
+    VkDescriptorSetLayoutCreateInfo descriptor_set_layout_ci = vk_lib::descriptor_set_layout_create_info(
+        asset_layout_bindings, VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT, &asset_binding_flags_ci);
     vkCreateDescriptorSetLayout(vk_ctx->device, &descriptor_set_layout_ci, nullptr, &renderer->asset_descriptor_set_layout);
 
     // shadow descriptors allocation
-    std::array shadow_scene_set_layouts = {renderer->shadow_descriptor_set_layout, renderer->shadow_descriptor_set_layout,
-                                           renderer->shadow_descriptor_set_layout};
-    renderer->shadow_descriptor_sets.resize(renderer->frames.size());
+    std::vector<VkDescriptorSetLayout> shadow_scene_set_layouts(shadow_set_count, renderer->shadow_descriptor_set_layout);
+    renderer->shadow_descriptor_sets.resize(shadow_set_count);
     VkDescriptorSetAllocateInfo shadow_scene_desc_set_ai =
-        vk_lib::descriptor_set_allocate_info(shadow_scene_set_layouts.data(), renderer->descriptor_pool, renderer->frames.size());
+        vk_lib::descriptor_set_allocate_info(shadow_scene_set_layouts.data(), renderer->descriptor_pool, shadow_set_count);
     VK_CHECK(vkAllocateDescriptorSets(vk_ctx->device, &shadow_scene_desc_set_ai, renderer->shadow_descriptor_sets.data()));
 
     // build exposure histogram descriptor allocation
@@ -595,10 +1277,23 @@ static void renderer_init_shader_data(Renderer* renderer) {
         vk_lib::descriptor_set_allocate_info(&renderer->build_histogram_descriptor_set_layout, renderer->descriptor_pool, 1);
     VK_CHECK(vkAllocateDescriptorSets(vk_ctx->device, &histogram_desc_set_ai, &renderer->build_histogram_descriptor_set));
 
-    // color correct descriptor allocation
+    // color correct descriptors allocation
+    std::vector<VkDescriptorSetLayout> color_correct_set_layouts(renderer->frames.size(), renderer->color_correct_descriptor_set_layout);
+    renderer->color_correct_descriptor_sets.resize(renderer->frames.size());
     VkDescriptorSetAllocateInfo color_correct_desc_set_ai =
-        vk_lib::descriptor_set_allocate_info(&renderer->color_correct_descriptor_set_layout, renderer->descriptor_pool, 1);
-    VK_CHECK(vkAllocateDescriptorSets(vk_ctx->device, &color_correct_desc_set_ai, &renderer->color_correct_descriptor_set));
+        vk_lib::descriptor_set_allocate_info(color_correct_set_layouts.data(), renderer->descriptor_pool, renderer->frames.size());
+    VK_CHECK(vkAllocateDescriptorSets(vk_ctx->device, &color_correct_desc_set_ai, renderer->color_correct_descriptor_sets.data()));
+
+    // hi-z descriptors allocation. sized for the largest pyramid so a resize only has to rewrite them
+    std::array<VkDescriptorSetLayout, max_hiz_mip_count> hiz_set_layouts{};
+    hiz_set_layouts.fill(renderer->hiz_descriptor_set_layout);
+    VkDescriptorSetAllocateInfo hiz_desc_set_ai =
+        vk_lib::descriptor_set_allocate_info(hiz_set_layouts.data(), renderer->descriptor_pool, max_hiz_mip_count);
+    VK_CHECK(vkAllocateDescriptorSets(vk_ctx->device, &hiz_desc_set_ai, renderer->hiz_descriptor_sets.data()));
+
+    VkDescriptorSetAllocateInfo occlusion_cull_desc_set_ai =
+        vk_lib::descriptor_set_allocate_info(&renderer->occlusion_cull_descriptor_set_layout, renderer->descriptor_pool, 1);
+    VK_CHECK(vkAllocateDescriptorSets(vk_ctx->device, &occlusion_cull_desc_set_ai, &renderer->occlusion_cull_descriptor_set));
 
     // scene descriptors allocation
     std::array scene_set_layouts = {renderer->scene_descriptor_set_layout, renderer->scene_descriptor_set_layout,
@@ -612,7 +1307,7 @@ static void renderer_init_shader_data(Renderer* renderer) {
     VkDescriptorSetVariableDescriptorCountAllocateInfoEXT variable_info{};
     variable_info.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO_EXT;
     variable_info.descriptorSetCount = 1;
-    variable_info.pDescriptorCounts  = &variable_texture_count;
+    variable_info.pDescriptorCounts  = &texture_count;
     variable_info.descriptorSetCount = 1;
 
     VkDescriptorSetAllocateInfo asset_desc_set_ai =
@@ -632,25 +1327,27 @@ static void renderer_init_shader_data(Renderer* renderer) {
     default_material.metallic_factor            = 1;
     default_material.roughness_factor           = 1;
 
+    // always the first material, draws without one use it
     std::array default_materials = {default_material};
-    renderer_add_materials(renderer, default_materials);
+    material_store_allocate(renderer, default_materials);
 
     // create default sampler
     VkSamplerCreateInfo default_sampler_ci = vk_lib::sampler_create_info();
     VK_CHECK(vkCreateSampler(renderer->vk_context.device, &default_sampler_ci, nullptr, &renderer->default_sampler));
 
-    // create image with one pixel?
-    VkBufferCreateInfo      staging_buf_ci = vk_lib::buffer_create_info(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 4);
-    VmaAllocationCreateInfo staging_buf_allocation_ci{};
-    staging_buf_allocation_ci.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
-    staging_buf_allocation_ci.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
-    AllocatedBuffer staging_buffer;
-    VK_CHECK(vmaCreateBuffer(renderer->allocator, &staging_buf_ci, &staging_buf_allocation_ci, &staging_buffer.buffer, &staging_buffer.allocation,
-                             &staging_buffer.allocation_info));
-
-    uint8_t image_data[4] = {255, 255, 255, 255};
-    memcpy(staging_buffer.allocation_info.pMappedData, image_data, 4);
+    // hi-z reads are exact texel fetches of a single mip
+    VkSamplerCreateInfo hiz_sampler_ci = vk_lib::sampler_create_info();
+    hiz_sampler_ci.magFilter           = VK_FILTER_NEAREST;
+    hiz_sampler_ci.minFilter           = VK_FILTER_NEAREST;
+    hiz_sampler_ci.mipmapMode          = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    hiz_sampler_ci.addressModeU        = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    hiz_sampler_ci.addressModeV        = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    hiz_sampler_ci.addressModeW        = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    hiz_sampler_ci.minLod              = 0.f;
+    hiz_sampler_ci.maxLod              = VK_LOD_CLAMP_NONE;
+    VK_CHECK(vkCreateSampler(renderer->vk_context.device, &hiz_sampler_ci, nullptr, &renderer->hiz_sampler));
 
+    // create image with one pixel?
     VkImageCreateInfo default_tex_image_ci =
         vk_lib::image_create_info(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, vk_lib::extent_3d(1, 1));
     VmaAllocationCreateInfo default_tex_allocation_ci{};
@@ -664,26 +1361,9 @@ static void renderer_init_shader_data(Renderer* renderer) {
         vk_lib::image_view_create_info(VK_FORMAT_R8G8B8A8_UNORM, renderer->default_texture_image.image, &subresource_range);
     VK_CHECK(vkCreateImageView(vk_ctx->device, &default_tex_image_view_ci, nullptr, &renderer->default_texture_image.image_view));
 
-    vk_command_immediate_submit(
-        renderer->vk_context.device, renderer->vk_context.frame_command_pool, renderer->vk_context.graphics_queue, [&](VkCommandBuffer cmd_buf) {
-            VkImageMemoryBarrier2 pre_transfer_memory_barrier = vk_lib::image_memory_barrier_2(
-                renderer->default_texture_image.image, subresource_range, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-
-            VkDependencyInfo pre_transfer_dependency_info = vk_lib::dependency_info(&pre_transfer_memory_barrier, nullptr, nullptr);
-            vkCmdPipelineBarrier2(cmd_buf, &pre_transfer_dependency_info);
-
-            VkImageSubresourceLayers image_subresource_layers = vk_lib::image_subresource_layers(VK_IMAGE_ASPECT_COLOR_BIT);
-            VkBufferImageCopy        copy_region              = vk_lib::buffer_image_copy(image_subresource_layers, vk_lib::extent_3d(1, 1));
-            vkCmdCopyBufferToImage(cmd_buf, staging_buffer.buffer, renderer->default_texture_image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
-                                   &copy_region);
-
-            VkImageMemoryBarrier2 texture_use_memory_barrier =
-                vk_lib::image_memory_barrier_2(renderer->default_texture_image.image, subresource_range, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                               VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-            VkDependencyInfo texture_use_dependency_info = vk_lib::dependency_info(&texture_use_memory_barrier, nullptr, nullptr);
-            vkCmdPipelineBarrier2(cmd_buf, &texture_use_dependency_info);
-        });
+    const std::array<uint8_t, 4> image_data = {255, 255, 255, 255};
+    upload_manager_upload_image(&renderer->upload_manager, renderer->default_texture_image.image, 0, vk_lib::extent_3d(1, 1),
+                                std::as_bytes(std::span(image_data)), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
     renderer->default_texture_image.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
@@ -691,6 +1371,10 @@ static void renderer_init_shader_data(Renderer* renderer) {
     default_texture.image   = renderer->default_texture_image;
     default_texture.sampler = renderer->default_sampler;
 
+    // every slot samples the default texture until it's handed out, and the default texture itself takes slot 0
+    renderer->texture_table.slots = range_allocator_create(texture_count);
+    texture_table_clear(renderer, {0, texture_count});
+
     std::array default_textures = {default_texture};
     renderer_add_textures(renderer, default_textures);
 
@@ -706,146 +1390,675 @@ static void renderer_init_shader_data(Renderer* renderer) {
 
         renderer->main_scene_data_buffers.push_back(main_scene_buffer);
 
-        AllocatedBuffer shadow_scene_buffer;
-        VK_CHECK(vmaCreateBuffer(renderer->allocator, &scene_buf_ci, &scene_buf_allocation_ci, &shadow_scene_buffer.buffer,
-                                 &shadow_scene_buffer.allocation, &shadow_scene_buffer.allocation_info));
+        for (uint32_t cascade = 0; cascade < renderer->shadow_cascade_count; cascade++) {
+            AllocatedBuffer shadow_scene_buffer;
+            VK_CHECK(vmaCreateBuffer(renderer->allocator, &scene_buf_ci, &scene_buf_allocation_ci, &shadow_scene_buffer.buffer,
+                                     &shadow_scene_buffer.allocation, &shadow_scene_buffer.allocation_info));
 
-        renderer->shadow_scene_data_buffers.push_back(shadow_scene_buffer);
+            renderer->shadow_scene_data_buffers.push_back(shadow_scene_buffer);
+        }
     }
+}
 
-    vmaDestroyBuffer(renderer->allocator, staging_buffer.buffer, staging_buffer.allocation);
+static uint32_t indirect_batch_index(const DrawObject* draw, bool transparent) {
+    uint32_t batch = draw->double_sided ? 2 : 0;
+    if (draw->front_face == VK_FRONT_FACE_CLOCKWISE) {
+        batch++;
+    }
+    return transparent ? batch + indirect_opaque_batch_count : batch;
 }
 
-void renderer_add_gltf_asset(Renderer* renderer, const char* gltf_path) {
-    vk_gltf::LoadOptions gltf_load_options{};
-    gltf_load_options.gltf_path      = gltf_path;
-    gltf_load_options.cache_dir      = "cache/";
-    gltf_load_options.create_mipmaps = true;
+// smallest arena buffers, in elements. the arena at least doubles when it runs out so loading several assets doesn't
+// copy it every time
+static constexpr uint32_t geometry_arena_min_index_capacity  = 1 << 20;
+static constexpr uint32_t geometry_arena_min_vertex_capacity = 1 << 22;
+
+// sub-allocates count elements from an arena buffer. when it's full the buffer grows: the next frame copies the old
+// contents over before anything else, and the old buffer retires once the frames in flight are done reading it
+static uint32_t geometry_arena_allocate(Renderer* renderer, AllocatedBuffer* buffer, RangeAllocator* ranges, uint32_t count, uint32_t alignment,
+                                        uint32_t element_size, VkBufferUsageFlags usage, uint32_t min_capacity) {
+    uint32_t offset;
+    if (range_allocator_allocate(ranges, count, alignment, &offset)) {
+        return offset;
+    }
 
-    vk_gltf::GltfAsset asset = vk_gltf::load_gltf(&gltf_load_options, renderer->allocator, renderer->vk_context.device,
-                                                  renderer->vk_context.frame_command_pool, renderer->vk_context.graphics_queue);
+    const uint32_t old_capacity = ranges->capacity;
+    const uint32_t new_capacity = std::max({old_capacity * 2, old_capacity + count + alignment, min_capacity});
 
-    // add new draw objects
-    for (const vk_gltf::GltfNode& node : asset.nodes) {
-        if (!node.mesh.has_value()) {
-            // only renderer nodes with meshes
-            continue;
-        }
-        const vk_gltf::GltfMesh* gltf_mesh = &asset.meshes[node.mesh.value()];
-        for (const vk_gltf::GltfPrimitive& gltf_primitive : gltf_mesh->primitives) {
-            DrawObject new_draw_object{};
-            new_draw_object.transform     = glm::make_mat4(node.world_transform);
-            new_draw_object.topology      = gltf_primitive.topology;
-            new_draw_object.bounds.origin = glm::make_vec3(gltf_primitive.bounds.origin);
-            new_draw_object.bounds.extent = glm::make_vec3(gltf_primitive.bounds.extent);
+    AllocatedBuffer new_buffer = allocated_buffer_create(renderer->allocator, renderer->vk_context.device,
+                                                         static_cast<VkDeviceSize>(new_capacity) * element_size,
+                                                         usage | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                                                             VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                                         VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE);
 
-            if (glm::determinant(new_draw_object.transform) > 0) {
-                new_draw_object.front_face = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-            } else {
-                new_draw_object.front_face = VK_FRONT_FACE_CLOCKWISE;
-            }
+    if (old_capacity > 0) {
+        const VkBufferCopy old_buffer_copy = vk_lib::buffer_copy(static_cast<VkDeviceSize>(old_capacity) * element_size);
+        renderer->geometry_arena.pending_copies.push_back({buffer->buffer, new_buffer.buffer, old_buffer_copy});
+        renderer_retire_buffer(renderer, buffer);
+    }
+    *buffer = new_buffer;
 
-            if (gltf_primitive.index_buffer.has_value()) {
-                const vk_gltf::GltfBuffer* gltf_buf = &gltf_primitive.index_buffer.value();
-                AllocatedBuffer            index_buf{};
-                index_buf.address         = gltf_buf->address;
-                index_buf.buffer          = gltf_buf->buffer;
-                index_buf.allocation      = gltf_buf->allocation;
-                index_buf.allocation_info = gltf_buf->allocation_info;
+    range_allocator_grow(ranges, new_capacity);
+    if (!range_allocator_allocate(ranges, count, alignment, &offset)) {
+        abort_message("Failed to allocate from the geometry arena");
+    }
+    return offset;
+}
 
-                new_draw_object.index_buffer = index_buf;
-            } else {
-                abort_message("currently not handling GLTF assets without index buffers");
-            }
+// takes arena ranges for an asset the loader encoded and queues the copy into them for the next frame, which is the
+// first one to draw the asset. the encoded buffers retire after that frame
+static std::vector<ArenaGeometry> renderer_upload_geometry(Renderer* renderer, EncodedGeometry* encoded) {
+    TRACE_ZONE("renderer_upload_geometry");
 
-            new_draw_object.index_count = gltf_primitive.index_count;
-            new_draw_object.index_type  = gltf_primitive.index_type;
+    GeometryArena*             arena      = &renderer->geometry_arena;
+    std::vector<ArenaGeometry> geometries = std::move(encoded->geometries);
+    if (geometries.empty()) {
+        return geometries;
+    }
 
-            const vk_gltf::GltfBuffer* gltf_buf = &gltf_primitive.vertex_buffer;
+    // aligning the range to the stride lets gl_VertexIndex address every format from the arena base. the encoded
+    // primitives are whole strides apart, so they stay aligned inside it
+    const uint32_t vertex_stride = vertex_format_stride(geometries[0].vertex_format);
+    const uint32_t first_index   = geometry_arena_allocate(renderer, &arena->index_buffer, &arena->index_ranges, encoded->index_count, 1,
+                                                           sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, geometry_arena_min_index_capacity);
+    const uint32_t vertex_word_offset =
+        geometry_arena_allocate(renderer, &arena->vertex_buffer, &arena->vertex_ranges, encoded->vertex_word_count, vertex_stride, sizeof(uint32_t),
+                                0, geometry_arena_min_vertex_capacity);
+
+    if (encoded->index_count > 0) {
+        VkBufferCopy index_copy = vk_lib::buffer_copy(static_cast<VkDeviceSize>(encoded->index_count) * sizeof(uint32_t));
+        index_copy.dstOffset    = static_cast<VkDeviceSize>(first_index) * sizeof(uint32_t);
+        arena->pending_copies.push_back({encoded->index_buffer.buffer, arena->index_buffer.buffer, index_copy});
+        renderer_retire_buffer(renderer, &encoded->index_buffer);
+    }
+    if (encoded->vertex_word_count > 0) {
+        VkBufferCopy vertex_copy = vk_lib::buffer_copy(static_cast<VkDeviceSize>(encoded->vertex_word_count) * sizeof(uint32_t));
+        vertex_copy.dstOffset    = static_cast<VkDeviceSize>(vertex_word_offset) * sizeof(uint32_t);
+        arena->pending_copies.push_back({encoded->vertex_buffer.buffer, arena->vertex_buffer.buffer, vertex_copy});
+        renderer_retire_buffer(renderer, &encoded->vertex_buffer);
+    }
+    *encoded = {};
 
-            AllocatedBuffer vertex_buf{};
-            vertex_buf.address         = gltf_buf->address;
-            vertex_buf.buffer          = gltf_buf->buffer;
-            vertex_buf.allocation      = gltf_buf->allocation;
-            vertex_buf.allocation_info = gltf_buf->allocation_info;
+    for (ArenaGeometry& geometry : geometries) {
+        geometry.first_index += first_index;
+        geometry.vertex_offset += static_cast<int32_t>(vertex_word_offset / vertex_stride);
+    }
+    return geometries;
+}
 
-            new_draw_object.vertex_buffer = vertex_buf;
+// records the copies queued into the arena since the last frame, in order, before anything in the frame reads it. a copy
+// can read what an earlier one wrote when the arena grew, and the encoded buffers were written on a loader queue
+static void renderer_record_geometry_copies(Renderer* renderer, VkCommandBuffer command_buffer) {
+    GeometryArena* arena = &renderer->geometry_arena;
+    if (arena->pending_copies.empty()) {
+        return;
+    }
 
-            if (gltf_primitive.material.has_value()) {
-                // offset the material index by how many materials we already have from other gltf assets
-                new_draw_object.material_index = gltf_primitive.material.value() + renderer->material_count;
-                new_draw_object.double_sided   = asset.materials[gltf_primitive.material.value()].double_sided;
+    for (const GeometryArenaCopy& copy : arena->pending_copies) {
+        const VkBufferMemoryBarrier2 src_buffer_memory_barrier = vk_lib::buffer_memory_barrier_2(
+            copy.src_buffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_COPY_BIT, VK_PIPELINE_STAGE_2_COPY_BIT,
+            VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_ACCESS_2_TRANSFER_READ_BIT);
+        const VkBufferMemoryBarrier2 dst_buffer_memory_barrier =
+            vk_lib::buffer_memory_barrier_2(copy.dst_buffer, VK_PIPELINE_STAGE_2_COPY_BIT, VK_PIPELINE_STAGE_2_COPY_BIT,
+                                            VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT);
+        std::array             copy_barriers        = {src_buffer_memory_barrier, dst_buffer_memory_barrier};
+        const VkDependencyInfo copy_dependency_info = vk_lib::dependency_info_batch({}, copy_barriers, {});
+        vkCmdPipelineBarrier2(command_buffer, &copy_dependency_info);
+
+        vkCmdCopyBuffer(command_buffer, copy.src_buffer, copy.dst_buffer, 1, &copy.region);
+    }
+    arena->pending_copies.clear();
+
+    const VkBufferMemoryBarrier2 index_read_buffer_memory_barrier =
+        vk_lib::buffer_memory_barrier_2(arena->index_buffer.buffer, VK_PIPELINE_STAGE_2_COPY_BIT, VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT,
+                                        VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_ACCESS_2_INDEX_READ_BIT);
+    const VkBufferMemoryBarrier2 vertex_read_buffer_memory_barrier =
+        vk_lib::buffer_memory_barrier_2(arena->vertex_buffer.buffer, VK_PIPELINE_STAGE_2_COPY_BIT, VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT,
+                                        VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+
+    std::array             geometry_read_barriers        = {index_read_buffer_memory_barrier, vertex_read_buffer_memory_barrier};
+    const VkDependencyInfo geometry_read_dependency_info = vk_lib::dependency_info_batch({}, geometry_read_barriers, {});
+    vkCmdPipelineBarrier2(command_buffer, &geometry_read_dependency_info);
+}
 
-                if (asset.materials[gltf_primitive.material.value()].alpha_mode == vk_gltf::GltfAlphaMode::opaque) {
-                    renderer->opaque_draws.push_back(new_draw_object);
-                } else {
-                    renderer->transparent_draws.push_back(new_draw_object);
-                }
-            } else {
-                // default material index
-                new_draw_object.material_index = 0;
-                // assume opaque when no material
-                renderer->opaque_draws.push_back(new_draw_object);
-            }
-        }
+// the shadow pass draws every opaque draw, so its order only changes when draws are added. depth and material are left
+// out so draws only group by raster state
+static void renderer_sort_shadow_draws(Renderer* renderer) {
+    renderer->draw_sort_keys.clear();
+    for (uint32_t i = 0; i < renderer->opaque_draws.size(); i++) {
+        const DrawObject* draw = &renderer->opaque_draws[i];
+        renderer->draw_sort_keys.push_back(draw_sort_key(draw->double_sided, draw->front_face, 0.f, 0, i));
     }
+    radix_sort_keys(&renderer->draw_sort_keys, &renderer->draw_sort_scratch);
 
-    if (renderer->visible_opaque_draws.capacity() < renderer->opaque_draws.size()) {
-        renderer->visible_opaque_draws.reserve(renderer->opaque_draws.size());
+    renderer->shadow_draw_order.clear();
+    for (uint64_t key : renderer->draw_sort_keys) {
+        renderer->shadow_draw_order.push_back(draw_sort_key_draw_index(key));
     }
-    if (renderer->visible_transparent_draws.capacity() < renderer->transparent_draws.size()) {
-        renderer->visible_transparent_draws.reserve(renderer->transparent_draws.size());
+
+    const CullBounds* cull_bounds      = &renderer->opaque_cull_bounds;
+    renderer->shadow_caster_bounds_min = glm::vec3(std::numeric_limits<float>::max());
+    renderer->shadow_caster_bounds_max = glm::vec3(-std::numeric_limits<float>::max());
+    for (uint32_t i = 0; i < cull_bounds_count(cull_bounds); i++) {
+        const glm::vec3 center      = {cull_bounds->center_x[i], cull_bounds->center_y[i], cull_bounds->center_z[i]};
+        const glm::vec3 half_extent = {cull_bounds->half_extent_x[i], cull_bounds->half_extent_y[i], cull_bounds->half_extent_z[i]};
+        renderer->shadow_caster_bounds_min = glm::min(renderer->shadow_caster_bounds_min, center - half_extent);
+        renderer->shadow_caster_bounds_max = glm::max(renderer->shadow_caster_bounds_max, center + half_extent);
+    }
+
+    // the caster set changed
+    renderer_invalidate_shadow_map(renderer);
+}
+
+// rebuilds the per draw gpu data, the batch layout of the indirect command buffers and the static shadow commands
+static void renderer_update_gpu_draws(Renderer* renderer) {
+    TRACE_ZONE("renderer_update_gpu_draws");
+
+    const uint32_t draw_count = renderer->opaque_draws.size() + renderer->transparent_draws.size();
+    if (draw_count == 0) {
+        // every asset was unloaded. the old buffers stay around but nothing is drawn from them
+        renderer->gpu_draw_count = 0;
+        return;
+    }
+
+    std::array<uint32_t, indirect_batch_count> batch_capacity{};
+    for (const DrawObject& draw : renderer->opaque_draws) {
+        batch_capacity[indirect_batch_index(&draw, false)]++;
+    }
+    for (const DrawObject& draw : renderer->transparent_draws) {
+        batch_capacity[indirect_batch_index(&draw, true)]++;
+    }
+
+    std::array<uint32_t, indirect_batch_count> batch_first_command{};
+    for (uint32_t batch = 1; batch < indirect_batch_count; batch++) {
+        batch_first_command[batch] = batch_first_command[batch - 1] + batch_capacity[batch - 1];
+    }
+
+    // opaque draw ids come first, matching the batch order
+    std::vector<GpuDrawData> gpu_draws;
+    gpu_draws.reserve(draw_count);
+    std::vector<VkDrawIndexedIndirectCommand> shadow_commands(renderer->opaque_draws.size());
+    std::array<uint32_t, indirect_batch_count> shadow_batch_fill{};
+
+    const auto add_gpu_draw = [&](const DrawObject* draw, const CullBounds* cull_bounds, uint32_t cull_index, bool transparent) {
+        GpuDrawData gpu_draw{};
+        gpu_draw.transform           = draw->transform;
+        gpu_draw.material_index      = draw->material_index;
+        gpu_draw.first_index         = draw->geometry.first_index;
+        gpu_draw.index_count         = draw->geometry.index_count;
+        gpu_draw.vertex_offset       = draw->geometry.vertex_offset;
+        gpu_draw.batch               = indirect_batch_index(draw, transparent);
+        gpu_draw.batch_first_command = batch_first_command[gpu_draw.batch];
+        gpu_draw.bounds_center = {cull_bounds->center_x[cull_index], cull_bounds->center_y[cull_index], cull_bounds->center_z[cull_index]};
+        gpu_draw.bounds_half_extent = {cull_bounds->half_extent_x[cull_index], cull_bounds->half_extent_y[cull_index],
+                                       cull_bounds->half_extent_z[cull_index]};
+        gpu_draw.position_base      = draw->geometry.position_base;
+        gpu_draw.position_scale     = draw->geometry.position_scale;
+        gpu_draw.vertex_format      = static_cast<uint32_t>(draw->geometry.vertex_format);
+
+        if (!transparent) {
+            VkDrawIndexedIndirectCommand* shadow_command =
+                &shadow_commands[batch_first_command[gpu_draw.batch] + shadow_batch_fill[gpu_draw.batch]++];
+            shadow_command->indexCount    = draw->geometry.index_count;
+            shadow_command->instanceCount = 1;
+            shadow_command->firstIndex    = draw->geometry.first_index;
+            shadow_command->vertexOffset  = draw->geometry.vertex_offset;
+            shadow_command->firstInstance = gpu_draws.size();
+        }
+
+        gpu_draws.push_back(gpu_draw);
+    };
+
+    for (uint32_t i = 0; i < renderer->opaque_draws.size(); i++) {
+        add_gpu_draw(&renderer->opaque_draws[i], &renderer->opaque_cull_bounds, i, false);
+    }
+    for (uint32_t i = 0; i < renderer->transparent_draws.size(); i++) {
+        add_gpu_draw(&renderer->transparent_draws[i], &renderer->transparent_cull_bounds, i, true);
+    }
+
+    const VkDeviceSize draw_data_size       = gpu_draws.size() * sizeof(GpuDrawData);
+    const VkDeviceSize shadow_commands_size = shadow_commands.size() * sizeof(VkDrawIndexedIndirectCommand);
+
+    // frames in flight may still read the buffers that get replaced
+    if (renderer->gpu_draw_buffer.buffer != nullptr) {
+        renderer_retire_buffer(renderer, &renderer->gpu_draw_buffer);
+    }
+    if (renderer->shadow_indirect_command_buffer.buffer != nullptr) {
+        renderer_retire_buffer(renderer, &renderer->shadow_indirect_command_buffer);
+        renderer->shadow_indirect_command_buffer = {};
+    }
+
+    renderer->gpu_draw_buffer = allocated_buffer_create(
+        renderer->allocator, renderer->vk_context.device, draw_data_size,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+        VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE);
+
+    if (shadow_commands_size > 0) {
+        renderer->shadow_indirect_command_buffer =
+            allocated_buffer_create(renderer->allocator, renderer->vk_context.device, shadow_commands_size,
+                                    VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE);
+    }
+
+    upload_manager_upload_buffer(&renderer->upload_manager, renderer->gpu_draw_buffer.buffer, 0, std::as_bytes(std::span(gpu_draws)));
+    if (shadow_commands_size > 0) {
+        upload_manager_upload_buffer(&renderer->upload_manager, renderer->shadow_indirect_command_buffer.buffer, 0,
+                                     std::as_bytes(std::span(shadow_commands)));
+    }
+
+    // the cull shader writes at most every draw. the occlusion pass gets its own commands since the depth pre-pass is
+    // still reading the frustum culled ones
+    for (uint32_t i = 0; i < renderer->frames.size(); i++) {
+        if (i < renderer->indirect_command_buffers.size()) {
+            renderer_retire_buffer(renderer, &renderer->indirect_command_buffers[i]);
+            renderer_retire_buffer(renderer, &renderer->occlusion_command_buffers[i]);
+        } else {
+            renderer->indirect_command_buffers.emplace_back();
+            renderer->occlusion_command_buffers.emplace_back();
+        }
+        renderer->indirect_command_buffers[i] = allocated_buffer_create(
+            renderer->allocator, renderer->vk_context.device, draw_count * sizeof(VkDrawIndexedIndirectCommand),
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+            VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE);
+        renderer->occlusion_command_buffers[i] = allocated_buffer_create(
+            renderer->allocator, renderer->vk_context.device, draw_count * sizeof(VkDrawIndexedIndirectCommand),
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+            VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE);
+    }
+
+    renderer->gpu_draw_count               = draw_count;
+    renderer->indirect_batch_capacity      = batch_capacity;
+    renderer->indirect_batch_first_command = batch_first_command;
+}
+
+// nothing may still use the asset's images and samplers
+static void destroy_gltf_asset(const Renderer* renderer, vk_gltf::GltfAsset* asset) {
+    for (const vk_gltf::GltfImage& gltf_image : asset->images) {
+        vkDestroyImageView(renderer->vk_context.device, gltf_image.image_view, nullptr);
+        vmaDestroyImage(renderer->allocator, gltf_image.image, gltf_image.allocation);
+    }
+    for (VkSampler sampler : asset->samplers) {
+        vkDestroySampler(renderer->vk_context.device, sampler, nullptr);
+    }
+    *asset = {};
+}
+
+// slots each asset texture takes in the texture table. streaming writes a texture's new image into the slot its
+// materials don't use and moves them over, so frames in flight keep sampling the old one
+static constexpr uint32_t texture_slot_stride = 2;
+
+// streamed images start out with their mips up to this size
+static constexpr uint32_t texture_stream_tail_size = 64;
+
+// bytes of mips streaming uploads per frame. one swap always goes through, however large
+static constexpr VkDeviceSize texture_stream_frame_budget = 32 << 20;
+
+static std::array<vk_gltf::TextureInfo*, 8> material_texture_infos(Material* material) {
+    return {&material->base_color_texture, &material->metallic_roughness_texture, &material->normal_texture, &material->occlusion_texture,
+            &material->emissive_texture, &material->clearcoat_texture, &material->clearcoat_roughness_texture, &material->clearcoat_normal_texture};
+}
+
+// finest mip that fits in a single image upload
+static uint32_t texture_source_finest_mip(const TextureSource* source) {
+    uint32_t mip = 0;
+    while (mip + 1 < source->mips.size() && source->mips[mip].size > upload_staging_capacity / 4) {
+        mip++;
+    }
+    return mip;
+}
+
+static uint32_t texture_source_tail_mip(const TextureSource* source) {
+    uint32_t mip = texture_source_finest_mip(source);
+    while (mip + 1 < source->mips.size() && std::max(source->mips[mip].extent.width, source->mips[mip].extent.height) > texture_stream_tail_size) {
+        mip++;
+    }
+    return mip;
+}
+
+// creates an image holding the source's mips from first_mip down and uploads them. frames sample it once they've
+// acquired the uploads
+static AllocatedImage streamed_image_create(Renderer* renderer, const TextureSource* source, uint32_t first_mip) {
+    const uint32_t   mip_count = source->mips.size() - first_mip;
+    const VkExtent3D extent    = source->mips[first_mip].extent;
+
+    const VkImageCreateInfo image_ci =
+        vk_lib::image_create_info(source->format, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, extent, mip_count);
+    VmaAllocationCreateInfo allocation_ci{};
+    allocation_ci.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+
+    AllocatedImage image{};
+    VK_CHECK(vmaCreateImage(renderer->allocator, &image_ci, &allocation_ci, &image.image, &image.allocation, &image.allocation_info));
+    image.image_format = source->format;
+    image.extent       = extent;
+
+    VkImageSubresourceRange subresource_range = vk_lib::image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT);
+    subresource_range.levelCount              = mip_count;
+
+    const VkImageViewCreateInfo image_view_ci = vk_lib::image_view_create_info(source->format, image.image, &subresource_range);
+    VK_CHECK(vkCreateImageView(renderer->vk_context.device, &image_view_ci, nullptr, &image.image_view));
+
+    for (uint32_t mip = first_mip; mip < source->mips.size(); mip++) {
+        upload_manager_upload_image(&renderer->upload_manager, image.image, mip - first_mip, source->mips[mip].extent,
+                                    texture_source_mip_data(source, mip), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
     }
+    image.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    return image;
+}
+
+static void streamed_image_destroy(const Renderer* renderer, AllocatedImage* image) {
+    vkDestroyImageView(renderer->vk_context.device, image->image_view, nullptr);
+    vmaDestroyImage(renderer->allocator, image->image, image->allocation);
+    *image = {};
+}
+
+// destroys the images streaming replaced once no frame in flight can sample them, and points their old slots back at
+// the default texture
+static void streamed_images_retire(Renderer* renderer) {
+    std::erase_if(renderer->retiring_streamed_images, [&](RetiringStreamedImage& retiring) {
+        if (retiring.retire_frame > renderer->curr_frame) {
+            return false;
+        }
+        for (uint32_t slot : retiring.slots) {
+            texture_table_clear(renderer, {slot, 1});
+        }
+        streamed_image_destroy(renderer, &retiring.image);
+        return true;
+    });
+}
+
+// replaces the image with one holding the source's mips from first_mip down. the textures using it move to their other
+// slot in this frame's material updates
+static void renderer_swap_streamed_image(Renderer* renderer, AssetHandle handle, uint32_t image_index, uint32_t first_mip) {
+    RendererAsset* asset          = &renderer->assets[handle];
+    StreamedImage* streamed_image = &asset->streamed_images[image_index];
+    AllocatedImage image          = streamed_image_create(renderer, &streamed_image->source, first_mip);
+
+    RetiringStreamedImage retiring{};
+    retiring.image        = streamed_image->image;
+    retiring.retire_frame = renderer->curr_frame + renderer->frames.size();
+
+    for (uint32_t texture = 0; texture < asset->gltf_asset.textures.size(); texture++) {
+        const vk_gltf::GltfTexture* gltf_texture = &asset->gltf_asset.textures[texture];
+        if (gltf_texture->image_index != image_index) {
+            continue;
+        }
+
+        const uint32_t first_slot = asset->texture_range.offset + texture_slot_stride * texture;
+        const uint32_t old_slot   = asset->texture_slots[texture];
+        const uint32_t new_slot   = old_slot == first_slot ? first_slot + 1 : first_slot;
+
+        VkSampler sampler = renderer->default_sampler;
+        if (gltf_texture->sampler_index.has_value()) {
+            sampler = asset->gltf_asset.samplers[gltf_texture->sampler_index.value()];
+        }
+        const std::array image_infos = {vk_lib::descriptor_image_info(image.image_view, image.layout, sampler)};
+        texture_table_write(renderer, new_slot, image_infos);
+
+        for (uint32_t material_index = asset->material_range.offset; material_index < asset->material_range.offset + asset->material_range.size;
+             material_index++) {
+            Material material = renderer->material_store.materials[material_index];
+            bool     remapped = false;
+            for (vk_gltf::TextureInfo* texture_info : material_texture_infos(&material)) {
+                if (texture_info->tex_index == old_slot) {
+                    texture_info->tex_index = new_slot;
+                    remapped                = true;
+                }
+            }
+            if (remapped) {
+                renderer_update_material(renderer, material_index, &material);
+            }
+        }
+
+        asset->texture_slots[texture] = new_slot;
+        retiring.slots.push_back(old_slot);
+    }
+    renderer->retiring_streamed_images.push_back(std::move(retiring));
+
+    asset->memory_size           = asset->memory_size - streamed_image->image.allocation_info.size + image.allocation_info.size;
+    streamed_image->image        = image;
+    streamed_image->resident_mip = first_mip;
+    streamed_image->swap_frame   = renderer->curr_frame;
+}
+
+// mip the image should hold. it only drops its finest mip once no draw needs anything within one level of it, so an
+// image right at the edge doesn't keep swapping back and forth
+static uint32_t streamed_image_target_mip(const StreamedImage* streamed_image) {
+    const uint32_t wanted_mip = std::max(streamed_image->wanted_mip, texture_source_finest_mip(&streamed_image->source));
+    if (wanted_mip == streamed_image->resident_mip + 1) {
+        return streamed_image->resident_mip;
+    }
+    return wanted_mip;
+}
+
+// every streamed image wants the mip that matches how large the closest draw sampling it is on screen. images furthest
+// from the mip they want swap first until the frame's upload budget is spent
+static void renderer_update_texture_streaming(Renderer* renderer) {
+    if (!renderer->options.stream_textures) {
+        return;
+    }
+    TRACE_ZONE("renderer_update_texture_streaming");
+
+    for (RendererAsset& asset : renderer->assets) {
+        for (StreamedImage& streamed_image : asset.streamed_images) {
+            streamed_image.wanted_mip = streamed_image.source.mips.empty() ? 0 : streamed_image.source.mips.size() - 1;
+        }
+    }
+
+    // a sphere around the draw's box, measured in pixels as if it faced the camera from its closest point
+    const float pixels_per_unit = std::abs(global::camera.proj[1][1]) * 0.5f * renderer->render_extent.height;
+
+    const auto request_mips = [&](std::span<const DrawObject> draws, const CullBounds* cull_bounds) {
+        for (uint32_t i = 0; i < draws.size(); i++) {
+            RendererAsset* asset = &renderer->assets[draws[i].asset];
+            if (asset->streamed_images.empty()) {
+                continue;
+            }
+
+            const glm::vec3 center(cull_bounds->center_x[i], cull_bounds->center_y[i], cull_bounds->center_z[i]);
+            const glm::vec3 half_extent(cull_bounds->half_extent_x[i], cull_bounds->half_extent_y[i], cull_bounds->half_extent_z[i]);
+            const float     radius      = glm::length(half_extent);
+            const float     distance    = std::max(glm::length(center - global::camera.eye_pos) - radius, camera_near_plane);
+            const float     screen_size = std::max(2.f * radius / distance * pixels_per_unit, 1.f);
+
+            Material* material = &renderer->material_store.materials[draws[i].material_index];
+            for (const vk_gltf::TextureInfo* texture_info : material_texture_infos(material)) {
+                const uint32_t slot = texture_info->tex_index;
+                if (slot < asset->texture_range.offset || slot >= asset->texture_range.offset + asset->texture_range.size) {
+                    continue;
+                }
+                const vk_gltf::GltfTexture* gltf_texture = &asset->gltf_asset.textures[(slot - asset->texture_range.offset) / texture_slot_stride];
+                if (!gltf_texture->image_index.has_value()) {
+                    continue;
+                }
+                StreamedImage* streamed_image = &asset->streamed_images[gltf_texture->image_index.value()];
+                if (streamed_image->source.mips.empty()) {
+                    continue;
+                }
+
+                const VkExtent3D extent     = streamed_image->source.mips[0].extent;
+                const float      mip        = std::floor(std::log2(std::max(extent.width, extent.height) / screen_size));
+                const float      last_mip   = streamed_image->source.mips.size() - 1;
+                const uint32_t   wanted_mip = std::clamp(mip, 0.f, last_mip);
+                streamed_image->wanted_mip  = std::min(streamed_image->wanted_mip, wanted_mip);
+            }
+        }
+    };
+    request_mips(renderer->opaque_draws, &renderer->opaque_cull_bounds);
+    request_mips(renderer->transparent_draws, &renderer->transparent_cull_bounds);
+
+    // an image's textures can only move to their other slot once the frames that sampled it before the last swap are done
+    std::vector<std::pair<AssetHandle, uint32_t>> swaps;
+    for (AssetHandle handle = 0; handle < renderer->assets.size(); handle++) {
+        const RendererAsset* asset = &renderer->assets[handle];
+        if (asset->residency != AssetResidency::resident) {
+            continue;
+        }
+        for (uint32_t image_index = 0; image_index < asset->streamed_images.size(); image_index++) {
+            const StreamedImage* streamed_image = &asset->streamed_images[image_index];
+            if (streamed_image->source.mips.empty() || renderer->curr_frame < streamed_image->swap_frame + renderer->frames.size()) {
+                continue;
+            }
+            if (streamed_image_target_mip(streamed_image) != streamed_image->resident_mip) {
+                swaps.emplace_back(handle, image_index);
+            }
+        }
+    }
+
+    // images that need finer mips go before those giving them up, the blurriest first
+    std::ranges::sort(swaps, std::greater{}, [&](const std::pair<AssetHandle, uint32_t>& swap) {
+        const StreamedImage* streamed_image = &renderer->assets[swap.first].streamed_images[swap.second];
+        return static_cast<int64_t>(streamed_image->resident_mip) - streamed_image_target_mip(streamed_image);
+    });
+
+    VkDeviceSize uploaded_size = 0;
+    for (const auto& [handle, image_index] : swaps) {
+        const StreamedImage* streamed_image = &renderer->assets[handle].streamed_images[image_index];
+        const uint32_t       target_mip     = streamed_image_target_mip(streamed_image);
+        const VkDeviceSize   upload_size    = streamed_image->source.data.size() - streamed_image->source.mips[target_mip].offset;
+        if (uploaded_size > 0 && uploaded_size + upload_size > texture_stream_frame_budget) {
+            break;
+        }
+        renderer_swap_streamed_image(renderer, handle, image_index, target_mip);
+        uploaded_size += upload_size;
+    }
+}
+
+// adds the draws, materials and textures of an asset the loader finished. its encoded geometry and the images it didn't
+// read back are already on the gpu
+static void renderer_publish_gltf_asset(Renderer* renderer, AssetHandle handle, vk_gltf::GltfAsset&& asset,
+                                        std::vector<TextureSource>&& texture_sources, EncodedGeometry* geometry) {
+    TRACE_ZONE("renderer_publish_gltf_asset");
+    RendererAsset* renderer_asset = &renderer->assets[handle];
+
+    // every mesh's primitives go into the geometry arena once. nodes that instance a mesh share its ranges
+    std::vector<uint32_t> mesh_first_primitive;
+    mesh_first_primitive.reserve(asset.meshes.size());
+    uint32_t primitive_count = 0;
+    for (const vk_gltf::GltfMesh& gltf_mesh : asset.meshes) {
+        mesh_first_primitive.push_back(primitive_count);
+        primitive_count += gltf_mesh.primitives.size();
+    }
+
+    const std::vector<ArenaGeometry> primitive_geometries = renderer_upload_geometry(renderer, geometry);
+
+    // images the loader read back start out with only their smallest mips when streaming. otherwise they get every mip
+    // an upload fits and the host copy isn't needed past that
+    const bool stream_textures = renderer->options.stream_textures;
+    renderer_asset->streamed_images.resize(asset.images.size());
+    for (uint32_t image_index = 0; image_index < asset.images.size(); image_index++) {
+        StreamedImage* streamed_image = &renderer_asset->streamed_images[image_index];
+        streamed_image->source        = std::move(texture_sources[image_index]);
+        if (streamed_image->source.mips.empty()) {
+            continue;
+        }
+        const TextureSource* source  = &streamed_image->source;
+        streamed_image->resident_mip = stream_textures ? texture_source_tail_mip(source) : texture_source_finest_mip(source);
+        streamed_image->wanted_mip   = streamed_image->resident_mip;
+        streamed_image->swap_frame   = renderer->curr_frame;
+        streamed_image->image        = streamed_image_create(renderer, source, streamed_image->resident_mip);
+        if (!stream_textures) {
+            streamed_image->source.data = {};
+        }
+    }
+
+    // add new textures. each one takes two slots and starts out in the first, the second samples the default texture
+    // until streaming moves it there
+    Texture spare_texture{};
+    spare_texture.image   = renderer->default_texture_image;
+    spare_texture.sampler = renderer->default_sampler;
+
+    std::vector<Texture> textures;
+    textures.reserve(asset.textures.size() * texture_slot_stride);
+    for (const vk_gltf::GltfTexture& gltf_texture : asset.textures) {
+        Texture new_texture{};
+
+        // it would be really weird for a gltf_texture to not have an image btw. handle it anyway
+        if (gltf_texture.image_index.has_value() && !renderer_asset->streamed_images[gltf_texture.image_index.value()].source.mips.empty()) {
+            new_texture.image = renderer_asset->streamed_images[gltf_texture.image_index.value()].image;
+        } else if (gltf_texture.image_index.has_value()) {
+            const vk_gltf::GltfImage* gltf_image = &asset.images[gltf_texture.image_index.value()];
+
+            AllocatedImage image{};
+            image.image           = gltf_image->image;
+            image.image_view      = gltf_image->image_view;
+            image.image_format    = gltf_image->image_format;
+            image.extent          = gltf_image->extent;
+            image.allocation      = gltf_image->allocation;
+            image.allocation_info = gltf_image->allocation_info;
+            image.layout          = gltf_image->layout;
+
+            new_texture.image = image;
+        } else {
+            new_texture.image = renderer->default_texture_image;
+        }
+
+        if (gltf_texture.sampler_index.has_value()) {
+            new_texture.sampler = asset.samplers[gltf_texture.sampler_index.value()];
+        } else {
+            new_texture.sampler = renderer->default_sampler;
+        }
+
+        textures.push_back(new_texture);
+        textures.push_back(spare_texture);
+    }
+
+    const uint32_t first_texture  = renderer_add_textures(renderer, textures);
+    renderer_asset->texture_range = {first_texture, static_cast<uint32_t>(textures.size())};
+    renderer_asset->texture_slots.resize(asset.textures.size());
+    for (uint32_t texture = 0; texture < asset.textures.size(); texture++) {
+        renderer_asset->texture_slots[texture] = first_texture + texture_slot_stride * texture;
+    }
+
     // add new materials
     std::vector<Material> materials;
     materials.reserve(asset.materials.size());
+    const auto texture_slot = [&](uint32_t texture) { return first_texture + texture_slot_stride * texture; };
     for (const vk_gltf::GltfMaterial& gltf_material : asset.materials) {
         Material new_material{};
 
-        // I will offset the texture indices by how many textures we already have from other gltf assets
+        // texture indices are local to the asset, point them at the first of their slots in the texture table
         if (gltf_material.normal_texture.has_value()) {
             new_material.normal_texture = gltf_material.normal_texture.value();
-            new_material.normal_texture.tex_index += renderer->texture_count;
+            new_material.normal_texture.tex_index = texture_slot(new_material.normal_texture.tex_index);
         }
         new_material.normal_scale = gltf_material.normal_scale;
 
         if (gltf_material.base_color_texture.has_value()) {
             new_material.base_color_texture = gltf_material.base_color_texture.value();
-            new_material.base_color_texture.tex_index += renderer->texture_count;
+            new_material.base_color_texture.tex_index = texture_slot(new_material.base_color_texture.tex_index);
         }
         new_material.base_color_factors = glm::make_vec4(gltf_material.base_color_factors);
 
         if (gltf_material.metallic_roughness_texture.has_value()) {
             new_material.metallic_roughness_texture = gltf_material.metallic_roughness_texture.value();
-            new_material.metallic_roughness_texture.tex_index += renderer->texture_count;
+            new_material.metallic_roughness_texture.tex_index = texture_slot(new_material.metallic_roughness_texture.tex_index);
         }
         new_material.metallic_factor  = gltf_material.metallic_factor;
         new_material.roughness_factor = gltf_material.roughness_factor;
 
         if (gltf_material.occlusion_texture.has_value()) {
             new_material.occlusion_texture = gltf_material.occlusion_texture.value();
-            new_material.occlusion_texture.tex_index += renderer->texture_count;
+            new_material.occlusion_texture.tex_index = texture_slot(new_material.occlusion_texture.tex_index);
         }
         new_material.occlusion_strength = gltf_material.occlusion_strength;
 
         if (gltf_material.emissive_texture.has_value()) {
             new_material.emissive_texture = gltf_material.emissive_texture.value();
-            new_material.emissive_texture.tex_index += renderer->texture_count;
+            new_material.emissive_texture.tex_index = texture_slot(new_material.emissive_texture.tex_index);
         }
         new_material.emissive_factors = glm::make_vec3(gltf_material.emissive_factors);
 
         // EXTENSIONS
         if (gltf_material.clearcoat_texture.has_value()) {
             new_material.clearcoat_texture = gltf_material.clearcoat_texture.value();
-            new_material.clearcoat_texture.tex_index += renderer->texture_count;
+            new_material.clearcoat_texture.tex_index = texture_slot(new_material.clearcoat_texture.tex_index);
         }
         if (gltf_material.clearcoat_roughness_texture.has_value()) {
             new_material.clearcoat_roughness_texture = gltf_material.clearcoat_roughness_texture.value();
-            new_material.clearcoat_roughness_texture.tex_index += renderer->texture_count;
+            new_material.clearcoat_roughness_texture.tex_index = texture_slot(new_material.clearcoat_roughness_texture.tex_index);
         }
         if (gltf_material.clearcoat_normal_texture.has_value()) {
             new_material.clearcoat_normal_texture = gltf_material.clearcoat_normal_texture.value();
-            new_material.clearcoat_normal_texture.tex_index += renderer->texture_count;
+            new_material.clearcoat_normal_texture.tex_index = texture_slot(new_material.clearcoat_normal_texture.tex_index);
         }
         new_material.clearcoat_factor           = gltf_material.clearcoat_factor;
         new_material.clearcoat_roughness_factor = gltf_material.clearcoat_roughness_factor;
@@ -853,163 +2066,998 @@ void renderer_add_gltf_asset(Renderer* renderer, const char* gltf_path) {
         materials.push_back(new_material);
     }
 
-    renderer_add_materials(renderer, materials);
+    const uint32_t first_material = material_store_allocate(renderer, materials);
+    renderer_asset->material_range = {first_material, static_cast<uint32_t>(materials.size())};
+
+    // add new draw objects
+    TRACE_ZONE_BEGIN("build_draw_objects");
+    const uint32_t first_opaque_draw      = renderer->opaque_draws.size();
+    const uint32_t first_transparent_draw = renderer->transparent_draws.size();
+    for (const vk_gltf::GltfNode& node : asset.nodes) {
+        if (!node.mesh.has_value()) {
+            // only renderer nodes with meshes
+            continue;
+        }
+        const vk_gltf::GltfMesh* gltf_mesh = &asset.meshes[node.mesh.value()];
+        for (uint32_t primitive_index = 0; primitive_index < gltf_mesh->primitives.size(); primitive_index++) {
+            const vk_gltf::GltfPrimitive& gltf_primitive = gltf_mesh->primitives[primitive_index];
+
+            DrawObject new_draw_object{};
+            new_draw_object.transform     = glm::make_mat4(node.world_transform);
+            new_draw_object.geometry      = primitive_geometries[mesh_first_primitive[node.mesh.value()] + primitive_index];
+            new_draw_object.topology      = gltf_primitive.topology;
+            new_draw_object.bounds.origin = glm::make_vec3(gltf_primitive.bounds.origin);
+            new_draw_object.bounds.extent = glm::make_vec3(gltf_primitive.bounds.extent);
+            new_draw_object.asset         = handle;
+
+            if (glm::determinant(new_draw_object.transform) > 0) {
+                new_draw_object.front_face = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+            } else {
+                new_draw_object.front_face = VK_FRONT_FACE_CLOCKWISE;
+            }
+
+            if (gltf_primitive.material.has_value()) {
+                // offset the material index to the asset's range in the material store
+                new_draw_object.material_index = gltf_primitive.material.value() + first_material;
+                new_draw_object.double_sided   = asset.materials[gltf_primitive.material.value()].double_sided;
+
+                if (asset.materials[gltf_primitive.material.value()].alpha_mode == vk_gltf::GltfAlphaMode::opaque) {
+                    renderer->opaque_draws.push_back(new_draw_object);
+                    cull_bounds_add(&renderer->opaque_cull_bounds, new_draw_object.bounds.origin, new_draw_object.bounds.extent,
+                                    new_draw_object.transform);
+                } else {
+                    renderer->transparent_draws.push_back(new_draw_object);
+                    cull_bounds_add(&renderer->transparent_cull_bounds, new_draw_object.bounds.origin, new_draw_object.bounds.extent,
+                                    new_draw_object.transform);
+                }
+            } else {
+                // default material index
+                new_draw_object.material_index = 0;
+                // assume opaque when no material
+                renderer->opaque_draws.push_back(new_draw_object);
+                cull_bounds_add(&renderer->opaque_cull_bounds, new_draw_object.bounds.origin, new_draw_object.bounds.extent, new_draw_object.transform);
+            }
+        }
+    }
+
+    renderer->visible_opaque_draws.reserve(renderer->opaque_draws.size());
+    renderer->visible_transparent_draws.reserve(renderer->transparent_draws.size());
+
+    // one box around every draw the asset added decides when it's in view
+    glm::vec3 bounds_min(std::numeric_limits<float>::max());
+    glm::vec3 bounds_max(std::numeric_limits<float>::lowest());
+    cull_bounds_enclose(&renderer->opaque_cull_bounds, first_opaque_draw, &bounds_min, &bounds_max);
+    cull_bounds_enclose(&renderer->transparent_cull_bounds, first_transparent_draw, &bounds_min, &bounds_max);
+    if (glm::all(glm::lessThanEqual(bounds_min, bounds_max))) {
+        cull_bounds_set(&renderer->asset_cull_bounds, handle, (bounds_min + bounds_max) * 0.5f, (bounds_max - bounds_min) * 0.5f);
+        renderer_asset->has_bounds = true;
+    }
+    TRACE_ZONE_END();
+
+    renderer_sort_shadow_draws(renderer);
+    renderer_update_gpu_draws(renderer);
+
+    // geometry lives in the arena, which keeps its buffer when assets leave, so only images count towards what an eviction
+    // gives back. read back images have no allocation left in the asset
+    renderer_asset->memory_size = 0;
+    for (const vk_gltf::GltfImage& gltf_image : asset.images) {
+        renderer_asset->memory_size += gltf_image.allocation_info.size;
+    }
+    for (const StreamedImage& streamed_image : renderer_asset->streamed_images) {
+        renderer_asset->memory_size += streamed_image.image.allocation_info.size;
+    }
+    renderer_asset->geometries         = primitive_geometries;
+    renderer_asset->gltf_asset         = std::move(asset);
+    renderer_asset->residency          = AssetResidency::resident;
+    renderer_asset->last_visible_frame = renderer->curr_frame;
+}
+
+// frees what released assets held once no frame in flight can read it anymore
+static void retiring_assets_retire(Renderer* renderer) {
+    GeometryArena* arena = &renderer->geometry_arena;
+    std::erase_if(renderer->retiring_assets, [&](RetiringAsset& retiring) {
+        if (retiring.retire_frame > renderer->curr_frame) {
+            return false;
+        }
+        for (const ArenaGeometry& geometry : retiring.geometries) {
+            const uint32_t vertex_stride = vertex_format_stride(geometry.vertex_format);
+            range_allocator_free(&arena->index_ranges, geometry.first_index, geometry.index_count);
+            range_allocator_free(&arena->vertex_ranges, geometry.vertex_offset * vertex_stride, geometry.vertex_count * vertex_stride);
+        }
+        for (AllocatedImage& image : retiring.streamed_images) {
+            streamed_image_destroy(renderer, &image);
+        }
+        destroy_gltf_asset(renderer, &retiring.gltf_asset);
+        return true;
+    });
+}
+
+// drops the assets' draws and hands everything they hold to the frame retirement lists. they keep their path and bounds
+// and end up in residency
+static void renderer_release_assets(Renderer* renderer, std::span<const AssetHandle> handles, AssetResidency residency) {
+    TRACE_ZONE("renderer_release_assets");
+
+    for (AssetHandle handle : handles) {
+        renderer->assets[handle].residency = residency;
+    }
+    const auto is_released = [&](const DrawObject& draw) { return renderer->assets[draw.asset].residency != AssetResidency::resident; };
+    std::erase_if(renderer->opaque_draws, is_released);
+    std::erase_if(renderer->transparent_draws, is_released);
+
+    // the cull bounds are parallel to the draws
+    renderer->opaque_cull_bounds      = {};
+    renderer->transparent_cull_bounds = {};
+    for (const DrawObject& draw : renderer->opaque_draws) {
+        cull_bounds_add(&renderer->opaque_cull_bounds, draw.bounds.origin, draw.bounds.extent, draw.transform);
+    }
+    for (const DrawObject& draw : renderer->transparent_draws) {
+        cull_bounds_add(&renderer->transparent_cull_bounds, draw.bounds.origin, draw.bounds.extent, draw.transform);
+    }
+
+    // frames in flight may still read the geometry, materials and images being freed. images streaming replaced earlier
+    // retire on their own
+    for (AssetHandle handle : handles) {
+        RendererAsset* asset = &renderer->assets[handle];
+
+        RetiringAsset retiring{};
+        retiring.gltf_asset   = std::move(asset->gltf_asset);
+        retiring.geometries   = std::move(asset->geometries);
+        retiring.memory_size  = asset->memory_size;
+        retiring.retire_frame = renderer->curr_frame + renderer->frames.size();
+        for (const StreamedImage& streamed_image : asset->streamed_images) {
+            if (streamed_image.image.image != nullptr) {
+                retiring.streamed_images.push_back(streamed_image.image);
+            }
+        }
+        renderer->retiring_assets.push_back(std::move(retiring));
+
+        renderer_free_materials(renderer, asset->material_range);
+        renderer_free_textures(renderer, asset->texture_range);
+
+        asset->gltf_asset = {};
+        asset->streamed_images.clear();
+        asset->texture_slots.clear();
+        asset->geometries.clear();
+        asset->material_range = {};
+        asset->texture_range  = {};
+        asset->memory_size    = 0;
+    }
+
+    renderer_sort_shadow_draws(renderer);
+    renderer_update_gpu_draws(renderer);
+}
+
+static void renderer_enqueue_asset_load(Renderer* renderer, AssetHandle handle) {
+    RendererAsset* asset = &renderer->assets[handle];
+    asset->residency     = AssetResidency::loading;
+    asset->load          = asset_loader_enqueue(renderer->asset_loader.get(), asset->gltf_path.c_str());
+    asset->load_taken    = false;
+
+    if (asset->load >= renderer->load_assets.size()) {
+        renderer->load_assets.resize(asset->load + 1);
+    }
+    renderer->load_assets[asset->load] = handle;
+}
+
+// assets seen within this many frames are never evicted, so turning the camera back and forth doesn't keep reloading them
+static constexpr uint64_t residency_min_unseen_frames = 240;
+
+// evicts the least recently visible assets while device local memory use is over the budget fraction
+static void renderer_update_residency(Renderer* renderer) {
+    const float budget_fraction = renderer->options.asset_memory_budget_fraction;
+    if (budget_fraction <= 0.f) {
+        return;
+    }
+
+    const VkPhysicalDeviceMemoryProperties* memory_properties;
+    vmaGetMemoryProperties(renderer->allocator, &memory_properties);
+    std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> heap_budgets{};
+    vmaGetHeapBudgets(renderer->allocator, heap_budgets.data());
+
+    VkDeviceSize usage  = 0;
+    VkDeviceSize budget = 0;
+    for (uint32_t heap = 0; heap < memory_properties->memoryHeapCount; heap++) {
+        if (memory_properties->memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            usage += heap_budgets[heap].usage;
+            budget += heap_budgets[heap].budget;
+        }
+    }
+    // assets released in the last frames still hold their memory, but it's already on its way out
+    for (const RetiringAsset& retiring : renderer->retiring_assets) {
+        usage -= std::min(usage, retiring.memory_size);
+    }
+    const VkDeviceSize target_usage = static_cast<VkDeviceSize>(static_cast<double>(budget) * budget_fraction);
+    if (usage <= target_usage) {
+        return;
+    }
+
+    std::vector<AssetHandle> candidates;
+    for (AssetHandle handle = 0; handle < renderer->assets.size(); handle++) {
+        const RendererAsset* asset = &renderer->assets[handle];
+        if (asset->residency == AssetResidency::resident && asset->last_visible_frame + residency_min_unseen_frames < renderer->curr_frame) {
+            candidates.push_back(handle);
+        }
+    }
+    std::ranges::sort(candidates, {}, [&](AssetHandle handle) { return renderer->assets[handle].last_visible_frame; });
+
+    std::vector<AssetHandle> evicted;
+    for (AssetHandle handle : candidates) {
+        if (usage <= target_usage) {
+            break;
+        }
+        evicted.push_back(handle);
+        usage -= std::min(usage, renderer->assets[handle].memory_size);
+    }
+    if (!evicted.empty()) {
+        renderer_release_assets(renderer, evicted, AssetResidency::evicted);
+    }
+}
+
+// marks the assets in view as seen this frame and loads the evicted ones among them again
+static void renderer_update_asset_visibility(Renderer* renderer, const Frustum* frustum) {
+    frustum_cull(&renderer->asset_cull_bounds, frustum, &renderer->visible_assets);
+    for (AssetHandle handle : renderer->visible_assets) {
+        RendererAsset* asset = &renderer->assets[handle];
+        if (!asset->has_bounds) {
+            continue;
+        }
+        asset->last_visible_frame = renderer->curr_frame;
+        if (asset->residency == AssetResidency::evicted) {
+            renderer_enqueue_asset_load(renderer, handle);
+        }
+    }
+}
+
+// runs between frames, so everything an asset adds shows up together in the next one
+static void renderer_publish_loaded_assets(Renderer* renderer) {
+    if (renderer->asset_loader->workers.empty()) {
+        asset_loader_load_queued(renderer->asset_loader.get(), renderer->vk_context.frame_command_pool, renderer->vk_context.graphics_queue);
+    }
+    for (LoadedAsset& loaded : asset_loader_take_loaded(renderer->asset_loader.get())) {
+        const AssetHandle handle = renderer->load_assets[loaded.handle];
+        RendererAsset*    asset  = &renderer->assets[handle];
+        asset->load_taken        = true;
+        if (asset->residency == AssetResidency::unloaded) {
+            // unloaded while it was loading. no frame has seen it
+            destroy_gltf_asset(renderer, &loaded.asset);
+            encoded_geometry_destroy(renderer->allocator, &loaded.geometry);
+            continue;
+        }
+        renderer_publish_gltf_asset(renderer, handle, std::move(loaded.asset), std::move(loaded.texture_sources), &loaded.geometry);
+    }
+}
+
+AssetHandle renderer_load_gltf_asset(Renderer* renderer, const char* gltf_path) {
+    const AssetHandle handle = renderer->assets.size();
+    renderer->assets.push_back({gltf_path});
+    // the box is filled in once the asset is resident
+    cull_bounds_add(&renderer->asset_cull_bounds, glm::vec3(0.f), glm::vec3(0.f), glm::mat4(1.f));
+
+    renderer_enqueue_asset_load(renderer, handle);
+    return handle;
+}
+
+void renderer_unload_gltf_asset(Renderer* renderer, AssetHandle handle) {
+    if (renderer->assets[handle].residency == AssetResidency::resident) {
+        const std::array handles = {handle};
+        renderer_release_assets(renderer, handles, AssetResidency::unloaded);
+    }
+    // a load in progress is thrown away when it's published
+    renderer->assets[handle].residency = AssetResidency::unloaded;
+}
+
+AssetLoadStage renderer_asset_load_stage(const Renderer* renderer, AssetHandle handle) {
+    const RendererAsset* asset = &renderer->assets[handle];
+    if (asset->load_taken) {
+        return AssetLoadStage::published;
+    }
+    return asset_loader_stage(renderer->asset_loader.get(), asset->load);
+}
+
+AssetResidency renderer_asset_residency(const Renderer* renderer, AssetHandle handle) { return renderer->assets[handle].residency; }
+
+AssetLoadProgress renderer_asset_load_progress(const Renderer* renderer) { return asset_loader_progress(renderer->asset_loader.get()); }
+
+void renderer_wait_for_asset_loads(Renderer* renderer) {
+    asset_loader_wait_idle(renderer->asset_loader.get());
+    renderer_publish_loaded_assets(renderer);
+}
+
+// pre-exposes this frame with the average luminance the last frame using this slot read back. it trails the gpu's
+// adaptation by a few frames, which the color correction absorbs since it divides the pre-exposure back out
+static void renderer_update_pre_exposure(Renderer* renderer, uint32_t frame_index) {
+    const AllocatedBuffer* readback_buffer = &renderer->luminance_readback_buffers[frame_index];
+    VK_CHECK(vmaInvalidateAllocation(renderer->allocator, readback_buffer->allocation, 0, sizeof(float)));
+
+    float luminance;
+    memcpy(&luminance, readback_buffer->allocation_info.pMappedData, sizeof(float));
+    if (std::isfinite(luminance) && luminance > 0.f) {
+        renderer->pre_exposure = pre_exposure_from_luminance(luminance);
+    }
+}
+
+static void renderer_update_metering_report(Renderer* renderer, uint32_t frame_index) {
+    if (!renderer->options.exposure_metering_report) {
+        return;
+    }
+
+    const AllocatedBuffer* readback_buffer = &renderer->metering_readback_buffers[frame_index];
+    VK_CHECK(vmaInvalidateAllocation(renderer->allocator, readback_buffer->allocation, 0, 2 * exposure_histogram_bin_count * sizeof(uint32_t)));
+
+    const std::span bins(static_cast<const uint32_t*>(readback_buffer->allocation_info.pMappedData), 2 * exposure_histogram_bin_count);
+    exposure_metering_report_add(&renderer->metering_report, bins.first(exposure_histogram_bin_count), bins.last(exposure_histogram_bin_count));
+
+    const uint32_t log_interval = renderer->options.gpu_profiler_log_interval;
+    if (log_interval != 0 && renderer->metering_report.frame_count == log_interval) {
+        exposure_metering_report_log(&renderer->metering_report, renderer->options.exposure_metering_scale);
+    }
+}
+
+static void renderer_set_main_pass_scene_data(Renderer* renderer, uint32_t frame_index) {
+    SceneData scene_data{};
+    // float aspect_ratio = static_cast<float>(renderer->swapchain_context.extent.width) /
+    // static_cast<float>(renderer->swapchain_context.extent.height); scene_data.proj = glm::perspective(glm::radians(70.f), aspect_ratio, 10000.f,
+    // 0.01f); scene_data.proj[1][1] *= -1;
+
+    scene_data.proj = global::camera.proj;
+
+    scene_data.view = camera_view();
+
+    scene_data.eye_pos = global::camera.eye_pos;
+
+    scene_data.sun_dir = renderer->sun_dir;
+
+    scene_data.cascade_transforms = renderer->cascade_transforms;
+
+    scene_data.cascade_splits = renderer->cascade_splits;
+
+    scene_data.cascade_count = renderer->shadow_cascade_count;
+
+    scene_data.pre_exposure = renderer->pre_exposure;
+
+    VK_CHECK(
+        vmaCopyMemoryToAllocation(renderer->allocator, &scene_data, renderer->main_scene_data_buffers[frame_index].allocation, 0, sizeof(SceneData)));
+
+    VkDescriptorBufferInfo buffer_info = vk_lib::descriptor_buffer_info(renderer->main_scene_data_buffers[frame_index].buffer);
+
+    // the material store may have grown since this frame's set was last used
+    VkDescriptorBufferInfo materials_buffer_info = vk_lib::descriptor_buffer_info(renderer->material_store.buffer.buffer);
+
+    std::array descriptor_writes = {
+        vk_lib::write_descriptor_set(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, renderer->scene_descriptor_sets[frame_index], nullptr, &buffer_info),
+        vk_lib::write_descriptor_set(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, renderer->scene_descriptor_sets[frame_index], nullptr,
+                                     &materials_buffer_info),
+    };
+    vkUpdateDescriptorSets(renderer->vk_context.device, descriptor_writes.size(), descriptor_writes.data(), 0, nullptr);
+}
+
+// weight of the logarithmic split scheme against the uniform one when placing cascade splits
+static constexpr float shadow_cascade_split_lambda = 0.8f;
+
+// fits each cascade's light space box to a bounding sphere of its slice of the camera frustum. the sphere doesn't change
+// size as the camera rotates and its center is snapped to whole shadow texels, so cascades don't shimmer as the camera moves
+static void renderer_fit_shadow_cascades(Renderer* renderer) {
+    const glm::vec3 light_pos = glm::vec3(2, 4.5, 1) * 5;
+    renderer->sun_dir         = glm::normalize(light_pos);
+
+    // z points towards the light in light space
+    const glm::mat4 light_view = glm::lookAt(glm::vec3(0), -renderer->sun_dir, glm::vec3(0, 1, 0));
+    const glm::mat4 inv_view   = glm::inverse(camera_view());
+
+    const float tan_half_fov_x = 1.f / global::camera.proj[0][0];
+    const float tan_half_fov_y = 1.f / std::abs(global::camera.proj[1][1]);
+
+    // the caster bounds are inverted when there are no casters
+    const bool has_casters  = renderer->shadow_caster_bounds_min.x <= renderer->shadow_caster_bounds_max.x;
+    float      caster_max_z = -std::numeric_limits<float>::max();
+    for (uint32_t corner = 0; has_casters && corner < 8; corner++) {
+        const glm::vec3 world_corner = {corner & 1 ? renderer->shadow_caster_bounds_max.x : renderer->shadow_caster_bounds_min.x,
+                                        corner & 2 ? renderer->shadow_caster_bounds_max.y : renderer->shadow_caster_bounds_min.y,
+                                        corner & 4 ? renderer->shadow_caster_bounds_max.z : renderer->shadow_caster_bounds_min.z};
+        caster_max_z = std::max(caster_max_z, (light_view * glm::vec4(world_corner, 1.f)).z);
+    }
+
+    const uint32_t cascade_count = renderer->shadow_cascade_count;
+    const float    near          = camera_near_plane;
+    const float    far           = std::min(renderer->options.shadow_distance, camera_far_plane);
+    const float    texel_count   = static_cast<float>(renderer->shadow_map_extent.width);
+
+    float split_near = near;
+    for (uint32_t cascade = 0; cascade < cascade_count; cascade++) {
+        const float fraction      = static_cast<float>(cascade + 1) / static_cast<float>(cascade_count);
+        const float log_split     = near * std::pow(far / near, fraction);
+        const float uniform_split = near + (far - near) * fraction;
+        const float split_far     = glm::mix(uniform_split, log_split, shadow_cascade_split_lambda);
+
+        std::array<glm::vec3, 8> slice_corners{};
+        glm::vec3                center{};
+        for (uint32_t corner = 0; corner < 8; corner++) {
+            const float     depth       = corner < 4 ? split_near : split_far;
+            const glm::vec3 view_corner = {(corner & 1 ? 1.f : -1.f) * tan_half_fov_x * depth, (corner & 2 ? 1.f : -1.f) * tan_half_fov_y * depth,
+                                           -depth};
+            slice_corners[corner] = glm::vec3(inv_view * glm::vec4(view_corner, 1.f));
+            center += slice_corners[corner] / 8.f;
+        }
+
+        float radius = 0;
+        for (const glm::vec3& corner : slice_corners) {
+            radius = std::max(radius, glm::distance(corner, center));
+        }
+        radius = std::ceil(radius * 16.f) / 16.f;
+
+        const float texel_size   = 2.f * radius / texel_count;
+        glm::vec3   light_center = glm::vec3(light_view * glm::vec4(center, 1.f));
+        light_center.x           = std::floor(light_center.x / texel_size) * texel_size;
+        light_center.y           = std::floor(light_center.y / texel_size) * texel_size;
+
+        // the near plane reaches back to every caster between the light and the cascade
+        const float     near_z     = std::max(light_center.z + radius, caster_max_z);
+        const float     far_z      = light_center.z - radius;
+        const glm::mat4 light_proj = glm::ortho(light_center.x - radius, light_center.x + radius, light_center.y - radius, light_center.y + radius,
+                                                -near_z, -far_z);
+
+        renderer->cascade_transforms[cascade] = light_proj * light_view;
+        renderer->cascade_splits[cascade]     = split_far;
+
+        // the camera projection clipped to this slice, with standard depth
+        glm::mat4 slice_proj = global::camera.proj;
+        slice_proj[2][2]     = split_far / (split_near - split_far);
+        slice_proj[3][2]     = -(split_far * split_near) / (split_far - split_near);
+
+        const Frustum cascade_frustum = frustum_from_view_proj(renderer->cascade_transforms[cascade]);
+        const Frustum slice_frustum   = frustum_from_view_proj(slice_proj * camera_view());
+        const Frustum caster_frustum  = shadow_caster_frustum(&slice_frustum, -renderer->sun_dir);
+
+        std::array<glm::vec4, 12>* caster_planes = &renderer->cascade_caster_planes[cascade];
+        std::copy(cascade_frustum.planes.begin(), cascade_frustum.planes.end(), caster_planes->begin());
+        std::copy(caster_frustum.planes.begin(), caster_frustum.planes.end(), caster_planes->begin() + cascade_frustum.planes.size());
+
+        split_near = split_far;
+    }
+}
+
+// splits the casters between the cascades. each cascade keeps shadow_draw_order's raster state grouping
+static void renderer_cull_shadow_casters(Renderer* renderer) {
+    TRACE_ZONE("cull_shadow_casters");
+
+    renderer->shadow_caster_cascade_masks.assign(renderer->opaque_draws.size(), 0);
+    for (uint32_t cascade = 0; cascade < renderer->shadow_cascade_count; cascade++) {
+        planes_cull(&renderer->opaque_cull_bounds, renderer->cascade_caster_planes[cascade], &renderer->shadow_visible_casters);
+        for (uint32_t draw_index : renderer->shadow_visible_casters) {
+            renderer->shadow_caster_cascade_masks[draw_index] |= 1 << cascade;
+        }
+    }
+
+    for (std::vector<uint32_t>& cascade_draws : renderer->shadow_cascade_draws) {
+        cascade_draws.clear();
+    }
+    for (uint32_t draw_index : renderer->shadow_draw_order) {
+        const uint8_t cascade_mask = renderer->shadow_caster_cascade_masks[draw_index];
+        for (uint32_t cascade = 0; cascade < renderer->shadow_cascade_count; cascade++) {
+            if (cascade_mask & (1 << cascade)) {
+                renderer->shadow_cascade_draws[cascade].push_back(draw_index);
+            }
+        }
+    }
+}
+
+// returns whether the cached shadow map has to be re-rendered this frame. the shadow pass scene data is only uploaded then
+static bool renderer_set_shadow_pass_scene_data(Renderer* renderer, uint32_t frame_index) {
+    renderer_fit_shadow_cascades(renderer);
+
+    // the gpu driven path draws every caster, so only the cpu path depends on the camera slices
+    const bool casters_unchanged = renderer->gpu_driven || renderer->cascade_caster_planes == renderer->shadow_map_cascade_caster_planes;
+    if (!renderer->shadow_map_dirty && renderer->cascade_transforms == renderer->shadow_map_cascade_transforms && casters_unchanged) {
+        return false;
+    }
+
+    for (uint32_t cascade = 0; cascade < renderer->shadow_cascade_count; cascade++) {
+        const uint32_t shadow_scene_index = frame_index * renderer->shadow_cascade_count + cascade;
+
+        // the shadow vertex shaders only use proj * view
+        SceneData scene_data{};
+        scene_data.view    = glm::mat4(1.f);
+        scene_data.proj    = renderer->cascade_transforms[cascade];
+        scene_data.sun_dir = renderer->sun_dir;
+
+        VK_CHECK(vmaCopyMemoryToAllocation(renderer->allocator, &scene_data, renderer->shadow_scene_data_buffers[shadow_scene_index].allocation, 0,
+                                           sizeof(SceneData)));
+
+        VkDescriptorBufferInfo buffer_info = vk_lib::descriptor_buffer_info(renderer->shadow_scene_data_buffers[shadow_scene_index].buffer);
+
+        VkWriteDescriptorSet descriptor_write = vk_lib::write_descriptor_set(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                                                                             renderer->shadow_descriptor_sets[shadow_scene_index], nullptr,
+                                                                             &buffer_info);
+        vkUpdateDescriptorSets(renderer->vk_context.device, 1, &descriptor_write, 0, nullptr);
+    }
+    return true;
+}
+
+static void update_compute_descriptors(Renderer* renderer) {
+    // update exposure histogram descriptor
+    VkContext* vk_ctx = &renderer->vk_context;
+
+    // exposure histogram pipeline
+    VkDescriptorImageInfo luminance_descriptor_image_info =
+        vk_lib::descriptor_image_info(renderer->resolve_color_image.image_view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, renderer->default_sampler);
+    VkWriteDescriptorSet luminance_image_build_histogram_write = vk_lib::write_descriptor_set(
+        0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, renderer->build_histogram_descriptor_set, &luminance_descriptor_image_info);
+    vkUpdateDescriptorSets(vk_ctx->device, 1, &luminance_image_build_histogram_write, 0, nullptr);
+
+    // color correct pipeline. the output image is written per frame once the swapchain image is known
+    for (VkDescriptorSet color_correct_descriptor_set : renderer->color_correct_descriptor_sets) {
+        VkWriteDescriptorSet hdr_image_color_correct_write = vk_lib::write_descriptor_set(
+            0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, color_correct_descriptor_set, &luminance_descriptor_image_info);
+        vkUpdateDescriptorSets(vk_ctx->device, 1, &hdr_image_color_correct_write, 0, nullptr);
+    }
+
+    // hi-z build. level 0 resolves the msaa depth buffer, every other level reduces the one above it
+    for (uint32_t mip = 0; mip < renderer->hiz_mip_count; mip++) {
+        VkDescriptorImageInfo hiz_src_image_info =
+            mip == 0 ? vk_lib::descriptor_image_info(renderer->depth_image.image_view, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL, renderer->hiz_sampler)
+                     : vk_lib::descriptor_image_info(renderer->hiz_mip_views[mip - 1], VK_IMAGE_LAYOUT_GENERAL, renderer->hiz_sampler);
+        VkDescriptorImageInfo hiz_dst_image_info = vk_lib::descriptor_image_info(renderer->hiz_mip_views[mip], VK_IMAGE_LAYOUT_GENERAL);
+
+        std::array hiz_writes = {
+            vk_lib::write_descriptor_set(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, renderer->hiz_descriptor_sets[mip], &hiz_src_image_info),
+            vk_lib::write_descriptor_set(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, renderer->hiz_descriptor_sets[mip], &hiz_dst_image_info),
+        };
+        vkUpdateDescriptorSets(vk_ctx->device, hiz_writes.size(), hiz_writes.data(), 0, nullptr);
+    }
+
+    // occlusion cull pipeline
+    VkDescriptorImageInfo hiz_pyramid_image_info =
+        vk_lib::descriptor_image_info(renderer->hiz_image.image_view, VK_IMAGE_LAYOUT_GENERAL, renderer->hiz_sampler);
+    VkWriteDescriptorSet hiz_pyramid_write =
+        vk_lib::write_descriptor_set(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, renderer->occlusion_cull_descriptor_set, &hiz_pyramid_image_info);
+    vkUpdateDescriptorSets(vk_ctx->device, 1, &hiz_pyramid_write, 0, nullptr);
+}
+
+static void renderer_resize_screen(Renderer* renderer) {
+    SwapchainContext* swapchain_ctx = &renderer->swapchain_context;
+    VkContext*        vk_ctx        = &renderer->vk_context;
+    vk_context_wait_idle(vk_ctx);
+    swapchain_context_recreate(swapchain_ctx, vk_ctx->physical_device, vk_ctx->device, vk_ctx->surface, renderer->window.glfw_window,
+                               renderer_queue_families(vk_ctx));
+    renderer->render_extent = swapchain_ctx->extent;
+    destroy_render_resources(renderer);
+    create_render_resources(renderer);
+
+    update_compute_descriptors(renderer);
+
+    float aspect_ratio = static_cast<float>(renderer->render_extent.width) / static_cast<float>(renderer->render_extent.height);
+    set_camera_proj(glm::radians(70.f), aspect_ratio);
+}
+
+// frustum culls every gpu draw into this frame's indirect commands. with occlusion_cull set it also tests against the hi-z
+// pyramid and writes the occlusion commands instead, so the depth pre-pass can keep using the frustum culled ones
+static void renderer_record_draw_cull(Renderer* renderer, VkCommandBuffer command_buffer, uint32_t frame_index, const Frustum* frustum,
+                                      bool occlusion_cull) {
+    if (renderer->gpu_draw_count == 0) {
+        return;
+    }
+
+    const AllocatedBuffer* command_buffer_data =
+        occlusion_cull ? &renderer->occlusion_command_buffers[frame_index] : &renderer->indirect_command_buffers[frame_index];
+    const AllocatedBuffer* count_buffer =
+        occlusion_cull ? &renderer->occlusion_count_buffers[frame_index] : &renderer->indirect_count_buffers[frame_index];
+    const AllocatedBuffer* cull_data_buffer = &renderer->cull_data_buffers[frame_index];
+    const GpuPass          profiler_pass    = occlusion_cull ? GpuPass::occlusion_cull : GpuPass::draw_cull;
 
-    // add new textures
-    std::vector<Texture> textures;
-    textures.reserve(asset.textures.size());
-    for (const vk_gltf::GltfTexture& gltf_texture : asset.textures) {
-        Texture new_texture{};
+    // both cull passes in a frame read the same camera, so rewriting it before the first dispatch ran is harmless
+    GpuCullData cull_data{};
+    cull_data.frustum_planes = frustum->planes;
+    cull_data.view_proj      = global::camera.proj * camera_view();
+    cull_data.hiz_extent     = glm::vec2(renderer->hiz_image.extent.width, renderer->hiz_image.extent.height);
+    cull_data.hiz_mip_count  = renderer->hiz_mip_count;
 
-        // it would be really weird for a gltf_texture to not have an image btw. handle it anyway
-        if (gltf_texture.image_index.has_value()) {
-            const vk_gltf::GltfImage* gltf_image = &asset.images[gltf_texture.image_index.value()];
+    VK_CHECK(vmaCopyMemoryToAllocation(renderer->allocator, &cull_data, cull_data_buffer->allocation, 0, sizeof(GpuCullData)));
 
-            AllocatedImage image{};
-            image.image           = gltf_image->image;
-            image.image_view      = gltf_image->image_view;
-            image.image_format    = gltf_image->image_format;
-            image.extent          = gltf_image->extent;
-            image.allocation      = gltf_image->allocation;
-            image.allocation_info = gltf_image->allocation_info;
-            image.layout          = gltf_image->layout;
+    gpu_profiler_begin_pass(&renderer->gpu_profiler, command_buffer, frame_index, profiler_pass);
 
-            new_texture.image = image;
-        } else {
-            new_texture.image = renderer->default_texture_image;
-        }
+    vkCmdFillBuffer(command_buffer, count_buffer->buffer, 0, VK_WHOLE_SIZE, 0);
 
-        if (gltf_texture.sampler_index.has_value()) {
-            new_texture.sampler = asset.samplers[gltf_texture.sampler_index.value()];
-        } else {
-            new_texture.sampler = renderer->default_sampler;
-        }
+    const VkBufferMemoryBarrier2 count_reset_buffer_memory_barrier =
+        vk_lib::buffer_memory_barrier_2(count_buffer->buffer, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                                        VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT);
+    const VkDependencyInfo count_reset_dependency_info = vk_lib::dependency_info(nullptr, &count_reset_buffer_memory_barrier, nullptr);
+    vkCmdPipelineBarrier2(command_buffer, &count_reset_dependency_info);
 
-        textures.push_back(new_texture);
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, renderer->cull_draws_compute_pipeline.pipeline);
+
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, renderer->cull_draws_compute_pipeline.pipeline_layout, 0, 1,
+                            &renderer->occlusion_cull_descriptor_set, 0, nullptr);
+
+    CullDrawsPushConstants push_constants{};
+    push_constants.draw_buf_address      = renderer->gpu_draw_buffer.address;
+    push_constants.command_buf_address   = command_buffer_data->address;
+    push_constants.count_buf_address     = count_buffer->address;
+    push_constants.cull_data_buf_address = cull_data_buffer->address;
+    push_constants.draw_count            = renderer->gpu_draw_count;
+    push_constants.occlusion_cull        = occlusion_cull;
+
+    vkCmdPushConstants(command_buffer, renderer->cull_draws_compute_pipeline.pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                       sizeof(CullDrawsPushConstants), &push_constants);
+
+    vkCmdDispatch(command_buffer, (renderer->gpu_draw_count + 63) / 64, 1, 1);
+
+    const VkBufferMemoryBarrier2 commands_read_buffer_memory_barrier =
+        vk_lib::buffer_memory_barrier_2(command_buffer_data->buffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT,
+                                        VK_ACCESS_2_SHADER_WRITE_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT);
+    const VkBufferMemoryBarrier2 count_read_buffer_memory_barrier =
+        vk_lib::buffer_memory_barrier_2(count_buffer->buffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT,
+                                        VK_ACCESS_2_SHADER_WRITE_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT);
+
+    std::array             indirect_read_barriers         = {commands_read_buffer_memory_barrier, count_read_buffer_memory_barrier};
+    const VkDependencyInfo indirect_read_dependency_info = vk_lib::dependency_info_batch({}, indirect_read_barriers, {});
+    vkCmdPipelineBarrier2(command_buffer, &indirect_read_dependency_info);
+
+    gpu_profiler_end_pass(&renderer->gpu_profiler, command_buffer, frame_index, profiler_pass);
+}
+
+// min depth pyramid of the depth pre-pass. leaves the depth image in DEPTH_READ_ONLY_OPTIMAL and every hi-z mip readable
+// by the cull shader
+static void renderer_record_hiz_build(Renderer* renderer, VkCommandBuffer command_buffer, uint32_t frame_index) {
+    gpu_profiler_begin_pass(&renderer->gpu_profiler, command_buffer, frame_index, GpuPass::hiz_build);
+
+    const VkImageSubresourceRange depth_subresource_range = vk_lib::image_subresource_range(VK_IMAGE_ASPECT_DEPTH_BIT);
+    VkImageSubresourceRange       hiz_subresource_range   = vk_lib::image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT);
+    hiz_subresource_range.levelCount                      = renderer->hiz_mip_count;
+
+    const VkImageMemoryBarrier2 depth_read_image_memory_barrier = vk_lib::image_memory_barrier_2(
+        renderer->depth_image.image, depth_subresource_range, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL,
+        VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+
+    // last frame's occlusion cull may still be sampling the old pyramid
+    const VkImageMemoryBarrier2 hiz_write_image_memory_barrier = vk_lib::image_memory_barrier_2(
+        renderer->hiz_image.image, hiz_subresource_range, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_NONE, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+
+    std::array             hiz_begin_barriers        = {depth_read_image_memory_barrier, hiz_write_image_memory_barrier};
+    const VkDependencyInfo hiz_begin_dependency_info = vk_lib::dependency_info_batch(hiz_begin_barriers, {}, {});
+    vkCmdPipelineBarrier2(command_buffer, &hiz_begin_dependency_info);
+
+    HizPushConstants push_constants{};
+    push_constants.src_extent = renderer->render_extent;
+    push_constants.dst_extent = vk_lib::extent_2d(renderer->hiz_image.extent.width, renderer->hiz_image.extent.height);
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, renderer->resolve_hiz_compute_pipeline.pipeline);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, renderer->resolve_hiz_compute_pipeline.pipeline_layout, 0, 1,
+                            &renderer->hiz_descriptor_sets[0], 0, nullptr);
+    vkCmdPushConstants(command_buffer, renderer->resolve_hiz_compute_pipeline.pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                       sizeof(HizPushConstants), &push_constants);
+    vkCmdDispatch(command_buffer, (push_constants.dst_extent.width + 7) / 8, (push_constants.dst_extent.height + 7) / 8, 1);
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, renderer->downsample_hiz_compute_pipeline.pipeline);
+
+    for (uint32_t mip = 1; mip < renderer->hiz_mip_count; mip++) {
+        VkImageSubresourceRange src_mip_subresource_range = vk_lib::image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT);
+        src_mip_subresource_range.baseMipLevel            = mip - 1;
+
+        const VkImageMemoryBarrier2 src_mip_image_memory_barrier = vk_lib::image_memory_barrier_2(
+            renderer->hiz_image.image, src_mip_subresource_range, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+            VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+        const VkDependencyInfo src_mip_dependency_info = vk_lib::dependency_info(&src_mip_image_memory_barrier, nullptr, nullptr);
+        vkCmdPipelineBarrier2(command_buffer, &src_mip_dependency_info);
+
+        const VkExtent2D src_extent = push_constants.dst_extent;
+        push_constants.src_extent   = src_extent;
+        push_constants.dst_extent   = vk_lib::extent_2d(std::max(src_extent.width / 2, 1u), std::max(src_extent.height / 2, 1u));
+
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, renderer->downsample_hiz_compute_pipeline.pipeline_layout, 0, 1,
+                                &renderer->hiz_descriptor_sets[mip], 0, nullptr);
+        vkCmdPushConstants(command_buffer, renderer->downsample_hiz_compute_pipeline.pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                           sizeof(HizPushConstants), &push_constants);
+        vkCmdDispatch(command_buffer, (push_constants.dst_extent.width + 7) / 8, (push_constants.dst_extent.height + 7) / 8, 1);
     }
 
-    renderer_add_textures(renderer, textures);
+    const VkImageMemoryBarrier2 hiz_read_image_memory_barrier = vk_lib::image_memory_barrier_2(
+        renderer->hiz_image.image, hiz_subresource_range, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+    const VkDependencyInfo hiz_read_dependency_info = vk_lib::dependency_info(&hiz_read_image_memory_barrier, nullptr, nullptr);
+    vkCmdPipelineBarrier2(command_buffer, &hiz_read_dependency_info);
 
-    renderer->assets.push_back(asset);
+    gpu_profiler_end_pass(&renderer->gpu_profiler, command_buffer, frame_index, GpuPass::hiz_build);
 }
 
-static void renderer_set_main_pass_scene_data(Renderer* renderer, uint32_t frame_index) {
-    camera_update(renderer->frame_time);
-    SceneData scene_data{};
-    // float aspect_ratio = static_cast<float>(renderer->swapchain_context.extent.width) /
-    // static_cast<float>(renderer->swapchain_context.extent.height); scene_data.proj = glm::perspective(glm::radians(70.f), aspect_ratio, 10000.f,
-    // 0.01f); scene_data.proj[1][1] *= -1;
+// one invocation per metering_scale x metering_scale block of the resolved hdr image, accumulated into histogram
+static void renderer_record_exposure_histogram(Renderer* renderer, VkCommandBuffer command_buffer, VkDeviceAddress histogram_address,
+                                               uint32_t metering_scale) {
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, renderer->build_exposure_hist_compute_pipeline.pipeline);
 
-    scene_data.proj = global::camera.proj;
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, renderer->build_exposure_hist_compute_pipeline.pipeline_layout, 0, 1,
+                            &renderer->build_histogram_descriptor_set, 0, nullptr);
 
-    scene_data.view = camera_view();
+    BuildHistPushConstants histogram_constants;
+    histogram_constants.histogram_buf_address = histogram_address;
+    histogram_constants.view_width            = renderer->render_extent.width;
+    histogram_constants.view_height           = renderer->render_extent.height;
+    histogram_constants.pre_exposure          = renderer->pre_exposure;
+    histogram_constants.metering_scale        = metering_scale;
 
-    scene_data.eye_pos = global::camera.eye_pos;
+    vkCmdPushConstants(command_buffer, renderer->build_exposure_hist_compute_pipeline.pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                       sizeof(BuildHistPushConstants), &histogram_constants);
 
-    scene_data.sun_dir = renderer->sun_dir;
+    const uint32_t metering_width  = (renderer->render_extent.width + metering_scale - 1) / metering_scale;
+    const uint32_t metering_height = (renderer->render_extent.height + metering_scale - 1) / metering_scale;
+    vkCmdDispatch(command_buffer, (metering_width + 15) / 16, (metering_height + 15) / 16, 1);
+}
 
-    scene_data.light_transform = renderer->light_transform;
+// groups this frame's visible opaque draws by raster state and orders each group front to back for early depth rejection
+static void renderer_sort_visible_opaque_draws(Renderer* renderer) {
+    TRACE_ZONE("sort_visible_opaque_draws");
+    const CullBounds* cull_bounds = &renderer->opaque_cull_bounds;
+    const glm::vec3   eye_pos     = global::camera.eye_pos;
+
+    renderer->draw_sort_keys.clear();
+    for (uint32_t draw_index : renderer->visible_opaque_draws) {
+        const DrawObject* draw   = &renderer->opaque_draws[draw_index];
+        const glm::vec3   center = {cull_bounds->center_x[draw_index], cull_bounds->center_y[draw_index], cull_bounds->center_z[draw_index]};
+        renderer->draw_sort_keys.push_back(
+            draw_sort_key(draw->double_sided, draw->front_face, glm::distance(eye_pos, center), draw->material_index, draw_index));
+    }
+    radix_sort_keys(&renderer->draw_sort_keys, &renderer->draw_sort_scratch);
 
-    VK_CHECK(
-        vmaCopyMemoryToAllocation(renderer->allocator, &scene_data, renderer->main_scene_data_buffers[frame_index].allocation, 0, sizeof(SceneData)));
+    for (uint32_t i = 0; i < renderer->draw_sort_keys.size(); i++) {
+        renderer->visible_opaque_draws[i] = draw_sort_key_draw_index(renderer->draw_sort_keys[i]);
+    }
+}
 
-    VkDescriptorBufferInfo buffer_info = vk_lib::descriptor_buffer_info(renderer->main_scene_data_buffers[frame_index].buffer);
+// last dynamic raster state recorded in a pass. starts out invalid so the first draw always sets it
+struct DrawRasterState {
+    VkCullModeFlags cull_mode{VK_CULL_MODE_FLAG_BITS_MAX_ENUM};
+    VkFrontFace     front_face{VK_FRONT_FACE_MAX_ENUM};
+};
+
+// records cull mode and front face only when they differ from what the pass last set
+static void set_draw_raster_state(VkCommandBuffer command_buffer, DrawRasterState* state, VkCullModeFlags cull_mode, VkFrontFace front_face) {
+    if (state->cull_mode != cull_mode) {
+        vkCmdSetCullMode(command_buffer, cull_mode);
+        state->cull_mode = cull_mode;
+    }
+    if (state->front_face != front_face) {
+        vkCmdSetFrontFace(command_buffer, front_face);
+        state->front_face = front_face;
+    }
+}
 
-    VkWriteDescriptorSet descriptor_write =
-        vk_lib::write_descriptor_set(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, renderer->scene_descriptor_sets[frame_index], nullptr, &buffer_info);
-    vkUpdateDescriptorSets(renderer->vk_context.device, 1, &descriptor_write, 0, nullptr);
+// every draw's indices live in the arena, so a pass binds them once
+static void bind_geometry_arena_index_buffer(const Renderer* renderer, VkCommandBuffer command_buffer) {
+    if (renderer->geometry_arena.index_buffer.buffer == nullptr) {
+        return;
+    }
+    vkCmdBindIndexBuffer(command_buffer, renderer->geometry_arena.index_buffer.buffer, 0, VK_INDEX_TYPE_UINT32);
 }
 
-static void renderer_set_shadow_pass_scene_data(Renderer* renderer, uint32_t frame_index) {
+static void set_indirect_batch_raster_state(VkCommandBuffer command_buffer, uint32_t batch, VkCullModeFlags single_sided_cull_mode) {
+    const bool double_sided = batch % indirect_opaque_batch_count >= 2;
+    vkCmdSetCullMode(command_buffer, double_sided ? VK_CULL_MODE_NONE : single_sided_cull_mode);
+    vkCmdSetFrontFace(command_buffer, batch % 2 == 1 ? VK_FRONT_FACE_CLOCKWISE : VK_FRONT_FACE_COUNTER_CLOCKWISE);
+}
 
-    SceneData scene_data{};
-    float     bounds          = 30;
-    glm::vec3 light_pos       = glm::vec3(2, 4.5, 1) * 5;
-    scene_data.sun_dir        = glm::normalize(light_pos);
-    scene_data.view           = glm::lookAt(light_pos, glm::vec3(0), glm::vec3(0, 1, 0));
-    scene_data.proj           = glm::ortho(-bounds, bounds, -bounds, bounds, 0.0001f, 100.f);
-    renderer->light_transform = scene_data.proj * scene_data.view;
-    renderer->sun_dir         = glm::normalize(light_pos);
-    VK_CHECK(vmaCopyMemoryToAllocation(renderer->allocator, &scene_data, renderer->shadow_scene_data_buffers[frame_index].allocation, 0,
-                                       sizeof(SceneData)));
-
-    VkDescriptorBufferInfo buffer_info = vk_lib::descriptor_buffer_info(renderer->shadow_scene_data_buffers[frame_index].buffer);
-
-    VkWriteDescriptorSet descriptor_write =
-        vk_lib::write_descriptor_set(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, renderer->shadow_descriptor_sets[frame_index], nullptr, &buffer_info);
-    vkUpdateDescriptorSets(renderer->vk_context.device, 1, &descriptor_write, 0, nullptr);
-}
-
-bool is_visible(const DrawObject* obj, const glm::mat4& view_proj) {
-    std::array<glm::vec3, 8> corners{
-        glm::vec3{1,  1,  1 },
-        glm::vec3{1,  1,  -1},
-        glm::vec3{1,  -1, 1 },
-        glm::vec3{1,  -1, -1},
-        glm::vec3{-1, 1,  1 },
-        glm::vec3{-1, 1,  -1},
-        glm::vec3{-1, -1, 1 },
-        glm::vec3{-1, -1, -1},
-    };
+// one vkCmdDrawIndexedIndirectCount per non empty batch in [first_batch, end_batch) using culled commands and counts
+static void renderer_draw_indirect_batches(const Renderer* renderer, VkCommandBuffer command_buffer, const AllocatedBuffer* commands,
+                                           const AllocatedBuffer* counts, uint32_t first_batch, uint32_t end_batch,
+                                           VkCullModeFlags single_sided_cull_mode) {
+    for (uint32_t batch = first_batch; batch < end_batch; batch++) {
+        if (renderer->indirect_batch_capacity[batch] == 0) {
+            continue;
+        }
+        set_indirect_batch_raster_state(command_buffer, batch, single_sided_cull_mode);
 
-    glm::mat4 matrix = view_proj * obj->transform;
+        vkCmdDrawIndexedIndirectCount(command_buffer, commands->buffer,
+                                      renderer->indirect_batch_first_command[batch] * sizeof(VkDrawIndexedIndirectCommand), counts->buffer,
+                                      batch * sizeof(uint32_t),
+                                      renderer->indirect_batch_capacity[batch], sizeof(VkDrawIndexedIndirectCommand));
+    }
+}
 
-    glm::vec3 min = {1.5, 1.5, 1.5};
-    glm::vec3 max = {-1.5, -1.5, -1.5};
+// draw lists shorter than this aren't worth another secondary command buffer
+constexpr uint32_t min_draws_per_record_chunk = 128;
+
+enum class DrawPass : uint32_t {
+    shadow_map,
+    depth_pre,
+    main,
+};
+
+// a contiguous range of one pass's draw list, recorded into its own secondary command buffer. the main pass list is the
+// visible opaque draws followed by the visible transparent ones
+struct DrawChunk {
+    DrawPass        pass{};
+    uint32_t        cascade{};
+    uint32_t        first_draw{};
+    uint32_t        draw_count{};
+    VkCommandBuffer command_buffer{};
+};
+
+static void recording_contexts_create(Renderer* renderer, uint32_t frame_count) {
+    VkDevice       device       = renderer->vk_context.device;
+    const uint32_t thread_count = job_system_thread_count(renderer->job_system.get());
+
+    renderer->recording_contexts.resize(frame_count * thread_count);
+    for (RecordingContext& recording_ctx : renderer->recording_contexts) {
+        const VkCommandPoolCreateInfo command_pool_ci =
+            vk_lib::command_pool_create_info(renderer->vk_context.queue_family, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+        VK_CHECK(vkCreateCommandPool(device, &command_pool_ci, nullptr, &recording_ctx.command_pool));
+    }
+}
 
-    for (int c = 0; c < 8; c++) {
-        // project each corner into clip space
-        glm::vec4 v = matrix * glm::vec4(obj->bounds.origin + (corners[c] * obj->bounds.extent), 1.f);
+// called once the frame's fence signaled, so none of its secondary command buffers are still pending
+static void recording_contexts_reset(Renderer* renderer, uint32_t frame_index) {
+    const uint32_t thread_count = job_system_thread_count(renderer->job_system.get());
+    for (uint32_t thread_index = 0; thread_index < thread_count; thread_index++) {
+        RecordingContext* recording_ctx = &renderer->recording_contexts[frame_index * thread_count + thread_index];
+        VK_CHECK(vkResetCommandPool(renderer->vk_context.device, recording_ctx->command_pool, 0));
+        recording_ctx->used_count = 0;
+    }
+}
 
-        // perspective correction
-        v.x = v.x / v.w;
-        v.y = v.y / v.w;
-        v.z = v.z / v.w;
+static VkCommandBuffer recording_context_acquire_command_buffer(RecordingContext* recording_ctx, VkDevice device) {
+    if (recording_ctx->used_count == recording_ctx->command_buffers.size()) {
+        VkCommandBufferAllocateInfo command_buffer_ai = vk_lib::command_buffer_allocate_info(recording_ctx->command_pool);
+        command_buffer_ai.level                       = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
 
-        min = glm::min(glm::vec3{v.x, v.y, v.z}, min);
-        max = glm::max(glm::vec3{v.x, v.y, v.z}, max);
+        VkCommandBuffer command_buffer;
+        VK_CHECK(vkAllocateCommandBuffers(device, &command_buffer_ai, &command_buffer));
+        recording_ctx->command_buffers.push_back(command_buffer);
     }
+    return recording_ctx->command_buffers[recording_ctx->used_count++];
+}
 
-    // check the clip space box is within the view
-    if (min.z > 1.f || max.z < 0.f || min.x > 1.f || max.x < -1.f || min.y > 1.f || max.y < -1.f) {
-        return false;
-    } else {
-        return true;
+// splits a pass's draw list into at most one chunk per recording thread. cascade is only meaningful for the shadow pass
+static void append_draw_chunks(std::vector<DrawChunk>* chunks, DrawPass pass, uint32_t cascade, uint32_t draw_count, uint32_t thread_count) {
+    if (draw_count == 0) {
+        return;
+    }
+    const uint32_t chunk_count = std::clamp(draw_count / min_draws_per_record_chunk, 1u, thread_count);
+    for (uint32_t i = 0; i < chunk_count; i++) {
+        const uint32_t first_draw = static_cast<uint64_t>(draw_count) * i / chunk_count;
+        const uint32_t end_draw   = static_cast<uint64_t>(draw_count) * (i + 1) / chunk_count;
+        chunks->push_back({pass, cascade, first_draw, end_draw - first_draw});
     }
 }
 
-static void update_compute_descriptors(Renderer* renderer) {
-    // update exposure histogram descriptor
-    VkContext* vk_ctx = &renderer->vk_context;
+static void record_draw_objects(const Renderer* renderer, VkCommandBuffer command_buffer, VkPipelineLayout pipeline_layout,
+                                VkShaderStageFlags push_constant_stages, const std::vector<DrawObject>& draws, std::span<const uint32_t> draw_indices,
+                                VkCullModeFlags single_sided_cull_mode, DrawRasterState* raster_state) {
+    for (uint32_t draw_index : draw_indices) {
+        const DrawObject& draw = draws[draw_index];
+        DrawPushConstants push_constants{};
+        push_constants.model_transform    = draw.transform;
+        push_constants.vertex_buf_address = renderer->geometry_arena.vertex_buffer.address;
+        push_constants.material_index     = draw.material_index;
+        push_constants.vertex_format      = static_cast<uint32_t>(draw.geometry.vertex_format);
+        push_constants.position_base      = draw.geometry.position_base;
+        push_constants.position_scale     = draw.geometry.position_scale;
 
-    // exposure histogram pipeline
-    VkDescriptorImageInfo luminance_descriptor_image_info =
-        vk_lib::descriptor_image_info(renderer->resolve_color_image.image_view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, renderer->default_sampler);
-    VkWriteDescriptorSet luminance_image_build_histogram_write = vk_lib::write_descriptor_set(
-        0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, renderer->build_histogram_descriptor_set, &luminance_descriptor_image_info);
-    vkUpdateDescriptorSets(vk_ctx->device, 1, &luminance_image_build_histogram_write, 0, nullptr);
+        const VkCullModeFlags cull_mode = draw.double_sided ? VK_CULL_MODE_NONE : single_sided_cull_mode;
+        set_draw_raster_state(command_buffer, raster_state, cull_mode, draw.front_face);
 
-    // color correct pipeline
-    VkDescriptorImageInfo color_correct_image_info = vk_lib::descriptor_image_info(renderer->resolve_color_image.image_view, VK_IMAGE_LAYOUT_GENERAL);
-    VkWriteDescriptorSet  hdr_image_color_correct_write =
-        vk_lib::write_descriptor_set(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, renderer->color_correct_descriptor_set, &color_correct_image_info);
-    vkUpdateDescriptorSets(vk_ctx->device, 1, &hdr_image_color_correct_write, 0, nullptr);
+        vkCmdPushConstants(command_buffer, pipeline_layout, push_constant_stages, 0, sizeof(DrawPushConstants), &push_constants);
+
+        vkCmdDrawIndexed(command_buffer, draw.geometry.index_count, 1, draw.geometry.first_index, draw.geometry.vertex_offset, 0);
+    }
 }
 
-static void renderer_resize_screen(Renderer* renderer) {
-    SwapchainContext* swapchain_ctx = &renderer->swapchain_context;
-    VkContext*        vk_ctx        = &renderer->vk_context;
-    swapchain_context_recreate(swapchain_ctx, vk_ctx->physical_device, vk_ctx->device, vk_ctx->surface, renderer->window.glfw_window);
-    destroy_render_resources(renderer);
-    create_render_resources(renderer);
+// runs on a job system thread. only the rendering attachments are inherited from the primary, so every chunk sets up its
+// pass state from scratch
+static void record_draw_chunk(Renderer* renderer, uint32_t frame_index, uint32_t thread_index, DrawChunk* chunk) {
+    TRACE_ZONE("record_draw_chunk");
+    const uint32_t    thread_count  = job_system_thread_count(renderer->job_system.get());
+    RecordingContext* recording_ctx = &renderer->recording_contexts[frame_index * thread_count + thread_index];
+
+    VkCommandBuffer command_buffer = recording_context_acquire_command_buffer(recording_ctx, renderer->vk_context.device);
+    chunk->command_buffer          = command_buffer;
+
+    const std::array color_attachment_formats = {renderer->msaa_color_image.image_format};
+
+    VkCommandBufferInheritanceRenderingInfo inheritance_rendering_info{};
+    inheritance_rendering_info.sType                 = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+    inheritance_rendering_info.depthAttachmentFormat = renderer->depth_image.image_format;
+    inheritance_rendering_info.rasterizationSamples  = VK_SAMPLE_COUNT_4_BIT;
+    if (chunk->pass == DrawPass::shadow_map) {
+        inheritance_rendering_info.depthAttachmentFormat = renderer->shadow_map_image.image_format;
+        inheritance_rendering_info.rasterizationSamples  = VK_SAMPLE_COUNT_1_BIT;
+    } else if (chunk->pass == DrawPass::main) {
+        inheritance_rendering_info.colorAttachmentCount    = color_attachment_formats.size();
+        inheritance_rendering_info.pColorAttachmentFormats = color_attachment_formats.data();
+    }
 
-    update_compute_descriptors(renderer);
+    VkCommandBufferInheritanceInfo inheritance_info{};
+    inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance_info.pNext = &inheritance_rendering_info;
 
-    float aspect_ratio = static_cast<float>(renderer->swapchain_context.extent.width) / static_cast<float>(renderer->swapchain_context.extent.height);
-    set_camera_proj(glm::radians(70.f), aspect_ratio);
+    VkCommandBufferBeginInfo begin_info =
+        vk_lib::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT);
+    begin_info.pInheritanceInfo = &inheritance_info;
+    VK_CHECK(vkBeginCommandBuffer(command_buffer, &begin_info));
+
+    bind_geometry_arena_index_buffer(renderer, command_buffer);
+
+    DrawRasterState raster_state{};
+    if (chunk->pass == DrawPass::shadow_map) {
+        const VkViewport shadow_map_viewport =
+            vk_lib::viewport(static_cast<float>(renderer->shadow_map_extent.width), static_cast<float>(renderer->shadow_map_extent.height));
+        const VkRect2D shadow_map_scissor =
+            vk_lib::rect_2d(vk_lib::extent_2d(renderer->shadow_map_extent.width, renderer->shadow_map_extent.height));
+        vkCmdSetViewport(command_buffer, 0, 1, &shadow_map_viewport);
+        vkCmdSetScissor(command_buffer, 0, 1, &shadow_map_scissor);
+
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->shadow_map_graphics_pipeline.pipeline);
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->shadow_map_graphics_pipeline.pipeline_layout, 0, 1,
+                                &renderer->shadow_descriptor_sets[frame_index * renderer->shadow_cascade_count + chunk->cascade], 0, nullptr);
+
+        const std::span<const uint32_t> shadow_draws =
+            std::span(renderer->shadow_cascade_draws[chunk->cascade]).subspan(chunk->first_draw, chunk->draw_count);
+        record_draw_objects(renderer, command_buffer, renderer->shadow_map_graphics_pipeline.pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT,
+                            renderer->opaque_draws, shadow_draws, VK_CULL_MODE_FRONT_BIT, &raster_state);
+    } else {
+        const VkViewport viewport =
+            vk_lib::viewport(static_cast<float>(renderer->render_extent.width), static_cast<float>(renderer->render_extent.height));
+        const VkRect2D scissor = vk_lib::rect_2d(renderer->render_extent);
+        vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+        vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+    }
+
+    if (chunk->pass == DrawPass::depth_pre) {
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->depth_pre_graphics_pipeline.pipeline);
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->depth_pre_graphics_pipeline.pipeline_layout, 0, 1,
+                                &renderer->scene_descriptor_sets[frame_index], 0, nullptr);
+
+        const std::span<const uint32_t> opaque_draws = std::span(renderer->visible_opaque_draws).subspan(chunk->first_draw, chunk->draw_count);
+        record_draw_objects(renderer, command_buffer, renderer->depth_pre_graphics_pipeline.pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT,
+                            renderer->opaque_draws, opaque_draws, VK_CULL_MODE_BACK_BIT, &raster_state);
+    } else if (chunk->pass == DrawPass::main) {
+        // both opaque and transparent have the same pipeline layouts. just use the opaque pipeline layout
+        std::array desc_sets = {renderer->scene_descriptor_sets[frame_index], renderer->asset_descriptor_set};
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->opaque_graphics_pipeline.pipeline_layout, 0,
+                                desc_sets.size(), desc_sets.data(), 0, nullptr);
+
+        const uint32_t opaque_count = renderer->visible_opaque_draws.size();
+        const uint32_t end_draw     = chunk->first_draw + chunk->draw_count;
+
+        if (chunk->first_draw < opaque_count) {
+            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->opaque_graphics_pipeline.pipeline);
+
+            const std::span<const uint32_t> opaque_draws =
+                std::span(renderer->visible_opaque_draws).subspan(chunk->first_draw, std::min(end_draw, opaque_count) - chunk->first_draw);
+            record_draw_objects(renderer, command_buffer, renderer->opaque_graphics_pipeline.pipeline_layout, VK_SHADER_STAGE_ALL,
+                                renderer->opaque_draws, opaque_draws, VK_CULL_MODE_BACK_BIT, &raster_state);
+        }
+
+        if (end_draw > opaque_count) {
+            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->transparent_graphics_pipeline.pipeline);
+
+            const uint32_t                  first_transparent = std::max(chunk->first_draw, opaque_count) - opaque_count;
+            const std::span<const uint32_t> transparent_draws =
+                std::span(renderer->visible_transparent_draws).subspan(first_transparent, end_draw - opaque_count - first_transparent);
+            record_draw_objects(renderer, command_buffer, renderer->transparent_graphics_pipeline.pipeline_layout, VK_SHADER_STAGE_ALL,
+                                renderer->transparent_draws, transparent_draws, VK_CULL_MODE_BACK_BIT, &raster_state);
+        }
+    }
+
+    VK_CHECK(vkEndCommandBuffer(command_buffer));
+}
+
+// executes a pass's secondaries in draw list order
+static void execute_draw_chunks(VkCommandBuffer command_buffer, const std::vector<DrawChunk>& chunks, DrawPass pass, uint32_t cascade = 0) {
+    std::array<VkCommandBuffer, max_record_thread_count> secondary_command_buffers{};
+    uint32_t                                             secondary_count = 0;
+    for (const DrawChunk& chunk : chunks) {
+        if (chunk.pass == pass && chunk.cascade == cascade) {
+            secondary_command_buffers[secondary_count++] = chunk.command_buffer;
+        }
+    }
+    if (secondary_count > 0) {
+        vkCmdExecuteCommands(command_buffer, secondary_count, secondary_command_buffers.data());
+    }
 }
 
 void renderer_draw(Renderer* renderer) {
+    TRACE_ZONE("renderer_draw");
     static auto last_frame_time    = std::chrono::high_resolution_clock::now();
     auto        current_frame_time = std::chrono::high_resolution_clock::now();
     auto        duration           = std::chrono::duration<float>(current_frame_time - last_frame_time);
@@ -1025,106 +3073,214 @@ void renderer_draw(Renderer* renderer) {
     renderer->frame_time = smoothed_frame_time;
     last_frame_time      = current_frame_time;
 
+    renderer_publish_loaded_assets(renderer);
+    renderer_update_residency(renderer);
+
     VkContext*        vk_ctx        = &renderer->vk_context;
     SwapchainContext* swapchain_ctx = &renderer->swapchain_context;
-    const uint32_t    frame_index   = renderer->curr_frame % swapchain_ctx->images.size();
+    const uint32_t    frame_index   = renderer->curr_frame % renderer->frames.size();
     const Frame*      current_frame = &renderer->frames[frame_index];
 
     VkCommandBuffer command_buffer = current_frame->command_buffer;
 
+    TRACE_ZONE_BEGIN("wait_for_frame_fence");
     VK_CHECK(vkWaitForFences(vk_ctx->device, 1, &current_frame->in_flight_fence, true, UINT64_MAX));
     VK_CHECK(vkResetFences(vk_ctx->device, 1, &current_frame->in_flight_fence));
+    TRACE_ZONE_END();
+
+    recording_contexts_reset(renderer, frame_index);
+    texture_table_retire(renderer);
+    material_store_retire(renderer);
+    streamed_images_retire(renderer);
+    retiring_assets_retire(renderer);
+    retiring_buffers_retire(renderer);
+
+    renderer_update_pre_exposure(renderer, frame_index);
+    renderer_update_metering_report(renderer, frame_index);
+
+    const bool headless = renderer->options.headless;
+
+    uint32_t swapchain_image_index = 0;
+    VkResult swapchain_result      = VK_SUCCESS;
+    if (!headless) {
+        TRACE_ZONE("acquire_swapchain_image");
+        swapchain_result = vkAcquireNextImageKHR(vk_ctx->device, swapchain_ctx->swapchain, UINT64_MAX, current_frame->image_available_semaphore,
+                                                 nullptr, &swapchain_image_index);
+
+        if (swapchain_result == VK_ERROR_OUT_OF_DATE_KHR || swapchain_result == VK_SUBOPTIMAL_KHR) {
+            renderer_resize_screen(renderer);
+            return;
+        }
+    }
 
-    renderer_set_shadow_pass_scene_data(renderer, frame_index);
+    // the cascades are fitted to this frame's camera, so it moves first
+    camera_update(renderer->frame_time);
 
-    uint32_t swapchain_image_index;
-    VkResult swapchain_result = vkAcquireNextImageKHR(vk_ctx->device, swapchain_ctx->swapchain, UINT64_MAX, current_frame->image_available_semaphore,
-                                                      nullptr, &swapchain_image_index);
+    const bool render_shadow_map = renderer_set_shadow_pass_scene_data(renderer, frame_index);
 
-    if (swapchain_result == VK_ERROR_OUT_OF_DATE_KHR || swapchain_result == VK_SUBOPTIMAL_KHR) {
-        renderer_resize_screen(renderer);
-        return;
+    renderer_set_main_pass_scene_data(renderer, frame_index);
+
+    TRACE_ZONE_BEGIN("frustum_cull");
+    const Frustum camera_frustum = frustum_from_view_proj(global::camera.proj * camera_view());
+    renderer_update_asset_visibility(renderer, &camera_frustum);
+    if (renderer->gpu_driven) {
+        renderer->visible_opaque_draws.clear();
+        renderer->visible_transparent_draws.clear();
+    } else {
+        frustum_cull(&renderer->opaque_cull_bounds, &camera_frustum, &renderer->visible_opaque_draws);
+        frustum_cull(&renderer->transparent_cull_bounds, &camera_frustum, &renderer->visible_transparent_draws);
+        renderer_sort_visible_opaque_draws(renderer);
+        if (render_shadow_map) {
+            renderer_cull_shadow_casters(renderer);
+        }
+    }
+    TRACE_ZONE_END();
+
+    // swaps go out with this frame's uploads and material updates
+    renderer_update_texture_streaming(renderer);
+
+    // the gpu driven path records its few indirect draws inline. otherwise every pass is recorded in parallel into
+    // secondary command buffers before the primary is touched
+    const bool record_indirect = renderer->gpu_driven && renderer->gpu_draw_count > 0;
+    // the cpu path records its passes before the pyramid exists, so occlusion culling only runs on the gpu driven path
+    const bool occlusion_cull = record_indirect && renderer->options.occlusion_culling;
+
+    std::vector<DrawChunk> draw_chunks{};
+    if (!record_indirect) {
+        TRACE_ZONE("record_draw_chunks");
+        const uint32_t thread_count = job_system_thread_count(renderer->job_system.get());
+        for (uint32_t cascade = 0; render_shadow_map && cascade < renderer->shadow_cascade_count; cascade++) {
+            append_draw_chunks(&draw_chunks, DrawPass::shadow_map, cascade, renderer->shadow_cascade_draws[cascade].size(), thread_count);
+        }
+        append_draw_chunks(&draw_chunks, DrawPass::depth_pre, 0, renderer->visible_opaque_draws.size(), thread_count);
+        append_draw_chunks(&draw_chunks, DrawPass::main, 0, renderer->visible_opaque_draws.size() + renderer->visible_transparent_draws.size(),
+                           thread_count);
+
+        job_system_parallel_for(renderer->job_system.get(), draw_chunks.size(), [&](uint32_t chunk_index, uint32_t thread_index) {
+            record_draw_chunk(renderer, frame_index, thread_index, &draw_chunks[chunk_index]);
+        });
     }
 
+    const VkRenderingFlags draw_rendering_flags = record_indirect ? 0 : VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
+
     const VkImageSubresourceRange depth_subresource_range = vk_lib::image_subresource_range(VK_IMAGE_ASPECT_DEPTH_BIT);
     const VkImageSubresourceRange color_subresource_range = vk_lib::image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT);
 
+    VkImageSubresourceRange shadow_map_subresource_range = vk_lib::image_subresource_range(VK_IMAGE_ASPECT_DEPTH_BIT);
+    shadow_map_subresource_range.layerCount              = renderer->shadow_cascade_count;
+
     VK_CHECK(vkResetCommandBuffer(command_buffer, 0));
 
     VkCommandBufferBeginInfo begin_info = vk_lib::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
     VK_CHECK(vkBeginCommandBuffer(command_buffer, &begin_info));
 
-    const VkViewport shadow_map_viewport =
-        vk_lib::viewport(static_cast<float>(renderer->shadow_map_extent.width), static_cast<float>(renderer->shadow_map_extent.height));
+    gpu_profiler_begin_frame(&renderer->gpu_profiler, vk_ctx->device, command_buffer, frame_index);
 
-    VkExtent2D     shadow_map_extent_2d = vk_lib::extent_2d(renderer->shadow_map_extent.width, renderer->shadow_map_extent.height);
-    const VkRect2D shadow_map_scissor   = vk_lib::rect_2d(shadow_map_extent_2d);
+    // takes ownership of everything uploaded since the last frame. the submit of command_buffer waits for the copies
+    const uint64_t upload_wait_value = upload_manager_record_acquires(&renderer->upload_manager, command_buffer);
+    renderer_record_geometry_copies(renderer, command_buffer);
+    renderer_record_material_updates(renderer, command_buffer);
 
-    vkCmdSetViewport(command_buffer, 0, 1, &shadow_map_viewport);
+    // SHADOW MAP GENERATION
 
-    vkCmdSetScissor(command_buffer, 0, 1, &shadow_map_scissor);
+    // the shadow map keeps its contents and stays in DEPTH_READ_ONLY_OPTIMAL until the light or a caster changes
+    if (render_shadow_map) {
+        TRACE_ZONE_BEGIN("record_shadow_map_pass");
 
-    // SHADOW MAP GENERATION
+        // earlier frames may still be sampling the cached contents in their main pass. the clear load op writes the map
+        const VkImageMemoryBarrier2 shadow_map_clear_image_memory_barrier = vk_lib::image_memory_barrier_2(
+            renderer->shadow_map_image.image, shadow_map_subresource_range, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+            VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT, VK_ACCESS_2_NONE,
+            VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
 
-    const VkImageMemoryBarrier2 shadow_map_clear_image_memory_barrier = vk_lib::image_memory_barrier_2(
-        renderer->shadow_map_image.image, depth_subresource_range, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
-        VK_PIPELINE_STAGE_2_NONE, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT, VK_ACCESS_2_NONE, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT);
+        VkDependencyInfo shadow_map_clear_dependency_info = vk_lib::dependency_info(&shadow_map_clear_image_memory_barrier, nullptr, nullptr);
 
-    const VkImageMemoryBarrier2 depth_pre_image_memory_barrier = vk_lib::image_memory_barrier_2(
-        renderer->depth_image.image, depth_subresource_range, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
-        VK_PIPELINE_STAGE_2_NONE, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_ACCESS_2_NONE);
+        vkCmdPipelineBarrier2(command_buffer, &shadow_map_clear_dependency_info);
 
-    std::array depth_only_memory_barriers = {shadow_map_clear_image_memory_barrier, depth_pre_image_memory_barrier};
+        VkClearValue shadow_depth_clear_value{};
+        shadow_depth_clear_value.color = {1, 1, 1, 1};
 
-    VkDependencyInfo depth_only_dependency_info = vk_lib::dependency_info_batch(depth_only_memory_barriers, {}, {});
+        VkExtent2D     shadow_map_extent_2d   = vk_lib::extent_2d(renderer->shadow_map_extent.width, renderer->shadow_map_extent.height);
+        const VkRect2D shadow_map_render_area = vk_lib::rect_2d(shadow_map_extent_2d);
 
-    vkCmdPipelineBarrier2(command_buffer, &depth_only_dependency_info);
+        gpu_profiler_begin_pass(&renderer->gpu_profiler, command_buffer, frame_index, GpuPass::shadow_map);
 
-    VkClearValue shadow_depth_clear_value{};
-    shadow_depth_clear_value.color = {1, 1, 1, 1};
+        // one pass per cascade layer, each with its own light projection
+        for (uint32_t cascade = 0; cascade < renderer->shadow_cascade_count; cascade++) {
+            VkRenderingAttachmentInfo shadow_map_attachment_info =
+                vk_lib::rendering_attachment_info(renderer->shadow_cascade_views[cascade], VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+                                                  VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, &shadow_depth_clear_value);
 
-    VkRenderingAttachmentInfo shadow_map_attachment_info =
-        vk_lib::rendering_attachment_info(renderer->shadow_map_image.image_view, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
-                                          VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, &shadow_depth_clear_value);
+            VkRenderingInfoKHR shadow_map_rendering_info = vk_lib::rendering_info(shadow_map_render_area, {}, &shadow_map_attachment_info);
+            shadow_map_rendering_info.flags              = draw_rendering_flags;
 
-    const VkRect2D           shadow_map_render_area    = vk_lib::rect_2d(shadow_map_extent_2d);
-    const VkRenderingInfoKHR shadow_map_rendering_info = vk_lib::rendering_info(shadow_map_render_area, {}, &shadow_map_attachment_info);
+            vkCmdBeginRenderingKHR(command_buffer, &shadow_map_rendering_info);
 
-    vkCmdBeginRenderingKHR(command_buffer, &shadow_map_rendering_info);
+            if (record_indirect) {
+                const VkViewport shadow_map_viewport =
+                    vk_lib::viewport(static_cast<float>(renderer->shadow_map_extent.width), static_cast<float>(renderer->shadow_map_extent.height));
+                const VkRect2D shadow_map_scissor = vk_lib::rect_2d(shadow_map_extent_2d);
 
-    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->shadow_map_graphics_pipeline.pipeline);
+                vkCmdSetViewport(command_buffer, 0, 1, &shadow_map_viewport);
 
-    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->shadow_map_graphics_pipeline.pipeline_layout, 0, 1,
-                            &renderer->shadow_descriptor_sets[frame_index], 0, nullptr);
+                vkCmdSetScissor(command_buffer, 0, 1, &shadow_map_scissor);
 
-    for (const DrawObject& opaque_draw : renderer->opaque_draws) {
-        DrawPushConstants push_constants{};
-        push_constants.model_transform    = opaque_draw.transform;
-        push_constants.vertex_buf_address = opaque_draw.vertex_buffer.address;
-        push_constants.material_index     = opaque_draw.material_index;
+                vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->indirect_shadow_map_graphics_pipeline.pipeline);
 
-        vkCmdSetCullMode(command_buffer, opaque_draw.double_sided ? VK_CULL_MODE_NONE : VK_CULL_MODE_FRONT_BIT);
-        vkCmdSetFrontFace(command_buffer, opaque_draw.front_face);
+                vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                        renderer->indirect_shadow_map_graphics_pipeline.pipeline_layout, 0, 1,
+                                        &renderer->shadow_descriptor_sets[frame_index * renderer->shadow_cascade_count + cascade], 0, nullptr);
 
-        vkCmdPushConstants(command_buffer, renderer->shadow_map_graphics_pipeline.pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0,
-                           sizeof(DrawPushConstants), &push_constants);
+                bind_geometry_arena_index_buffer(renderer, command_buffer);
 
-        vkCmdBindIndexBuffer(command_buffer, opaque_draw.index_buffer.buffer, 0, opaque_draw.index_type);
-        vkCmdDrawIndexed(command_buffer, opaque_draw.index_count, 1, 0, 0, 0);
-    }
+                IndirectDrawPushConstants push_constants{};
+                push_constants.draw_buf_address   = renderer->gpu_draw_buffer.address;
+                push_constants.vertex_buf_address = renderer->geometry_arena.vertex_buffer.address;
+                vkCmdPushConstants(command_buffer, renderer->indirect_shadow_map_graphics_pipeline.pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0,
+                                   sizeof(IndirectDrawPushConstants), &push_constants);
 
-    vkCmdEndRenderingKHR(command_buffer);
+                for (uint32_t batch = 0; batch < indirect_opaque_batch_count; batch++) {
+                    if (renderer->indirect_batch_capacity[batch] == 0) {
+                        continue;
+                    }
+                    set_indirect_batch_raster_state(command_buffer, batch, VK_CULL_MODE_FRONT_BIT);
+                    vkCmdDrawIndexedIndirect(command_buffer, renderer->shadow_indirect_command_buffer.buffer,
+                                             renderer->indirect_batch_first_command[batch] * sizeof(VkDrawIndexedIndirectCommand),
+                                             renderer->indirect_batch_capacity[batch], sizeof(VkDrawIndexedIndirectCommand));
+                }
+            } else {
+                execute_draw_chunks(command_buffer, draw_chunks, DrawPass::shadow_map, cascade);
+            }
 
-    renderer_set_main_pass_scene_data(renderer, frame_index);
+            vkCmdEndRenderingKHR(command_buffer);
+        }
+
+        gpu_profiler_end_pass(&renderer->gpu_profiler, command_buffer, frame_index, GpuPass::shadow_map);
+        TRACE_ZONE_END();
+
+        renderer->shadow_map_dirty                 = false;
+        renderer->shadow_map_cascade_transforms    = renderer->cascade_transforms;
+        renderer->shadow_map_cascade_caster_planes = renderer->cascade_caster_planes;
+    }
+
+    if (renderer->gpu_driven) {
+        renderer_record_draw_cull(renderer, command_buffer, frame_index, &camera_frustum, false);
+    }
 
     // DEPTH PRE-PASS
 
-    const VkViewport viewport = vk_lib::viewport(static_cast<float>(swapchain_ctx->extent.width), static_cast<float>(swapchain_ctx->extent.height));
-    const VkRect2D   scissor  = vk_lib::rect_2d(swapchain_ctx->extent);
+    TRACE_ZONE_BEGIN("record_depth_pre_pass");
+
+    const VkImageMemoryBarrier2 depth_pre_image_memory_barrier = vk_lib::image_memory_barrier_2(
+        renderer->depth_image.image, depth_subresource_range, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+        VK_PIPELINE_STAGE_2_NONE, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_ACCESS_2_NONE);
+
+    VkDependencyInfo depth_pre_dependency_info = vk_lib::dependency_info(&depth_pre_image_memory_barrier, nullptr, nullptr);
 
-    vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+    vkCmdPipelineBarrier2(command_buffer, &depth_pre_dependency_info);
 
-    vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+    const VkViewport viewport = vk_lib::viewport(static_cast<float>(renderer->render_extent.width), static_cast<float>(renderer->render_extent.height));
+    const VkRect2D   scissor  = vk_lib::rect_2d(renderer->render_extent);
 
     VkClearValue depth_clear_value{};
     depth_clear_value.color = {0, 0, 0, 0};
@@ -1132,41 +3288,65 @@ void renderer_draw(Renderer* renderer) {
         vk_lib::rendering_attachment_info(renderer->depth_image.image_view, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, VK_ATTACHMENT_LOAD_OP_CLEAR,
                                           VK_ATTACHMENT_STORE_OP_STORE, &depth_clear_value);
 
-    const VkRect2D render_area = vk_lib::rect_2d(swapchain_ctx->extent);
+    const VkRect2D render_area = vk_lib::rect_2d(renderer->render_extent);
+
+    VkRenderingInfoKHR depth_pre_rendering_info = vk_lib::rendering_info(render_area, {}, &depth_pre_attachment_info);
+    depth_pre_rendering_info.flags              = draw_rendering_flags;
+
+    gpu_profiler_begin_pass(&renderer->gpu_profiler, command_buffer, frame_index, GpuPass::depth_pre);
 
-    const VkRenderingInfoKHR depth_pre_rendering_info = vk_lib::rendering_info(render_area, {}, &depth_pre_attachment_info);
     vkCmdBeginRenderingKHR(command_buffer, &depth_pre_rendering_info);
 
-    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->depth_pre_graphics_pipeline.pipeline);
+    if (record_indirect) {
+        vkCmdSetViewport(command_buffer, 0, 1, &viewport);
 
-    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->depth_pre_graphics_pipeline.pipeline_layout, 0, 1,
-                            &renderer->scene_descriptor_sets[frame_index], 0, nullptr);
-    for (const DrawObject& opaque_draw : renderer->opaque_draws) {
-        DrawPushConstants push_constants{};
-        push_constants.model_transform    = opaque_draw.transform;
-        push_constants.vertex_buf_address = opaque_draw.vertex_buffer.address;
-        push_constants.material_index     = opaque_draw.material_index;
+        vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->indirect_depth_pre_graphics_pipeline.pipeline);
+
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->indirect_depth_pre_graphics_pipeline.pipeline_layout, 0, 1,
+                                &renderer->scene_descriptor_sets[frame_index], 0, nullptr);
 
-        vkCmdSetCullMode(command_buffer, opaque_draw.double_sided ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT);
-        vkCmdSetFrontFace(command_buffer, opaque_draw.front_face);
+        bind_geometry_arena_index_buffer(renderer, command_buffer);
 
-        vkCmdPushConstants(command_buffer, renderer->depth_pre_graphics_pipeline.pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0,
-                           sizeof(DrawPushConstants), &push_constants);
+        IndirectDrawPushConstants push_constants{};
+        push_constants.draw_buf_address   = renderer->gpu_draw_buffer.address;
+        push_constants.vertex_buf_address = renderer->geometry_arena.vertex_buffer.address;
+        vkCmdPushConstants(command_buffer, renderer->indirect_depth_pre_graphics_pipeline.pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0,
+                           sizeof(IndirectDrawPushConstants), &push_constants);
 
-        vkCmdBindIndexBuffer(command_buffer, opaque_draw.index_buffer.buffer, 0, opaque_draw.index_type);
-        vkCmdDrawIndexed(command_buffer, opaque_draw.index_count, 1, 0, 0, 0);
+        renderer_draw_indirect_batches(renderer, command_buffer, &renderer->indirect_command_buffers[frame_index],
+                                       &renderer->indirect_count_buffers[frame_index], 0, indirect_opaque_batch_count, VK_CULL_MODE_BACK_BIT);
+    } else {
+        execute_draw_chunks(command_buffer, draw_chunks, DrawPass::depth_pre);
     }
 
     vkCmdEndRendering(command_buffer);
 
+    gpu_profiler_end_pass(&renderer->gpu_profiler, command_buffer, frame_index, GpuPass::depth_pre);
+    TRACE_ZONE_END();
+
+    // HI-Z OCCLUSION CULLING
+
+    // the main pass only draws what the pre-pass depth doesn't fully hide
+    if (occlusion_cull) {
+        renderer_record_hiz_build(renderer, command_buffer, frame_index);
+        renderer_record_draw_cull(renderer, command_buffer, frame_index, &camera_frustum, true);
+    }
+
+    // after a hi-z build the depth image comes back from DEPTH_READ_ONLY_OPTIMAL and the compute reads
     const VkImageMemoryBarrier2 depth_pre_write_image_memory_barrier = vk_lib::image_memory_barrier_2(
-        renderer->depth_image.image, depth_subresource_range, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
-        VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        renderer->depth_image.image, depth_subresource_range,
+        occlusion_cull ? VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+        occlusion_cull ? VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+        VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT,
+        occlusion_cull ? VK_ACCESS_2_NONE : VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
         VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT);
 
     // VkDependencyInfo depth_pre_write_dependency_info = vk_lib::dependency_info(&depth_pre_write_image_memory_barrier, nullptr, nullptr);
     const VkImageMemoryBarrier2 shadow_map_write_image_memory_barrier = vk_lib::image_memory_barrier_2(
-        renderer->shadow_map_image.image, depth_subresource_range, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL,
+        renderer->shadow_map_image.image, shadow_map_subresource_range, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+        VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL,
         VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
         VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT);
 
@@ -1174,13 +3354,17 @@ void renderer_draw(Renderer* renderer) {
         renderer->msaa_color_image.image, color_subresource_range, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
         VK_PIPELINE_STAGE_2_NONE, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, VK_ACCESS_2_NONE, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
 
-    const VkImageMemoryBarrier2 resolve_draw_image_memory_barrier =
-        vk_lib::image_memory_barrier_2(renderer->resolve_color_image.image, color_subresource_range, VK_IMAGE_LAYOUT_UNDEFINED,
-                                       VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR,
-                                       VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, VK_ACCESS_2_NONE, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+    // last frame's tone map may still be sampling the resolve image. on the compute queue that's covered by the timeline wait at
+    // the color attachment stage, and the old contents are dropped so the image comes back without an ownership transfer
+    const VkImageMemoryBarrier2 resolve_draw_image_memory_barrier = vk_lib::image_memory_barrier_2(
+        renderer->resolve_color_image.image, color_subresource_range, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR,
+        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, VK_ACCESS_2_NONE, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
 
-    std::array draw_image_memory_barriers = {msaa_draw_image_memory_barrier, resolve_draw_image_memory_barrier, shadow_map_write_image_memory_barrier,
-                                             depth_pre_write_image_memory_barrier};
+    std::vector draw_image_memory_barriers = {msaa_draw_image_memory_barrier, resolve_draw_image_memory_barrier, depth_pre_write_image_memory_barrier};
+    if (render_shadow_map) {
+        draw_image_memory_barriers.push_back(shadow_map_write_image_memory_barrier);
+    }
 
     const VkDependencyInfo draw_dependency_info = vk_lib::dependency_info_batch(draw_image_memory_barriers, {}, {});
 
@@ -1191,8 +3375,11 @@ void renderer_draw(Renderer* renderer) {
 
     // main pass
 
+    TRACE_ZONE_BEGIN("record_main_pass");
+
     glm::vec3 sky_color = {0.53, 0.81, 0.92};
     sky_color *= 10000.f; // illuminance
+    sky_color *= renderer->pre_exposure;
 
     VkClearValue color_clear_value{};
     // color_clear_value.color = {0.01, 0.01, 0.01, 0};
@@ -1205,65 +3392,99 @@ void renderer_draw(Renderer* renderer) {
 
     std::array color_attachment_infos = {color_attachment_info};
 
-    const VkRenderingInfoKHR rendering_info = vk_lib::rendering_info(render_area, color_attachment_infos, &depth_attachment_info);
+    VkRenderingInfoKHR rendering_info = vk_lib::rendering_info(render_area, color_attachment_infos, &depth_attachment_info);
+    rendering_info.flags              = draw_rendering_flags;
 
-    vkCmdBeginRenderingKHR(command_buffer, &rendering_info);
+    gpu_profiler_begin_pass(&renderer->gpu_profiler, command_buffer, frame_index, GpuPass::main);
 
-    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->opaque_graphics_pipeline.pipeline);
+    vkCmdBeginRenderingKHR(command_buffer, &rendering_info);
 
-    // both opaque and transparent have the same pipeline layouts. just use the opaque pipeline layout
-    std::array desc_sets = {renderer->scene_descriptor_sets[frame_index], renderer->asset_descriptor_set};
-    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->opaque_graphics_pipeline.pipeline_layout, 0, desc_sets.size(),
-                            desc_sets.data(), 0, nullptr);
+    if (record_indirect) {
+        // the indirect command buffers only exist once there are draws
+        const AllocatedBuffer* main_pass_commands =
+            occlusion_cull ? &renderer->occlusion_command_buffers[frame_index] : &renderer->indirect_command_buffers[frame_index];
+        const AllocatedBuffer* main_pass_counts =
+            occlusion_cull ? &renderer->occlusion_count_buffers[frame_index] : &renderer->indirect_count_buffers[frame_index];
 
-    for (const DrawObject& opaque_draw : renderer->opaque_draws) {
-        DrawPushConstants push_constants{};
-        push_constants.model_transform    = opaque_draw.transform;
-        push_constants.vertex_buf_address = opaque_draw.vertex_buffer.address;
-        push_constants.material_index     = opaque_draw.material_index;
+        vkCmdSetViewport(command_buffer, 0, 1, &viewport);
 
-        vkCmdSetCullMode(command_buffer, opaque_draw.double_sided ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT);
+        vkCmdSetScissor(command_buffer, 0, 1, &scissor);
 
-        vkCmdSetFrontFace(command_buffer, opaque_draw.front_face);
+        // both opaque and transparent have the same pipeline layouts. just use the opaque pipeline layout
+        std::array desc_sets = {renderer->scene_descriptor_sets[frame_index], renderer->asset_descriptor_set};
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->indirect_opaque_graphics_pipeline.pipeline_layout, 0,
+                                desc_sets.size(), desc_sets.data(), 0, nullptr);
 
-        vkCmdPushConstants(command_buffer, renderer->opaque_graphics_pipeline.pipeline_layout, VK_SHADER_STAGE_ALL, 0, sizeof(DrawPushConstants),
-                           &push_constants);
+        bind_geometry_arena_index_buffer(renderer, command_buffer);
 
-        vkCmdBindIndexBuffer(command_buffer, opaque_draw.index_buffer.buffer, 0, opaque_draw.index_type);
-        vkCmdDrawIndexed(command_buffer, opaque_draw.index_count, 1, 0, 0, 0);
-    }
+        IndirectDrawPushConstants push_constants{};
+        push_constants.draw_buf_address   = renderer->gpu_draw_buffer.address;
+        push_constants.vertex_buf_address = renderer->geometry_arena.vertex_buffer.address;
 
-    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->transparent_graphics_pipeline.pipeline);
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->indirect_opaque_graphics_pipeline.pipeline);
+        vkCmdPushConstants(command_buffer, renderer->indirect_opaque_graphics_pipeline.pipeline_layout, VK_SHADER_STAGE_ALL, 0,
+                           sizeof(IndirectDrawPushConstants), &push_constants);
+        renderer_draw_indirect_batches(renderer, command_buffer, main_pass_commands, main_pass_counts, 0, indirect_opaque_batch_count,
+                                       VK_CULL_MODE_BACK_BIT);
 
-    for (const DrawObject& transparent_draw : renderer->transparent_draws) {
-        DrawPushConstants push_constants{};
-        push_constants.model_transform    = transparent_draw.transform;
-        push_constants.vertex_buf_address = transparent_draw.vertex_buffer.address;
-        push_constants.material_index     = transparent_draw.material_index;
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->indirect_transparent_graphics_pipeline.pipeline);
+        renderer_draw_indirect_batches(renderer, command_buffer, main_pass_commands, main_pass_counts, indirect_opaque_batch_count,
+                                       indirect_batch_count, VK_CULL_MODE_BACK_BIT);
+    } else {
+        execute_draw_chunks(command_buffer, draw_chunks, DrawPass::main);
+    }
 
-        vkCmdSetCullMode(command_buffer, transparent_draw.double_sided ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT);
+    vkCmdEndRenderingKHR(command_buffer);
 
-        vkCmdSetFrontFace(command_buffer, transparent_draw.front_face);
+    gpu_profiler_end_pass(&renderer->gpu_profiler, command_buffer, frame_index, GpuPass::main);
+    TRACE_ZONE_END();
+
+    // with async compute the resolve image is released to the compute family here and the graphics queue moves on to the
+    // next frame while post processing runs
+    const bool      async_compute       = vk_context_has_async_compute(vk_ctx);
+    VkCommandBuffer post_command_buffer = command_buffer;
+    if (async_compute) {
+        VkImageMemoryBarrier2 resolve_release_image_memory_barrier = vk_lib::image_memory_barrier_2(
+            renderer->resolve_color_image.image, color_subresource_range, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, VK_PIPELINE_STAGE_2_NONE,
+            VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_2_NONE);
+        resolve_release_image_memory_barrier.srcQueueFamilyIndex = vk_ctx->queue_family;
+        resolve_release_image_memory_barrier.dstQueueFamilyIndex = vk_ctx->compute_queue_family;
+
+        const VkDependencyInfo resolve_release_dependency_info = vk_lib::dependency_info(&resolve_release_image_memory_barrier, nullptr, nullptr);
+        vkCmdPipelineBarrier2(command_buffer, &resolve_release_dependency_info);
+
+        VK_CHECK(vkEndCommandBuffer(command_buffer));
+
+        post_command_buffer = current_frame->compute_command_buffer;
+        VK_CHECK(vkResetCommandBuffer(post_command_buffer, 0));
+        VK_CHECK(vkBeginCommandBuffer(post_command_buffer, &begin_info));
+    }
 
-        vkCmdPushConstants(command_buffer, renderer->transparent_graphics_pipeline.pipeline_layout, VK_SHADER_STAGE_ALL, 0, sizeof(DrawPushConstants),
-                           &push_constants);
+    // POST PROCESSING
 
-        vkCmdBindIndexBuffer(command_buffer, transparent_draw.index_buffer.buffer, 0, transparent_draw.index_type);
-        vkCmdDrawIndexed(command_buffer, transparent_draw.index_count, 1, 0, 0, 0);
-    }
+    TRACE_ZONE_BEGIN("record_post_processing");
 
-    vkCmdEndRenderingKHR(command_buffer);
+    // generate exposure histogram from a 1 / exposure_metering_scale resolution view of the hdr image
 
-    // POST PROCESSING
+    const bool     metering_report = renderer->options.exposure_metering_report;
+    const uint32_t metering_scale  = renderer->options.exposure_metering_scale;
 
-    // generate exposure histogram
+    gpu_profiler_begin_pass(&renderer->gpu_profiler, post_command_buffer, frame_index, GpuPass::build_histogram);
 
-    vkCmdFillBuffer(command_buffer, renderer->exposure_histogram.buffer, 0, VK_WHOLE_SIZE, 0);
+    vkCmdFillBuffer(post_command_buffer, renderer->exposure_histogram.buffer, 0, VK_WHOLE_SIZE, 0);
 
-    const VkImageMemoryBarrier2 luminance_read_image_memory_barrier =
+    VkImageMemoryBarrier2 luminance_read_image_memory_barrier =
         vk_lib::image_memory_barrier_2(renderer->resolve_color_image.image, color_subresource_range, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
                                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR,
                                        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_2_SHADER_READ_BIT);
+    // acquire side of the release above. the main pass is already ordered before it by the semaphore between the submits
+    if (async_compute) {
+        luminance_read_image_memory_barrier.srcStageMask        = VK_PIPELINE_STAGE_2_NONE;
+        luminance_read_image_memory_barrier.srcAccessMask       = VK_ACCESS_2_NONE;
+        luminance_read_image_memory_barrier.srcQueueFamilyIndex = vk_ctx->queue_family;
+        luminance_read_image_memory_barrier.dstQueueFamilyIndex = vk_ctx->compute_queue_family;
+    }
 
     const VkBufferMemoryBarrier2 histogram_write_buffer_memory_barrier =
         vk_lib::buffer_memory_barrier_2(renderer->exposure_histogram.buffer, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
@@ -1272,33 +3493,25 @@ void renderer_draw(Renderer* renderer) {
     const VkDependencyInfo build_histogram_dependency_info =
         vk_lib::dependency_info(&luminance_read_image_memory_barrier, &histogram_write_buffer_memory_barrier, nullptr);
 
-    vkCmdPipelineBarrier2(command_buffer, &build_histogram_dependency_info);
+    vkCmdPipelineBarrier2(post_command_buffer, &build_histogram_dependency_info);
 
-    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, renderer->build_exposure_hist_compute_pipeline.pipeline);
+    renderer_record_exposure_histogram(renderer, post_command_buffer, renderer->exposure_histogram.address, metering_scale);
 
-    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, renderer->build_exposure_hist_compute_pipeline.pipeline_layout, 0, 1,
-                            &renderer->build_histogram_descriptor_set, 0, nullptr);
+    gpu_profiler_end_pass(&renderer->gpu_profiler, post_command_buffer, frame_index, GpuPass::build_histogram);
 
-    BuildHistPushConstants histogram_constants;
-    histogram_constants.histogram_buf_address = renderer->exposure_histogram.address;
-    histogram_constants.view_width            = renderer->swapchain_context.extent.width;
-    histogram_constants.view_height           = renderer->swapchain_context.extent.height;
+    // the full resolution reference stays outside the profiled pass so build_histogram only times the metering in use
+    if (metering_report) {
+        vkCmdFillBuffer(post_command_buffer, renderer->reference_exposure_histogram.buffer, 0, VK_WHOLE_SIZE, 0);
 
-    vkCmdPushConstants(command_buffer, renderer->build_exposure_hist_compute_pipeline.pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
-                       sizeof(BuildHistPushConstants), &histogram_constants);
+        const VkBufferMemoryBarrier2 reference_histogram_write_buffer_memory_barrier = vk_lib::buffer_memory_barrier_2(
+            renderer->reference_exposure_histogram.buffer, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+            VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT);
+        const VkDependencyInfo reference_histogram_dependency_info =
+            vk_lib::dependency_info(nullptr, &reference_histogram_write_buffer_memory_barrier, nullptr);
+        vkCmdPipelineBarrier2(post_command_buffer, &reference_histogram_dependency_info);
 
-    uint32_t width         = renderer->swapchain_context.extent.width;
-    uint32_t height        = renderer->swapchain_context.extent.height;
-    uint32_t work_groups_x = width / 16;
-    uint32_t work_groups_y = height / 16;
-    if (width % 16 != 0) {
-        work_groups_x++;
+        renderer_record_exposure_histogram(renderer, post_command_buffer, renderer->reference_exposure_histogram.address, 1);
     }
-    if (height % 16 != 0) {
-        work_groups_y++;
-    }
-
-    vkCmdDispatch(command_buffer, work_groups_x, work_groups_y, 1);
 
     // find exposure histogram average luminance
 
@@ -1314,98 +3527,243 @@ void renderer_draw(Renderer* renderer) {
 
     const VkDependencyInfo avg_exposure_histogram_dependency_info = vk_lib::dependency_info_batch({}, avg_luminance_mem_barriers, {});
 
-    vkCmdPipelineBarrier2(command_buffer, &avg_exposure_histogram_dependency_info);
+    vkCmdPipelineBarrier2(post_command_buffer, &avg_exposure_histogram_dependency_info);
+
+    gpu_profiler_begin_pass(&renderer->gpu_profiler, post_command_buffer, frame_index, GpuPass::average_histogram);
+
+    vkCmdBindPipeline(post_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, renderer->average_exposure_hist_compute_pipeline.pipeline);
 
-    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, renderer->average_exposure_hist_compute_pipeline.pipeline);
+    // one histogram sample per metering block
+    const uint32_t metering_width  = (renderer->render_extent.width + metering_scale - 1) / metering_scale;
+    const uint32_t metering_height = (renderer->render_extent.height + metering_scale - 1) / metering_scale;
 
     AverageHistPushConstants avg_hist_push_constants{};
-    avg_hist_push_constants.pixel_count               = width * height;
+    avg_hist_push_constants.pixel_count               = metering_width * metering_height;
     avg_hist_push_constants.histogram_buf_address     = renderer->exposure_histogram.address;
     avg_hist_push_constants.luminance_avg_buf_address = renderer->average_luminance_buf.address;
     avg_hist_push_constants.delta_time                = renderer->frame_time;
 
-    vkCmdPushConstants(command_buffer, renderer->average_exposure_hist_compute_pipeline.pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+    vkCmdPushConstants(post_command_buffer, renderer->average_exposure_hist_compute_pipeline.pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
                        sizeof(AverageHistPushConstants), &avg_hist_push_constants);
 
-    vkCmdDispatch(command_buffer, 1, 1, 1);
+    vkCmdDispatch(post_command_buffer, 1, 1, 1);
+
+    gpu_profiler_end_pass(&renderer->gpu_profiler, post_command_buffer, frame_index, GpuPass::average_histogram);
+
+    // both histograms are compared on the host once this frame slot comes around again
+    if (metering_report) {
+        const VkBufferMemoryBarrier2 metered_histogram_read_buffer_memory_barrier =
+            vk_lib::buffer_memory_barrier_2(renderer->exposure_histogram.buffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_2_COPY_BIT,
+                                            VK_ACCESS_2_SHADER_WRITE_BIT, VK_ACCESS_2_TRANSFER_READ_BIT);
+        const VkBufferMemoryBarrier2 reference_histogram_read_buffer_memory_barrier = vk_lib::buffer_memory_barrier_2(
+            renderer->reference_exposure_histogram.buffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_2_COPY_BIT,
+            VK_ACCESS_2_SHADER_WRITE_BIT, VK_ACCESS_2_TRANSFER_READ_BIT);
+
+        std::array histogram_readback_buffer_memory_barriers = {metered_histogram_read_buffer_memory_barrier,
+                                                                reference_histogram_read_buffer_memory_barrier};
+        const VkDependencyInfo histogram_readback_dependency_info = vk_lib::dependency_info_batch({}, histogram_readback_buffer_memory_barriers, {});
+        vkCmdPipelineBarrier2(post_command_buffer, &histogram_readback_dependency_info);
+
+        const AllocatedBuffer* metering_readback_buffer = &renderer->metering_readback_buffers[frame_index];
+        const VkBufferCopy     metered_histogram_copy   = vk_lib::buffer_copy(exposure_histogram_bin_count * sizeof(uint32_t));
+        const VkBufferCopy     reference_histogram_copy =
+            vk_lib::buffer_copy(exposure_histogram_bin_count * sizeof(uint32_t), 0, exposure_histogram_bin_count * sizeof(uint32_t));
+        vkCmdCopyBuffer(post_command_buffer, renderer->exposure_histogram.buffer, metering_readback_buffer->buffer, 1, &metered_histogram_copy);
+        vkCmdCopyBuffer(post_command_buffer, renderer->reference_exposure_histogram.buffer, metering_readback_buffer->buffer, 1,
+                        &reference_histogram_copy);
+
+        const VkBufferMemoryBarrier2 metering_readback_buffer_memory_barrier =
+            vk_lib::buffer_memory_barrier_2(metering_readback_buffer->buffer, VK_PIPELINE_STAGE_2_COPY_BIT, VK_PIPELINE_STAGE_2_HOST_BIT,
+                                            VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_ACCESS_2_HOST_READ_BIT);
+        const VkDependencyInfo metering_readback_dependency_info =
+            vk_lib::dependency_info(nullptr, &metering_readback_buffer_memory_barrier, nullptr);
+        vkCmdPipelineBarrier2(post_command_buffer, &metering_readback_dependency_info);
+    }
 
-    // final color correction (exposure and tone mapping)
+    // final color correction (exposure and tone mapping). writes straight into the swapchain image, or the offscreen target when
+    // headless, instead of correcting the hdr image in place and blitting it over
 
-    const VkBufferMemoryBarrier2 avg_luminance_read_buffer_memory_barrier =
-        vk_lib::buffer_memory_barrier_2(renderer->average_luminance_buf.buffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
-                                        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_ACCESS_2_SHADER_READ_BIT);
+    VkImage     output_image      = headless ? renderer->headless_target_image.image : swapchain_ctx->images[swapchain_image_index];
+    VkImageView output_image_view = headless ? renderer->headless_target_image.image_view : swapchain_ctx->image_views[swapchain_image_index];
+    VkFormat    output_format     = headless ? renderer->headless_target_image.image_format : swapchain_ctx->surface_format.format;
+    const bool  output_storage    = renderer_output_storage(renderer);
+
+    // a compute only queue can't name the fragment stage
+    const VkPipelineStageFlags2 tone_map_stage = output_storage ? VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+
+    const VkBufferMemoryBarrier2 avg_luminance_read_buffer_memory_barrier = vk_lib::buffer_memory_barrier_2(
+        renderer->average_luminance_buf.buffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, tone_map_stage | VK_PIPELINE_STAGE_2_COPY_BIT,
+        VK_ACCESS_2_SHADER_WRITE_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_TRANSFER_READ_BIT);
 
-    const VkImageMemoryBarrier2 hdr_image_correction_memory_barrier =
-        vk_lib::image_memory_barrier_2(renderer->resolve_color_image.image, color_subresource_range, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-                                       VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
-                                       VK_ACCESS_2_SHADER_READ_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT);
+    const VkDependencyInfo color_correct_dependency_info = vk_lib::dependency_info(nullptr, &avg_luminance_read_buffer_memory_barrier, nullptr);
 
-    const VkDependencyInfo color_correct_dependency_info =
-        vk_lib::dependency_info(&hdr_image_correction_memory_barrier, &avg_luminance_read_buffer_memory_barrier, nullptr);
+    vkCmdPipelineBarrier2(post_command_buffer, &color_correct_dependency_info);
 
-    vkCmdPipelineBarrier2(command_buffer, &color_correct_dependency_info);
+    // read on the host the next time this frame slot comes around
+    const AllocatedBuffer* readback_buffer         = &renderer->luminance_readback_buffers[frame_index];
+    const VkBufferCopy     luminance_readback_copy = vk_lib::buffer_copy(sizeof(float));
+    vkCmdCopyBuffer(post_command_buffer, renderer->average_luminance_buf.buffer, readback_buffer->buffer, 1, &luminance_readback_copy);
 
-    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, renderer->color_correct_compute_pipeline.pipeline);
+    const VkBufferMemoryBarrier2 luminance_readback_buffer_memory_barrier =
+        vk_lib::buffer_memory_barrier_2(readback_buffer->buffer, VK_PIPELINE_STAGE_2_COPY_BIT, VK_PIPELINE_STAGE_2_HOST_BIT,
+                                        VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_ACCESS_2_HOST_READ_BIT);
+    const VkDependencyInfo luminance_readback_dependency_info = vk_lib::dependency_info(nullptr, &luminance_readback_buffer_memory_barrier, nullptr);
+    vkCmdPipelineBarrier2(post_command_buffer, &luminance_readback_dependency_info);
 
     ColorCorrectPushConstants color_correct_push_constants{};
     color_correct_push_constants.luminance_avg_buf_address = renderer->average_luminance_buf.address;
+    color_correct_push_constants.pre_exposure              = renderer->pre_exposure;
+    color_correct_push_constants.encode_srgb               = !is_srgb_format(output_format);
 
-    vkCmdPushConstants(command_buffer, renderer->color_correct_compute_pipeline.pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
-                       sizeof(ColorCorrectPushConstants), &color_correct_push_constants);
+    VkDescriptorSet color_correct_descriptor_set = renderer->color_correct_descriptor_sets[frame_index];
 
-    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, renderer->color_correct_compute_pipeline.pipeline_layout, 0, 1,
-                            &renderer->color_correct_descriptor_set, 0, nullptr);
+    gpu_profiler_begin_pass(&renderer->gpu_profiler, post_command_buffer, frame_index, GpuPass::color_correct);
 
-    vkCmdDispatch(command_buffer, work_groups_x, work_groups_y, 1);
+    if (output_storage) {
+        VkDescriptorImageInfo output_image_info = vk_lib::descriptor_image_info(output_image_view, VK_IMAGE_LAYOUT_GENERAL);
+        VkWriteDescriptorSet  output_image_write =
+            vk_lib::write_descriptor_set(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, color_correct_descriptor_set, &output_image_info);
+        vkUpdateDescriptorSets(vk_ctx->device, 1, &output_image_write, 0, nullptr);
 
-    // copy final resolve image to the swapchain
+        // the acquire semaphore is waited on at the compute stage, so the layout transition has to come after it
+        const VkImageMemoryBarrier2 output_write_image_memory_barrier =
+            vk_lib::image_memory_barrier_2(output_image, color_subresource_range, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+                                           VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_NONE,
+                                           VK_ACCESS_2_SHADER_WRITE_BIT);
+        const VkDependencyInfo output_write_dependency_info = vk_lib::dependency_info(&output_write_image_memory_barrier, nullptr, nullptr);
+        vkCmdPipelineBarrier2(post_command_buffer, &output_write_dependency_info);
 
-    const VkImageMemoryBarrier2 resolve_transfer_image_memory_barrier = vk_lib::image_memory_barrier_2(
-        renderer->resolve_color_image.image, color_subresource_range, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-        VK_PIPELINE_STAGE_2_NONE, VK_PIPELINE_STAGE_2_BLIT_BIT, VK_ACCESS_2_NONE, VK_ACCESS_2_MEMORY_READ_BIT);
+        vkCmdBindPipeline(post_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, renderer->color_correct_compute_pipeline.pipeline);
 
-    VkImage swapchain_image = swapchain_ctx->images[swapchain_image_index];
+        vkCmdPushConstants(post_command_buffer, renderer->color_correct_compute_pipeline.pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                           sizeof(ColorCorrectPushConstants), &color_correct_push_constants);
 
-    const VkImageMemoryBarrier2 swapchain_transfer_image_memory_barrier =
-        vk_lib::image_memory_barrier_2(swapchain_image, color_subresource_range, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                       VK_PIPELINE_STAGE_2_NONE, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_NONE, VK_ACCESS_2_MEMORY_WRITE_BIT);
+        vkCmdBindDescriptorSets(post_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, renderer->color_correct_compute_pipeline.pipeline_layout, 0, 1,
+                                &color_correct_descriptor_set, 0, nullptr);
 
-    std::array present_transfer_barriers = {resolve_transfer_image_memory_barrier, swapchain_transfer_image_memory_barrier};
+        vkCmdDispatch(post_command_buffer, (renderer->render_extent.width + 15) / 16, (renderer->render_extent.height + 15) / 16, 1);
+    } else {
+        const VkImageMemoryBarrier2 output_write_image_memory_barrier = vk_lib::image_memory_barrier_2(
+            output_image, color_subresource_range, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, VK_ACCESS_2_NONE,
+            VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+        const VkDependencyInfo output_write_dependency_info = vk_lib::dependency_info(&output_write_image_memory_barrier, nullptr, nullptr);
+        vkCmdPipelineBarrier2(post_command_buffer, &output_write_dependency_info);
 
-    const VkDependencyInfo present_transfer_dependency_info = vk_lib::dependency_info_batch(present_transfer_barriers, {}, {});
+        // every pixel is written, so nothing needs loading
+        VkRenderingAttachmentInfo output_attachment_info = vk_lib::rendering_attachment_info(
+            output_image_view, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_STORE);
+        std::array         output_attachment_infos = {output_attachment_info};
+        VkRenderingInfoKHR tone_map_rendering_info = vk_lib::rendering_info(render_area, output_attachment_infos, nullptr);
 
-    vkCmdPipelineBarrier2(command_buffer, &present_transfer_dependency_info);
+        vkCmdBeginRenderingKHR(post_command_buffer, &tone_map_rendering_info);
 
-    VkImageSubresourceLayers image_subresource_layers = vk_lib::image_subresource_layers(VK_IMAGE_ASPECT_COLOR_BIT);
-    std::array               blit_offsets  = {vk_lib::offset_3d(), vk_lib::offset_3d(static_cast<int32_t>(renderer->swapchain_context.extent.width),
-                                                                                     static_cast<int32_t>(renderer->swapchain_context.extent.height), 1)};
-    VkImageBlit presentation_transfer_blit = vk_lib::image_blit(image_subresource_layers, image_subresource_layers, blit_offsets, blit_offsets);
+        vkCmdBindPipeline(post_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->tone_map_graphics_pipeline.pipeline);
 
-    vkCmdBlitImage(command_buffer, renderer->resolve_color_image.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, swapchain_image,
-                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &presentation_transfer_blit, VK_FILTER_LINEAR);
+        vkCmdPushConstants(post_command_buffer, renderer->tone_map_graphics_pipeline.pipeline_layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+                           sizeof(ColorCorrectPushConstants), &color_correct_push_constants);
 
-    const VkImageMemoryBarrier2 swapchain_present_image_memory_barrier = vk_lib::image_memory_barrier_2(
-        swapchain_image, color_subresource_range, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_2_BLIT_BIT,
-        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_ACCESS_2_MEMORY_READ_BIT);
+        vkCmdBindDescriptorSets(post_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->tone_map_graphics_pipeline.pipeline_layout, 0, 1,
+                                &color_correct_descriptor_set, 0, nullptr);
 
-    VkDependencyInfo swapchain_present_dependency_info = vk_lib::dependency_info(&swapchain_present_image_memory_barrier, nullptr, nullptr);
-    vkCmdPipelineBarrier2(command_buffer, &swapchain_present_dependency_info);
+        vkCmdSetViewport(post_command_buffer, 0, 1, &viewport);
+        vkCmdSetScissor(post_command_buffer, 0, 1, &scissor);
 
-    VK_CHECK(vkEndCommandBuffer(command_buffer));
+        vkCmdDraw(post_command_buffer, 3, 1, 0, 0);
+
+        vkCmdEndRenderingKHR(post_command_buffer);
+    }
+
+    gpu_profiler_end_pass(&renderer->gpu_profiler, post_command_buffer, frame_index, GpuPass::color_correct);
+
+    // the headless target stays readable by transfers so it can be saved after the frame
+    const VkImageLayout         output_layout = output_storage ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    const VkImageLayout         final_layout  = headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    const VkPipelineStageFlags2 output_stage =
+        output_storage ? VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR;
+    const VkAccessFlags2 output_access = output_storage ? VK_ACCESS_2_SHADER_WRITE_BIT : VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+
+    const VkImageMemoryBarrier2 output_present_image_memory_barrier =
+        vk_lib::image_memory_barrier_2(output_image, color_subresource_range, output_layout, final_layout, output_stage,
+                                       VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, output_access, VK_ACCESS_2_MEMORY_READ_BIT);
+
+    VkDependencyInfo output_present_dependency_info = vk_lib::dependency_info(&output_present_image_memory_barrier, nullptr, nullptr);
+    vkCmdPipelineBarrier2(post_command_buffer, &output_present_dependency_info);
 
-    VkCommandBufferSubmitInfo command_buffer_submit_info = vk_lib::command_buffer_submit_info(current_frame->command_buffer);
-    VkSemaphoreSubmitInfo     wait_semaphore_submit_info =
-        vk_lib::semaphore_submit_info(current_frame->image_available_semaphore, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR);
-    VkSemaphoreSubmitInfo signal_semaphore_submit_info =
-        vk_lib::semaphore_submit_info(current_frame->render_finished_semaphore, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR);
+    TRACE_ZONE_END();
 
-    VkSubmitInfo2 submit_info_2 = vk_lib::submit_info_2(&command_buffer_submit_info, &wait_semaphore_submit_info, &signal_semaphore_submit_info);
+    VK_CHECK(vkEndCommandBuffer(post_command_buffer));
 
-    VK_CHECK(vkQueueSubmit2(vk_ctx->graphics_queue, 1, &submit_info_2, current_frame->in_flight_fence));
+    TRACE_ZONE_BEGIN("queue_submit");
+
+    std::vector<VkSemaphoreSubmitInfo> post_wait_semaphore_submit_infos{};
+    std::vector<VkSemaphoreSubmitInfo> post_signal_semaphore_submit_infos{};
+
+    if (headless) {
+        renderer->headless_target_image.layout = final_layout;
+    } else {
+        // only the tone map touches the swapchain image, so everything before it can run ahead of the acquire
+        const VkPipelineStageFlags2 image_available_stage =
+            output_storage ? VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR;
+        post_wait_semaphore_submit_infos.push_back(vk_lib::semaphore_submit_info(current_frame->image_available_semaphore, image_available_stage));
+        post_signal_semaphore_submit_infos.push_back(
+            vk_lib::semaphore_submit_info(current_frame->render_finished_semaphore, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT));
+    }
+
+    VkSemaphoreSubmitInfo upload_wait_semaphore_submit_info =
+        vk_lib::semaphore_submit_info(renderer->upload_manager.timeline_semaphore, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT);
+    upload_wait_semaphore_submit_info.value = upload_wait_value;
+
+    if (async_compute) {
+        // the previous frame's post processing only has to be done before this frame's main pass overwrites the resolve image
+        VkSemaphoreSubmitInfo compute_wait_semaphore_submit_info =
+            vk_lib::semaphore_submit_info(renderer->compute_timeline_semaphore, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR);
+        compute_wait_semaphore_submit_info.value = renderer->compute_timeline_value;
+        VkSemaphoreSubmitInfo graphics_signal_semaphore_submit_info =
+            vk_lib::semaphore_submit_info(current_frame->graphics_finished_semaphore, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT);
+
+        const std::array graphics_wait_semaphore_submit_infos = {compute_wait_semaphore_submit_info, upload_wait_semaphore_submit_info};
+
+        VkCommandBufferSubmitInfo graphics_command_buffer_submit_info = vk_lib::command_buffer_submit_info(command_buffer);
+        VkSubmitInfo2             graphics_submit_info_2 =
+            vk_lib::submit_info_2(&graphics_command_buffer_submit_info, nullptr, &graphics_signal_semaphore_submit_info);
+        graphics_submit_info_2.waitSemaphoreInfoCount = graphics_wait_semaphore_submit_infos.size();
+        graphics_submit_info_2.pWaitSemaphoreInfos    = graphics_wait_semaphore_submit_infos.data();
+        VK_CHECK(vkQueueSubmit2(vk_ctx->graphics_queue, 1, &graphics_submit_info_2, nullptr));
+
+        renderer->compute_timeline_value++;
+        VkSemaphoreSubmitInfo compute_signal_semaphore_submit_info =
+            vk_lib::semaphore_submit_info(renderer->compute_timeline_semaphore, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT);
+        compute_signal_semaphore_submit_info.value = renderer->compute_timeline_value;
+
+        post_wait_semaphore_submit_infos.push_back(
+            vk_lib::semaphore_submit_info(current_frame->graphics_finished_semaphore, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT));
+        post_signal_semaphore_submit_infos.push_back(compute_signal_semaphore_submit_info);
+    } else {
+        post_wait_semaphore_submit_infos.push_back(upload_wait_semaphore_submit_info);
+    }
+
+    // the post processing submit waits on the graphics submit when it's separate, so its fence covers the whole frame
+    VkCommandBufferSubmitInfo post_command_buffer_submit_info = vk_lib::command_buffer_submit_info(post_command_buffer);
+    VkSubmitInfo2             post_submit_info_2              = vk_lib::submit_info_2(&post_command_buffer_submit_info);
+    post_submit_info_2.waitSemaphoreInfoCount                 = post_wait_semaphore_submit_infos.size();
+    post_submit_info_2.pWaitSemaphoreInfos                    = post_wait_semaphore_submit_infos.data();
+    post_submit_info_2.signalSemaphoreInfoCount               = post_signal_semaphore_submit_infos.size();
+    post_submit_info_2.pSignalSemaphoreInfos                  = post_signal_semaphore_submit_infos.data();
+
+    VK_CHECK(vkQueueSubmit2(vk_ctx->compute_queue, 1, &post_submit_info_2, current_frame->in_flight_fence));
+    TRACE_ZONE_END();
+
+    if (headless) {
+        renderer->curr_frame++;
+        return;
+    }
 
     VkPresentInfoKHR present = vk_lib::present_info(&swapchain_ctx->swapchain, &swapchain_image_index, &current_frame->render_finished_semaphore);
 
+    TRACE_ZONE_BEGIN("queue_present");
     swapchain_result = vkQueuePresentKHR(vk_ctx->present_queue, &present);
+    TRACE_ZONE_END();
 
     if (swapchain_result == VK_ERROR_OUT_OF_DATE_KHR || swapchain_result == VK_SUBOPTIMAL_KHR) {
         renderer_resize_screen(renderer);
@@ -1416,7 +3774,7 @@ void renderer_draw(Renderer* renderer) {
 
 void renderer_recompile_pipelines(Renderer* renderer) {
     VkDevice device = renderer->vk_context.device;
-    vkDeviceWaitIdle(renderer->vk_context.device);
+    vk_context_wait_idle(&renderer->vk_context);
     if (renderer->opaque_graphics_pipeline.pipeline) {
         vkDestroyPipeline(device, renderer->opaque_graphics_pipeline.pipeline, nullptr);
     }
@@ -1449,10 +3807,40 @@ void renderer_recompile_pipelines(Renderer* renderer) {
     if (renderer->depth_pre_graphics_pipeline.pipeline_layout) {
         vkDestroyPipelineLayout(device, renderer->depth_pre_graphics_pipeline.pipeline_layout, nullptr);
     }
+    // indirect pipelines share layouts and shaders in pairs, same as above
+    for (const GraphicsPipeline* pipeline : {&renderer->indirect_opaque_graphics_pipeline, &renderer->indirect_transparent_graphics_pipeline,
+                                             &renderer->indirect_shadow_map_graphics_pipeline, &renderer->indirect_depth_pre_graphics_pipeline}) {
+        if (pipeline->pipeline) {
+            vkDestroyPipeline(device, pipeline->pipeline, nullptr);
+        }
+    }
+    if (renderer->indirect_opaque_graphics_pipeline.pipeline_layout) {
+        vkDestroyPipelineLayout(device, renderer->indirect_opaque_graphics_pipeline.pipeline_layout, nullptr);
+    }
+    if (renderer->indirect_opaque_graphics_pipeline.vert_shader) {
+        vkDestroyShaderModule(device, renderer->indirect_opaque_graphics_pipeline.vert_shader, nullptr);
+    }
+    if (renderer->indirect_shadow_map_graphics_pipeline.pipeline_layout) {
+        vkDestroyPipelineLayout(device, renderer->indirect_shadow_map_graphics_pipeline.pipeline_layout, nullptr);
+    }
+    if (renderer->indirect_shadow_map_graphics_pipeline.vert_shader) {
+        vkDestroyShaderModule(device, renderer->indirect_shadow_map_graphics_pipeline.vert_shader, nullptr);
+    }
+    if (renderer->tone_map_graphics_pipeline.pipeline) {
+        vkDestroyPipeline(device, renderer->tone_map_graphics_pipeline.pipeline, nullptr);
+        vkDestroyPipelineLayout(device, renderer->tone_map_graphics_pipeline.pipeline_layout, nullptr);
+        vkDestroyShaderModule(device, renderer->tone_map_graphics_pipeline.vert_shader, nullptr);
+        vkDestroyShaderModule(device, renderer->tone_map_graphics_pipeline.frag_shader, nullptr);
+        renderer->tone_map_graphics_pipeline = {};
+    }
 
     renderer_create_graphics_pipelines(renderer);
+    pipeline_cache_save(device, renderer->vk_context.physical_device, renderer->pipeline_cache, pipeline_cache_path);
+    renderer_invalidate_shadow_map(renderer);
 }
 
+void renderer_invalidate_shadow_map(Renderer* renderer) { renderer->shadow_map_dirty = true; }
+
 void renderer_key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
     if (key == GLFW_KEY_R) {
         if (action == GLFW_PRESS) {
@@ -1460,60 +3848,199 @@ void renderer_key_callback(GLFWwindow* window, int key, int scancode, int action
             renderer_recompile_pipelines(active_renderer);
         }
     }
+    if (key == GLFW_KEY_G) {
+        if (action == GLFW_PRESS) {
+            if (!active_renderer->vk_context.draw_indirect_count) {
+                std::cout << "GPU driven drawing unavailable: the device can't draw indirect with a count" << std::endl;
+                return;
+            }
+            active_renderer->gpu_driven = !active_renderer->gpu_driven;
+            std::cout << (active_renderer->gpu_driven ? "GPU driven drawing enabled" : "GPU driven drawing disabled") << std::endl;
+        }
+    }
 }
 
-void renderer_create(Renderer* renderer) {
+void renderer_create(Renderer* renderer, const RendererOptions* options) {
 
     if (active_renderer != nullptr) {
         abort_message("Cannot create multiple renderers");
     }
 
-    *renderer = Renderer{};
+    TRACE_ZONE("renderer_create");
 
-    renderer->window     = window_create();
-    renderer->vk_context = vk_context_create(renderer->window.glfw_window);
+    *renderer            = Renderer{};
+    renderer->options    = *options;
+    renderer->gpu_driven = options->gpu_driven;
+
+    TRACE_ZONE_BEGIN("create_window_and_context");
+    // headless renderers never touch GLFW. the window handle stays null
+    if (!options->headless) {
+        renderer->window = window_create();
+    }
+    renderer->vk_context = vk_context_create(renderer->window.glfw_window, options->async_compute);
     VkContext* vk_ctx    = &renderer->vk_context;
 
-    renderer->swapchain_context = swapchain_context_create(vk_ctx->physical_device, vk_ctx->device, vk_ctx->surface, renderer->window.glfw_window);
-    const SwapchainContext* swapchain_ctx = &renderer->swapchain_context;
+    if (renderer->gpu_driven && !vk_ctx->draw_indirect_count) {
+        std::cout << "GPU driven drawing disabled: the device can't draw indirect with a count" << std::endl;
+        renderer->gpu_driven = false;
+    }
+
+    uint32_t frame_count = headless_frame_count;
+    if (options->headless) {
+        renderer->render_extent = options->headless_extent;
+    } else {
+        renderer->swapchain_context = swapchain_context_create(vk_ctx->physical_device, vk_ctx->device, vk_ctx->surface,
+                                                               renderer->window.glfw_window, renderer_queue_families(vk_ctx));
+        renderer->render_extent     = renderer->swapchain_context.extent;
+        frame_count                 = renderer->swapchain_context.images.size();
+    }
+    validate_async_compute(renderer);
+    TRACE_ZONE_END();
 
     const VkCommandPoolCreateInfo command_pool_ci =
         vk_lib::command_pool_create_info(vk_ctx->queue_family, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
     vkCreateCommandPool(vk_ctx->device, &command_pool_ci, nullptr, &vk_ctx->frame_command_pool);
 
+    vk_ctx->compute_command_pool = vk_ctx->frame_command_pool;
+    if (vk_context_has_async_compute(vk_ctx)) {
+        const VkCommandPoolCreateInfo compute_command_pool_ci =
+            vk_lib::command_pool_create_info(vk_ctx->compute_queue_family, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+        vkCreateCommandPool(vk_ctx->device, &compute_command_pool_ci, nullptr, &vk_ctx->compute_command_pool);
+
+        VkSemaphoreTypeCreateInfo timeline_semaphore_type_ci{};
+        timeline_semaphore_type_ci.sType         = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        timeline_semaphore_type_ci.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+
+        VkSemaphoreCreateInfo timeline_semaphore_ci = vk_lib::semaphore_create_info();
+        timeline_semaphore_ci.pNext                 = &timeline_semaphore_type_ci;
+        VK_CHECK(vkCreateSemaphore(vk_ctx->device, &timeline_semaphore_ci, nullptr, &renderer->compute_timeline_semaphore));
+    }
+
     renderer->allocator = allocator_create(&renderer->vk_context);
+    upload_manager_create(&renderer->upload_manager, vk_ctx->device, renderer->allocator, vk_ctx->transfer_queue, vk_ctx->transfer_queue_family,
+                          vk_ctx->queue_family, upload_staging_capacity);
 
+    TRACE_ZONE_BEGIN("create_render_resources");
+    validate_hdr_format(renderer);
+    validate_exposure_metering(renderer);
     create_render_resources(renderer);
+    TRACE_ZONE_END();
 
-    renderer->frames = frames_create(vk_ctx->device, vk_ctx->frame_command_pool, swapchain_ctx->image_views, swapchain_ctx->images,
-                                     vk_ctx->queue_family, renderer->msaa_color_image.image_view);
+    renderer->frames = frames_create(vk_ctx->device, vk_ctx->frame_command_pool, vk_ctx->compute_command_pool, frame_count);
+
+    uint32_t record_thread_count = options->record_thread_count;
+    if (record_thread_count == 0) {
+        record_thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    record_thread_count  = std::min(record_thread_count, max_record_thread_count);
+    renderer->job_system = std::make_unique<JobSystem>();
+    job_system_create(renderer->job_system.get(), record_thread_count - 1);
+    recording_contexts_create(renderer, frame_count);
 
+    renderer->shadow_cascade_count = std::clamp(options->shadow_cascade_count, 1u, max_shadow_cascade_count);
     renderer_init_shader_data(renderer);
 
     renderer_create_shadow_map(renderer);
 
+    renderer->pipeline_cache = pipeline_cache_load(vk_ctx->device, vk_ctx->physical_device, pipeline_cache_path);
     renderer_create_graphics_pipelines(renderer);
 
+    TRACE_ZONE_BEGIN("create_compute_resources");
     create_compute_resources(renderer);
+    create_indirect_draw_resources(renderer);
+    TRACE_ZONE_END();
 
     renderer_create_compute_pipelines(renderer);
+    pipeline_cache_save(vk_ctx->device, vk_ctx->physical_device, renderer->pipeline_cache, pipeline_cache_path);
 
     update_compute_descriptors(renderer);
 
-    // renderer_add_gltf_asset(renderer, "../assets/pkg_a_curtains/NewSponza_Curtains_glTF.gltf");
-    // renderer_add_gltf_asset(renderer, "../assets/main1_sponza/NewSponza_Main_glTF_003.gltf");
-    // renderer_add_gltf_asset(renderer, "../assets/pkg_b_ivy/NewSponza_IvyGrowth_glTF.gltf");
-    // renderer_add_gltf_asset(renderer, "../assets/pkg_c1_trees/NewSponza_CypressTree_glTF.gltf");
-    renderer_add_gltf_asset(renderer, "../assets/sponza/Sponza.gltf");
-    // renderer_add_gltf_asset(renderer, "../assets/DamagedHelmet.glb");
-    // renderer_add_gltf_asset(renderer, "../assets/structure_mat.glb");
-    // renderer_add_gltf_asset(renderer, "../assets/PictureClue.glb");
-    // renderer_add_gltf_asset(renderer, "../assets/porsche.glb");
-    // renderer_add_gltf_asset(renderer, "../assets/ClearCoatTest.glb");
-    // renderer_add_gltf_asset(renderer, "../assets/3d_field_inspection.glb");
-
-    float aspect_ratio = static_cast<float>(renderer->swapchain_context.extent.width) / static_cast<float>(renderer->swapchain_context.extent.height);
+    // workers encode geometry with the arena pipelines, so they start once those exist
+    if (vk_ctx->loader_queues.empty()) {
+        std::cout << "Background asset loading disabled: the graphics queue family has a single queue" << std::endl;
+    }
+    const bool compress_textures = renderer->options.compress_textures && vk_ctx->texture_compression_bc;
+    if (renderer->options.compress_textures && !compress_textures) {
+        std::cout << "Texture compression disabled: the device can't sample BC formats" << std::endl;
+    }
+    GeometryEncodePipelines geometry_pipelines{};
+    geometry_pipelines.arena_copy             = renderer->arena_copy_compute_pipeline.pipeline;
+    geometry_pipelines.arena_copy_layout      = renderer->arena_copy_compute_pipeline.pipeline_layout;
+    geometry_pipelines.encode_vertices        = renderer->encode_vertices_compute_pipeline.pipeline;
+    geometry_pipelines.encode_vertices_layout = renderer->encode_vertices_compute_pipeline.pipeline_layout;
+
+    renderer->asset_loader = std::make_unique<AssetLoader>();
+    asset_loader_create(renderer->asset_loader.get(), vk_ctx->device, renderer->allocator, vk_ctx->queue_family, vk_ctx->loader_queues,
+                        &geometry_pipelines, renderer->options.stream_textures, compress_textures, renderer->options.compact_vertices);
+
+    // renderer_load_gltf_asset(renderer, "../assets/pkg_a_curtains/NewSponza_Curtains_glTF.gltf");
+    // renderer_load_gltf_asset(renderer, "../assets/main1_sponza/NewSponza_Main_glTF_003.gltf");
+    // renderer_load_gltf_asset(renderer, "../assets/pkg_b_ivy/NewSponza_IvyGrowth_glTF.gltf");
+    // renderer_load_gltf_asset(renderer, "../assets/pkg_c1_trees/NewSponza_CypressTree_glTF.gltf");
+    gpu_profiler_create(&renderer->gpu_profiler, vk_ctx->physical_device, vk_ctx->device, renderer_queue_families(vk_ctx), frame_count,
+                        options->gpu_profiler_log_interval, options->gpu_profiler_csv_path);
+
+    renderer_load_gltf_asset(renderer, "../assets/sponza/Sponza.gltf");
+    // renderer_load_gltf_asset(renderer, "../assets/DamagedHelmet.glb");
+    // renderer_load_gltf_asset(renderer, "../assets/structure_mat.glb");
+    // renderer_load_gltf_asset(renderer, "../assets/PictureClue.glb");
+    // renderer_load_gltf_asset(renderer, "../assets/porsche.glb");
+    // renderer_load_gltf_asset(renderer, "../assets/ClearCoatTest.glb");
+    // renderer_load_gltf_asset(renderer, "../assets/3d_field_inspection.glb");
+
+    float aspect_ratio = static_cast<float>(renderer->render_extent.width) / static_cast<float>(renderer->render_extent.height);
     set_camera_proj(glm::radians(70.f), aspect_ratio);
 
     active_renderer = renderer;
+}
+
+void renderer_save_headless_image(Renderer* renderer, const std::filesystem::path& path) {
+    if (!renderer->options.headless || renderer->headless_target_image.layout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+        abort_message("No headless frame has been rendered to save");
+    }
+
+    VkDevice device = renderer->vk_context.device;
+    vk_context_wait_idle(&renderer->vk_context);
+
+    const uint32_t width  = renderer->headless_target_image.extent.width;
+    const uint32_t height = renderer->headless_target_image.extent.height;
+
+    VkBufferCreateInfo      readback_buf_ci = vk_lib::buffer_create_info(VK_BUFFER_USAGE_TRANSFER_DST_BIT, width * height * 4);
+    VmaAllocationCreateInfo readback_buf_allocation_ci{};
+    readback_buf_allocation_ci.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+    readback_buf_allocation_ci.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT;
+    AllocatedBuffer readback_buffer;
+    VK_CHECK(vmaCreateBuffer(renderer->allocator, &readback_buf_ci, &readback_buf_allocation_ci, &readback_buffer.buffer, &readback_buffer.allocation,
+                             &readback_buffer.allocation_info));
+
+    // the tone map left the target owned by the compute queue's family
+    vk_command_immediate_submit(device, renderer->vk_context.compute_command_pool, renderer->vk_context.compute_queue, [&](VkCommandBuffer cmd_buf) {
+        VkImageSubresourceLayers image_subresource_layers = vk_lib::image_subresource_layers(VK_IMAGE_ASPECT_COLOR_BIT);
+        VkBufferImageCopy        copy_region              = vk_lib::buffer_image_copy(image_subresource_layers, renderer->headless_target_image.extent);
+        vkCmdCopyImageToBuffer(cmd_buf, renderer->headless_target_image.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback_buffer.buffer, 1,
+                               &copy_region);
+    });
+
+    VK_CHECK(vmaInvalidateAllocation(renderer->allocator, readback_buffer.allocation, 0, VK_WHOLE_SIZE));
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        abort_message("Failed to open headless image output file");
+    }
+    file << "P6\n" << width << " " << height << "\n255\n";
+
+    // PPM has no alpha channel, drop it
+    const auto*          pixels = static_cast<const uint8_t*>(readback_buffer.allocation_info.pMappedData);
+    std::vector<uint8_t> row(width * 3);
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            const uint8_t* pixel = &pixels[(y * width + x) * 4];
+            row[x * 3 + 0]       = pixel[0];
+            row[x * 3 + 1]       = pixel[1];
+            row[x * 3 + 2]       = pixel[2];
+        }
+        file.write(reinterpret_cast<const char*>(row.data()), row.size());
+    }
+
+    vmaDestroyBuffer(renderer->allocator, readback_buffer.buffer, readback_buffer.allocation);
 }
\ No newline at end of file
@@ -2,11 +2,24 @@
 #include "common.h"
 
 #include "window.h"
+#include <asset_loader.h>
+#include <culling.h>
+#include <draw_sort.h>
+#include <exposure_metering.h>
 #include <frame.h>
+#include <geometry_encoding.h>
+#include <gpu_profiler.h>
+#include <job_system.h>
+#include <pipeline_cache.h>
+#include <range_allocator.h>
 #include <swapchain.h>
+#include <trace.h>
+#include <upload_manager.h>
 #include <vk_context.h>
 #include <vk_gltf/loader.h>
 
+#include <memory>
+
 struct GraphicsPipeline {
     VkPipeline       pipeline{};
     VkPipelineLayout pipeline_layout{};
@@ -20,24 +33,39 @@ struct ComputePipeline {
     VkShaderModule   shader{};
 };
 
+inline constexpr uint32_t max_shadow_cascade_count = 4;
+
 struct SceneData {
     glm::mat4 view{};
     glm::mat4 proj{};
-    glm::mat4 light_transform{};
-    glm::vec3 eye_pos{};
-    glm::vec3 sun_dir{};
+    // light view projection of each shadow cascade and the view space depth each cascade ends at
+    std::array<glm::mat4, max_shadow_cascade_count> cascade_transforms{};
+    glm::vec4                                       cascade_splits{};
+    glm::vec3                                       eye_pos{};
+    glm::vec3                                       sun_dir{};
+    uint32_t                                        cascade_count{};
+    // scales the main pass output so it keeps its precision in 16 and 11 bit hdr formats. see Renderer::pre_exposure
+    float pre_exposure{1.f};
 };
 
+// ordered so the std430 push constant block in common.glsl needs no padding
 struct DrawPushConstants {
     glm::mat4       model_transform{};
-    VkDeviceAddress vertex_buf_address{};
+    glm::vec3       position_base{};
     uint32_t        material_index{};
+    glm::vec3       position_scale{};
+    uint32_t        vertex_format{};
+    VkDeviceAddress vertex_buf_address{};
 };
 
+static_assert(sizeof(DrawPushConstants) == 104, "DrawPushConstants must match PushConstants in common.glsl");
+
 struct BuildHistPushConstants {
     VkDeviceAddress histogram_buf_address{};
     uint32_t        view_width{};
     uint32_t        view_height{};
+    float           pre_exposure{};
+    uint32_t        metering_scale{};
 };
 
 struct AverageHistPushConstants {
@@ -49,8 +77,83 @@ struct AverageHistPushConstants {
 
 struct ColorCorrectPushConstants {
     VkDeviceAddress luminance_avg_buf_address{};
+    float           pre_exposure{};
+    uint32_t        encode_srgb{};
+};
+
+struct IndirectDrawPushConstants {
+    VkDeviceAddress draw_buf_address{};
+    VkDeviceAddress vertex_buf_address{};
+};
+
+struct CullDrawsPushConstants {
+    VkDeviceAddress draw_buf_address{};
+    VkDeviceAddress command_buf_address{};
+    VkDeviceAddress count_buf_address{};
+    VkDeviceAddress cull_data_buf_address{};
+    uint32_t        draw_count{};
+    // also test each draw against the hi-z pyramid
+    uint32_t occlusion_cull{};
+};
+
+// matches CullData in cull_draws.comp
+struct GpuCullData {
+    std::array<glm::vec4, 6> frustum_planes{};
+    glm::mat4                view_proj{};
+    // size of hi-z mip 0 in texels
+    glm::vec2 hiz_extent{};
+    uint32_t  hiz_mip_count{};
+};
+
+static_assert(sizeof(GpuCullData) == 172, "GpuCullData must match the scalar layout of CullData");
+
+struct HizPushConstants {
+    VkExtent2D src_extent{};
+    VkExtent2D dst_extent{};
+};
+
+// per draw data read by the gpu cull shader and the indirect vertex shaders. matches DrawData in draw_data.glsl
+struct GpuDrawData {
+    glm::mat4 transform{};
+    uint32_t  material_index{};
+    uint32_t  first_index{};
+    uint32_t  index_count{};
+    int32_t   vertex_offset{};
+    uint32_t  batch{};
+    uint32_t  batch_first_command{};
+    glm::vec3 bounds_center{};
+    glm::vec3 bounds_half_extent{};
+    glm::vec3 position_base{};
+    glm::vec3 position_scale{};
+    uint32_t  vertex_format{};
+};
+
+static_assert(sizeof(GpuDrawData) == 140, "GpuDrawData must match the scalar layout of DrawData");
+
+// a copy into one of the geometry arena buffers
+struct GeometryArenaCopy {
+    VkBuffer     src_buffer{};
+    VkBuffer     dst_buffer{};
+    VkBufferCopy region{};
 };
 
+// every primitive's vertices and 32 bit indices live in two shared device local buffers. draws hold offsets into them so a
+// pass binds a single index buffer and indirect batches can span assets
+struct GeometryArena {
+    AllocatedBuffer vertex_buffer{};
+    AllocatedBuffer index_buffer{};
+    // in 32 bit words and indices, not bytes
+    RangeAllocator vertex_ranges{};
+    RangeAllocator index_ranges{};
+    // copies of encoded assets and of the old contents of a grown buffer, recorded in order at the start of the next frame
+    std::vector<GeometryArenaCopy> pending_copies{};
+};
+
+// indirect draws are grouped by the rasterizer state that can't come from the draw data. each batch is a single
+// indirect call per pass. opaque batches come first so shadow and depth passes can draw a prefix of them
+inline constexpr uint32_t indirect_opaque_batch_count = 4;
+inline constexpr uint32_t indirect_batch_count        = indirect_opaque_batch_count * 2;
+
 struct Material {
     vk_gltf::TextureInfo base_color_texture{};
     vk_gltf::TextureInfo metallic_roughness_texture{};
@@ -75,6 +178,36 @@ struct Material {
     float clearcoat_roughness_factor{};
 };
 
+// a freed range and the frame from which no frame in flight can read it anymore
+struct RetiringRange {
+    Range    range{};
+    uint64_t retire_frame{};
+};
+
+// a replaced buffer, destroyed at retire_frame
+struct RetiringBuffer {
+    AllocatedBuffer buffer{};
+    uint64_t        retire_frame{};
+};
+
+// every loaded material in one buffer. assets take a range of it and give it back when they're unloaded. materials is
+// the host copy, as long as the buffer, and dirty_ranges are the parts the next frame writes in place. freed ranges sit
+// in retiring until the frames that could read them are done
+struct MaterialStore {
+    AllocatedBuffer            buffer{};
+    RangeAllocator             slots{};
+    std::vector<Material>      materials{};
+    std::vector<Range>         dirty_ranges{};
+    std::vector<RetiringRange> retiring{};
+};
+
+// slots of the bindless tex_samplers array. assets take a range and give it back when they're unloaded. freed ranges sit
+// in retiring until the frames that could sample them are done. every slot nobody holds samples the default texture
+struct TextureTable {
+    RangeAllocator             slots{};
+    std::vector<RetiringRange> retiring{};
+};
+
 struct Texture {
     AllocatedImage image;
     VkSampler      sampler{nullptr};
@@ -85,87 +218,359 @@ struct Bounds {
     glm::vec3 extent{};
 };
 
+// index into Renderer::assets. stays valid through evictions and after the asset is unloaded
+using AssetHandle = uint32_t;
+
 // loosely matches a GltfPrimitive
 struct DrawObject {
     glm::mat4           transform{};
-    AllocatedBuffer     index_buffer{};
-    VkIndexType         index_type{};
-    uint32_t            index_count{};
-    AllocatedBuffer     vertex_buffer{};
+    ArenaGeometry       geometry{};
     Bounds              bounds{};
     VkFrontFace         front_face{};
     VkPrimitiveTopology topology{};
     bool                double_sided{};
     uint32_t            material_index{};
+    AssetHandle         asset{};
+};
+
+enum class AssetResidency : uint8_t {
+    // loading for the first time or again after an eviction
+    loading,
+    resident,
+    // unloaded to stay within the memory budget. it loads again once it's in view
+    evicted,
+    unloaded,
+};
+
+// an asset image uploaded from its host copy. image holds the source's mips from resident_mip down, so only what the
+// draws using it need takes device memory
+struct StreamedImage {
+    TextureSource  source{};
+    AllocatedImage image{};
+    uint32_t       resident_mip{};
+    // finest mip a draw using the image asked for this frame
+    uint32_t wanted_mip{};
+    // its textures can't move to their other slot again until the frames in flight at the last move are done
+    uint64_t swap_frame{};
+};
+
+// a streamed image that was replaced. its old texture slots keep pointing at it until retire_frame
+struct RetiringStreamedImage {
+    AllocatedImage        image{};
+    std::vector<uint32_t> slots{};
+    uint64_t              retire_frame{};
+};
+
+// an asset the renderer was asked to load. it keeps its path and bounds through evictions so it can come back. gltf_asset
+// and the ranges are only held while it's resident
+struct RendererAsset {
+    std::string    gltf_path{};
+    AssetResidency residency{};
+    // the latest load of this asset. its handle goes back to the loader once the load is taken
+    AssetLoadHandle load{};
+    bool            load_taken{};
+
+    vk_gltf::GltfAsset gltf_asset{};
+    Range              material_range{};
+    Range              texture_range{};
+    // one per primitive, shared by the draws that instance it
+    std::vector<ArenaGeometry> geometries{};
+    // parallel to gltf_asset.images. images without source mips weren't read back and are sampled as loaded
+    std::vector<StreamedImage> streamed_images{};
+    // the slot each texture samples through. a texture owns two neighbouring slots of texture_range and streaming swaps
+    // between them
+    std::vector<uint32_t> texture_slots{};
+    // images and geometry, what evicting the asset gives back
+    VkDeviceSize memory_size{};
+
+    // set once it's been resident, so evicted assets can be tested against the camera
+    bool     has_bounds{};
+    uint64_t last_visible_frame{};
+};
+
+// what an evicted or unloaded asset held. it's freed once no frame in flight can read it anymore
+struct RetiringAsset {
+    vk_gltf::GltfAsset          gltf_asset{};
+    std::vector<ArenaGeometry>  geometries{};
+    std::vector<AllocatedImage> streamed_images{};
+    VkDeviceSize                memory_size{};
+    uint64_t                    retire_frame{};
+};
+
+struct RendererOptions {
+    // render into an offscreen target without a window, surface or swapchain
+    bool       headless{};
+    VkExtent2D headless_extent{1920, 1080};
+
+    // format of the msaa and resolve color targets. R32G32B32A32_SFLOAT, R16G16B16A16_SFLOAT or B10G11R11_UFLOAT_PACK32
+    VkFormat hdr_format{VK_FORMAT_R16G16B16A16_SFLOAT};
+
+    // the exposure histogram meters a 1 / exposure_metering_scale resolution version of the hdr image. 1, 2, 4 or 8
+    uint32_t exposure_metering_scale{4};
+    // also build a full resolution histogram every frame and log how far the metered luminance is from it, at the gpu
+    // profiler log interval
+    bool exposure_metering_report{};
+    // run the exposure and tone map chain on a compute only queue, overlapping the next frame's shadow and depth pre-passes.
+    // needs such a queue family and a storage capable output, otherwise everything stays on the graphics queue
+    bool async_compute{};
+
+    // cull on the gpu and draw each pass with a few vkCmdDrawIndexedIndirectCount calls. toggled at runtime with G
+    bool gpu_driven{};
+    // on the gpu driven path, drop draws hidden behind the depth pre-pass from the main pass
+    bool occlusion_culling{true};
+
+    // store asset vertices in a compact format instead of the loader's 72 byte vertex
+    bool compact_vertices{true};
+
+    // threads recording the shadow, depth pre and main passes into secondary command buffers, the calling thread included.
+    // 0 picks one per hardware thread, up to max_record_thread_count
+    uint32_t record_thread_count{};
+
+    // cascades are layers of one depth array image, fitted to the camera frustum up to shadow_distance
+    uint32_t shadow_cascade_count{3};
+    uint32_t shadow_cascade_resolution{2048};
+    float    shadow_distance{60.f};
+
+    // upload asset textures at low resolution and stream finer mips in as the camera gets close enough to need them. the
+    // loader keeps a host copy of every mip chain
+    bool stream_textures{true};
+    // encode asset textures to bc7, bc5 and bc4 and cache the results next to the loader's. needs BC support
+    bool compress_textures{true};
+
+    // assets may take device local memory up to this fraction of the budget vma reports before the least recently visible
+    // ones are evicted. evicted assets load again once they're in view. 0 never evicts
+    float asset_memory_budget_fraction{0.9f};
+
+    // per-pass gpu timings. interval is in frames, 0 disables the periodic log. empty csv path disables the csv
+    uint32_t              gpu_profiler_log_interval{600};
+    std::filesystem::path gpu_profiler_csv_path{};
+};
+
+inline constexpr uint32_t max_record_thread_count = 8;
+
+// enough for a 32768 texel hi-z mip 0
+inline constexpr uint32_t max_hiz_mip_count = 16;
+
+// one per frame in flight per recording thread. the pool is reset wholesale once the frame's fence signals and its
+// secondary command buffers are handed out again from the start
+struct RecordingContext {
+    VkCommandPool                command_pool{};
+    std::vector<VkCommandBuffer> command_buffers{};
+    uint32_t                     used_count{};
 };
 
 struct Renderer {
+    RendererOptions  options{};
     VkContext        vk_context{};
     SwapchainContext swapchain_context{};
+    VkExtent2D       render_extent{};
 
     std::vector<Frame> frames{};
     Window             window{};
     uint64_t           curr_frame{};
 
+    // with async compute, post processing of frame N runs on vk_context.compute_queue. each compute submit signals the next
+    // value of compute_timeline_semaphore and frame N + 1's main pass waits for it before overwriting the resolve image
+    VkSemaphore compute_timeline_semaphore{};
+    uint64_t    compute_timeline_value{};
+
+    // held by pointer so the renderer stays movable
+    std::unique_ptr<JobSystem>   job_system{};
+    std::unique_ptr<AssetLoader> asset_loader{};
+    // frame_index * record thread count + thread_index
+    std::vector<RecordingContext> recording_contexts{};
+
+    // every pipeline is created through it. saved to disk once they are, so later runs skip most of the compiling
+    VkPipelineCache pipeline_cache{};
+
     GraphicsPipeline opaque_graphics_pipeline{};
     GraphicsPipeline transparent_graphics_pipeline{};
     GraphicsPipeline shadow_map_graphics_pipeline{};
     GraphicsPipeline depth_pre_graphics_pipeline{};
+    // only created when the output image can't be written by color_correct_compute_pipeline
+    GraphicsPipeline tone_map_graphics_pipeline{};
 
     ComputePipeline build_exposure_hist_compute_pipeline{};
     ComputePipeline average_exposure_hist_compute_pipeline{};
     ComputePipeline color_correct_compute_pipeline{};
+    ComputePipeline cull_draws_compute_pipeline{};
+    ComputePipeline arena_copy_compute_pipeline{};
+    ComputePipeline encode_vertices_compute_pipeline{};
+    ComputePipeline resolve_hiz_compute_pipeline{};
+    ComputePipeline downsample_hiz_compute_pipeline{};
+
+    GraphicsPipeline indirect_opaque_graphics_pipeline{};
+    GraphicsPipeline indirect_transparent_graphics_pipeline{};
+    GraphicsPipeline indirect_shadow_map_graphics_pipeline{};
+    GraphicsPipeline indirect_depth_pre_graphics_pipeline{};
 
-    VmaAllocator allocator{};
+    VmaAllocator  allocator{};
+    UploadManager upload_manager{};
 
     AllocatedImage               msaa_color_image{};
     AllocatedImage               resolve_color_image{};
     AllocatedImage               depth_image{};
     AllocatedImage               shadow_map_image{};
+    AllocatedImage               headless_target_image{};
     AllocatedBuffer              exposure_histogram{};
     AllocatedBuffer              average_luminance_buf{};
     VkExtent3D                   shadow_map_extent{};
     VkDescriptorPool             descriptor_pool{};
+    // shadow_descriptor_sets and shadow_scene_data_buffers hold one entry per cascade per frame in flight
     std::vector<VkDescriptorSet> shadow_descriptor_sets{};
     std::vector<VkDescriptorSet> scene_descriptor_sets{};
 
+    // per frame host copies of average_luminance_buf, read once the frame's fence has signaled
+    std::vector<AllocatedBuffer> luminance_readback_buffers{};
+    // only with exposure_metering_report. full resolution histogram and per frame host copies of both histograms
+    AllocatedBuffer              reference_exposure_histogram{};
+    std::vector<AllocatedBuffer> metering_readback_buffers{};
+    ExposureMeteringReport       metering_report{};
+    // 1 / exposure of the last read back average luminance. the main pass renders pre-exposed and the histogram and
+    // color correction undo it
+    float pre_exposure{1.f};
+
+    // shadow_map_image.image_view is the array view the main pass samples. each cascade renders through its own layer view
+    std::array<VkImageView, max_shadow_cascade_count> shadow_cascade_views{};
+    uint32_t                                          shadow_cascade_count{};
+
+    // farthest depth pyramid of the depth pre-pass, which with reversed depth is the minimum. mip 0 is the largest power
+    // of two size that fits in the render extent. hiz_image.image_view covers every mip for the cull shader
+    AllocatedImage                                 hiz_image{};
+    uint32_t                                       hiz_mip_count{};
+    std::array<VkImageView, max_hiz_mip_count>     hiz_mip_views{};
+    VkSampler                                      hiz_sampler{};
+    // set i reads the depth image (i == 0) or mip i - 1 and writes mip i
+    std::array<VkDescriptorSet, max_hiz_mip_count> hiz_descriptor_sets{};
+    VkDescriptorSet                                occlusion_cull_descriptor_set{};
+
     VkDescriptorSet asset_descriptor_set{};
     VkDescriptorSet build_histogram_descriptor_set{};
-    VkDescriptorSet color_correct_descriptor_set{};
+    // one per frame in flight since the output image changes with every acquired swapchain image
+    std::vector<VkDescriptorSet> color_correct_descriptor_sets{};
 
     VkDescriptorSetLayout shadow_descriptor_set_layout{};
     VkDescriptorSetLayout scene_descriptor_set_layout{};
     VkDescriptorSetLayout asset_descriptor_set_layout{};
     VkDescriptorSetLayout build_histogram_descriptor_set_layout{};
     VkDescriptorSetLayout color_correct_descriptor_set_layout{};
+    VkDescriptorSetLayout hiz_descriptor_set_layout{};
+    VkDescriptorSetLayout occlusion_cull_descriptor_set_layout{};
 
     SceneData scene_data{};
 
-    std::vector<vk_gltf::GltfAsset> assets{};
-    AllocatedBuffer                 material_buffer{};
+    std::vector<RendererAsset> assets{};
+    // world space box around each asset's draws, parallel to assets
+    CullBounds            asset_cull_bounds{};
+    std::vector<uint32_t> visible_assets{};
+    // asset each load belongs to, indexed by AssetLoadHandle
+    std::vector<AssetHandle> load_assets{};
+    // images streaming replaced. they're destroyed once the frames in flight are done with them
+    std::vector<RetiringStreamedImage> retiring_streamed_images{};
+    // released assets and replaced buffers waiting for the frames in flight
+    std::vector<RetiringAsset>  retiring_assets{};
+    std::vector<RetiringBuffer> retiring_buffers{};
+
+    GeometryArena                   geometry_arena{};
+    MaterialStore                   material_store{};
     std::vector<AllocatedBuffer>    main_scene_data_buffers{};
     std::vector<AllocatedBuffer>    shadow_scene_data_buffers{};
     AllocatedImage                  default_texture_image;
     VkSampler                       default_sampler{};
-    uint32_t                        material_count{};
-    uint32_t                        texture_count{};
+    TextureTable                    texture_table{};
     std::vector<DrawObject>         opaque_draws;
     std::vector<DrawObject>         transparent_draws;
 
-    // for frustum culling
-    std::vector<DrawObject> visible_opaque_draws;
-    std::vector<DrawObject> visible_transparent_draws;
+    // world space bounds parallel to opaque_draws and transparent_draws
+    CullBounds opaque_cull_bounds{};
+    CullBounds transparent_cull_bounds{};
+
+    // indices of the draws that survived this frame's frustum culling. opaque ones are sorted by draw_sort_key
+    std::vector<uint32_t> visible_opaque_draws{};
+    std::vector<uint32_t> visible_transparent_draws{};
+    std::vector<uint64_t> draw_sort_keys{};
+    std::vector<uint64_t> draw_sort_scratch{};
+    // every opaque draw grouped by raster state. rebuilt when draws are added
+    std::vector<uint32_t> shadow_draw_order{};
+    // shadow_draw_order filtered down to the casters that can shadow something inside each cascade. rebuilt with the shadow map
+    std::array<std::vector<uint32_t>, max_shadow_cascade_count> shadow_cascade_draws{};
+    std::vector<uint32_t>                                       shadow_visible_casters{};
+    // bit i is set when the opaque draw casts into cascade i
+    std::vector<uint8_t> shadow_caster_cascade_masks{};
+
+    // gpu driven path. draw data and batch layout are rebuilt whenever draws are added
+    bool                                       gpu_driven{};
+    AllocatedBuffer                            gpu_draw_buffer{};
+    uint32_t                                   gpu_draw_count{};
+    std::array<uint32_t, indirect_batch_count> indirect_batch_first_command{};
+    std::array<uint32_t, indirect_batch_count> indirect_batch_capacity{};
+    // shadow casters aren't culled on this path, so the shadow pass draws every opaque draw from a static command list
+    AllocatedBuffer              shadow_indirect_command_buffer{};
+    std::vector<AllocatedBuffer> indirect_command_buffers{};
+    std::vector<AllocatedBuffer> indirect_count_buffers{};
+    std::vector<AllocatedBuffer> cull_data_buffers{};
+    // the main pass draws from these instead when occlusion culling. the depth pre-pass keeps the frustum culled commands
+    std::vector<AllocatedBuffer> occlusion_command_buffers{};
+    std::vector<AllocatedBuffer> occlusion_count_buffers{};
 
     float frame_time{};
 
-    glm::mat4 light_transform{};
-    glm::vec3 sun_dir{};
+    GpuProfiler gpu_profiler{};
+
+    std::array<glm::mat4, max_shadow_cascade_count> cascade_transforms{};
+    glm::vec4                                       cascade_splits{};
+    glm::vec3                                       sun_dir{};
+    // each cascade's light volume followed by its slice of the camera frustum swept along the light
+    std::array<std::array<glm::vec4, 12>, max_shadow_cascade_count> cascade_caster_planes{};
+    // world space AABB of every shadow caster. the cascades' depth ranges reach back to it
+    glm::vec3 shadow_caster_bounds_min{};
+    glm::vec3 shadow_caster_bounds_max{};
+
+    // the shadow map is cached across frames. it's only re-rendered when marked dirty or when a cascade or the camera
+    // slice its casters were culled against moved since they were rendered
+    bool                                                            shadow_map_dirty{true};
+    std::array<glm::mat4, max_shadow_cascade_count>                 shadow_map_cascade_transforms{};
+    std::array<std::array<glm::vec4, 12>, max_shadow_cascade_count> shadow_map_cascade_caster_planes{};
 };
 
-void renderer_create(Renderer* renderer);
+void renderer_create(Renderer* renderer, const RendererOptions* options);
 
 void renderer_key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 
 void renderer_recompile_pipelines(Renderer* renderer);
 
+// re-render the cached shadow map next frame. needed after moving a shadow caster
+void renderer_invalidate_shadow_map(Renderer* renderer);
+
+// overwrites one material in place. frames after this call see the change. the material has to belong to a range that
+// is allocated and not freed yet
+void renderer_update_material(Renderer* renderer, uint32_t material_index, const Material* material);
+
+// gives materials back to the store once the frames in flight are done with them. nothing may draw with them anymore
+void renderer_free_materials(Renderer* renderer, Range materials);
+
+// gives texture table slots back once the frames in flight are done with them. their images have to live that long too
+void renderer_free_textures(Renderer* renderer, Range textures);
+
+// starts loading a glTF asset in the background. its draws, materials and textures are added at the start of the first
+// frame after it finished loading
+AssetHandle renderer_load_gltf_asset(Renderer* renderer, const char* gltf_path);
+
+// removes the asset's draws and frees its geometry, materials, textures and images once the frames in flight are done
+// with them. an asset still loading is dropped once it finishes
+void renderer_unload_gltf_asset(Renderer* renderer, AssetHandle handle);
+
+// stage of the asset's latest load, which is a reload after an eviction
+[[nodiscard]] AssetLoadStage renderer_asset_load_stage(const Renderer* renderer, AssetHandle handle);
+
+[[nodiscard]] AssetResidency renderer_asset_residency(const Renderer* renderer, AssetHandle handle);
+
+[[nodiscard]] AssetLoadProgress renderer_asset_load_progress(const Renderer* renderer);
+
+// finishes every load started so far and adds the assets right away
+void renderer_wait_for_asset_loads(Renderer* renderer);
+
 void renderer_draw(Renderer* renderer);
+
+// writes the last headless frame to a binary PPM image
+void renderer_save_headless_image(Renderer* renderer, const std::filesystem::path& path);
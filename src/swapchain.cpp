@@ -1,6 +1,7 @@
 #include "swapchain.h"
 
-SwapchainContext swapchain_context_create(VkPhysicalDevice physical_device, VkDevice device, VkSurfaceKHR surface, GLFWwindow* window) {
+SwapchainContext swapchain_context_create(VkPhysicalDevice physical_device, VkDevice device, VkSurfaceKHR surface, GLFWwindow* window,
+                                          std::span<const uint32_t> queue_families) {
     std::vector<VkSurfaceFormatKHR> surface_formats;
 
     uint32_t format_count = 0;
@@ -9,14 +10,31 @@ SwapchainContext swapchain_context_create(VkPhysicalDevice physical_device, VkDe
     surface_formats.resize(format_count);
     VK_CHECK(vkGetPhysicalDeviceSurfaceFormatsKHR(physical_device, surface, &format_count, surface_formats.data()));
 
-    VkSurfaceFormatKHR format = surface_formats[0];
+    VkSurfaceCapabilitiesKHR capabilities;
+    VK_CHECK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physical_device, surface, &capabilities));
+
+    // srgb formats can't be storage images. the unorm one can if the surface and the format both allow it
+    VkFormatProperties unorm_format_properties;
+    vkGetPhysicalDeviceFormatProperties(physical_device, VK_FORMAT_B8G8R8A8_UNORM, &unorm_format_properties);
+    const bool storage_supported = (capabilities.supportedUsageFlags & VK_IMAGE_USAGE_STORAGE_BIT) != 0 &&
+                                   (unorm_format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) != 0;
+
+    VkSurfaceFormatKHR format         = surface_formats[0];
+    bool               storage_output = false;
     for (const VkSurfaceFormatKHR& available_format : surface_formats) {
-        if (available_format.format == VK_FORMAT_B8G8R8A8_SRGB && available_format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
+        if (available_format.colorSpace != VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
+            continue;
+        }
+        if (storage_supported && available_format.format == VK_FORMAT_B8G8R8A8_UNORM) {
+            format         = available_format;
+            storage_output = true;
+            break;
+        }
+        if (available_format.format == VK_FORMAT_B8G8R8A8_SRGB) {
             format = available_format;
         }
     }
-    VkSurfaceCapabilitiesKHR capabilities;
-    VK_CHECK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physical_device, surface, &capabilities));
+    const VkImageUsageFlags image_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | (storage_output ? VK_IMAGE_USAGE_STORAGE_BIT : 0);
 
     VkExtent2D swapchain_extent{};
     if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
@@ -35,7 +53,12 @@ SwapchainContext swapchain_context_create(VkPhysicalDevice physical_device, VkDe
 
     VkSwapchainCreateInfoKHR swapchain_ci =
         vk_lib::swapchain_create_info(surface, image_count, format.format, format.colorSpace, swapchain_extent, capabilities.currentTransform,
-                                      VK_PRESENT_MODE_FIFO_KHR, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+                                      VK_PRESENT_MODE_FIFO_KHR, image_usage);
+    if (queue_families.size() > 1) {
+        swapchain_ci.imageSharingMode      = VK_SHARING_MODE_CONCURRENT;
+        swapchain_ci.queueFamilyIndexCount = queue_families.size();
+        swapchain_ci.pQueueFamilyIndices   = queue_families.data();
+    }
     VkSwapchainKHR swapchain;
     VK_CHECK(vkCreateSwapchainKHR(device, &swapchain_ci, nullptr, &swapchain));
 
@@ -43,6 +66,7 @@ SwapchainContext swapchain_context_create(VkPhysicalDevice physical_device, VkDe
     swapchain_context.extent         = swapchain_extent;
     swapchain_context.surface_format = format;
     swapchain_context.swapchain      = swapchain;
+    swapchain_context.storage_output = storage_output;
 
     uint32_t swapchain_image_count = 0;
     VK_CHECK(vkGetSwapchainImagesKHR(device, swapchain, &swapchain_image_count, nullptr));
@@ -71,8 +95,7 @@ void swapchain_context_destroy(SwapchainContext* swapchain_context, VkDevice dev
 }
 
 void swapchain_context_recreate(SwapchainContext* swapchain_context, VkPhysicalDevice physical_device, VkDevice device, VkSurfaceKHR surface,
-                                GLFWwindow* window) {
-    vkDeviceWaitIdle(device);
+                                GLFWwindow* window, std::span<const uint32_t> queue_families) {
     swapchain_context_destroy(swapchain_context, device);
-    *swapchain_context = swapchain_context_create(physical_device, device, surface, window);
+    *swapchain_context = swapchain_context_create(physical_device, device, surface, window, queue_families);
 }
\ No newline at end of file
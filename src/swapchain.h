@@ -1,17 +1,26 @@
 #pragma once
 #include "common.h"
 
+#include <span>
+
 struct SwapchainContext {
     VkSwapchainKHR           swapchain{};
     VkSurfaceFormatKHR       surface_format{};
     VkExtent2D               extent{};
     std::vector<VkImage>     images{};
     std::vector<VkImageView> image_views{};
+    // images are unorm with storage usage, so the tone map compute pass writes srgb encoded values into them directly.
+    // otherwise they're only color attachments and the tone map runs as a full screen fragment pass
+    bool storage_output{};
 };
 
-[[nodiscard]] SwapchainContext swapchain_context_create(VkPhysicalDevice physical_device, VkDevice device, VkSurfaceKHR surface, GLFWwindow* window);
+// images are shared concurrently when queue_families holds more than one family, so they can be written on one queue and
+// presented from another without ownership transfers
+[[nodiscard]] SwapchainContext swapchain_context_create(VkPhysicalDevice physical_device, VkDevice device, VkSurfaceKHR surface, GLFWwindow* window,
+                                                        std::span<const uint32_t> queue_families);
 
 void swapchain_context_destroy(SwapchainContext* swapchain_context, VkDevice device);
 
+// the queues presenting or rendering to the old swapchain have to be idle
 void swapchain_context_recreate(SwapchainContext* swapchain_context, VkPhysicalDevice physical_device, VkDevice device, VkSurfaceKHR surface,
-                                GLFWwindow* window);
+                                GLFWwindow* window, std::span<const uint32_t> queue_families);
@@ -0,0 +1,318 @@
+#include "texture_compression.h"
+
+#include "trace.h"
+
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+using BlockTexels = std::array<std::array<uint8_t, 4>, 16>;
+
+// bumped whenever the encoders or the file layout change, so stale entries are encoded again
+static constexpr uint32_t texture_cache_version = 1;
+static constexpr uint32_t texture_cache_magic   = 0x58544350; // "PCTX"
+
+struct TextureCacheHeader {
+    uint32_t magic{};
+    uint32_t version{};
+    uint64_t source_hash{};
+    uint32_t format{};
+    uint32_t width{};
+    uint32_t height{};
+    uint32_t mip_count{};
+    uint64_t data_size{};
+};
+
+// interpolation weights of bc7's 4 bit indices, out of 64
+static constexpr std::array<uint32_t, 16> bc7_weights = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+// bc blocks are packed lsb first
+struct BlockBits {
+    std::array<uint8_t, 16> bytes{};
+    uint32_t                position{};
+};
+
+static void block_bits_write(BlockBits* bits, uint32_t value, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++, bits->position++) {
+        if ((value >> i) & 1) {
+            bits->bytes[bits->position / 8] |= 1 << (bits->position % 8);
+        }
+    }
+}
+
+// the 4x4 texels at block_x, block_y as rgba. blocks past the edge of the mip repeat its last row and column
+static void fetch_block(const TextureSource* source, uint32_t mip, uint32_t block_x, uint32_t block_y, BlockTexels* texels) {
+    const TextureMip* texture_mip = &source->mips[mip];
+    const uint32_t    texel_size  = texture_format_texel_size(source->format);
+    const bool        bgra        = source->format == VK_FORMAT_B8G8R8A8_UNORM || source->format == VK_FORMAT_B8G8R8A8_SRGB;
+
+    for (uint32_t y = 0; y < 4; y++) {
+        for (uint32_t x = 0; x < 4; x++) {
+            const uint32_t     texel_x      = std::min(block_x * 4 + x, texture_mip->extent.width - 1);
+            const uint32_t     texel_y      = std::min(block_y * 4 + y, texture_mip->extent.height - 1);
+            const VkDeviceSize texel_offset = static_cast<VkDeviceSize>(texel_y) * texture_mip->extent.width + texel_x;
+            const std::byte*   texel        = &source->data[texture_mip->offset + texel_offset * texel_size];
+
+            std::array<uint8_t, 4> rgba = {0, 0, 0, 255};
+            for (uint32_t channel = 0; channel < texel_size; channel++) {
+                rgba[channel] = static_cast<uint8_t>(texel[channel]);
+            }
+            if (bgra) {
+                std::swap(rgba[0], rgba[2]);
+            }
+            (*texels)[y * 4 + x] = rgba;
+        }
+    }
+}
+
+// endpoints are the channel's min and max, every texel takes the closest of the 8 values between them
+static void encode_bc4_block(const BlockTexels& texels, uint32_t channel, std::byte* block) {
+    uint8_t min_value = 255;
+    uint8_t max_value = 0;
+    for (const std::array<uint8_t, 4>& texel : texels) {
+        min_value = std::min(min_value, texel[channel]);
+        max_value = std::max(max_value, texel[channel]);
+    }
+
+    BlockBits bits{};
+    block_bits_write(&bits, max_value, 8);
+    block_bits_write(&bits, min_value, 8);
+    const uint32_t range = max_value - min_value;
+    for (const std::array<uint8_t, 4>& texel : texels) {
+        uint32_t index = 0;
+        if (range > 0) {
+            // steps from min at 0 to max at 7. max is index 0, min index 1 and the rest count down from max
+            const uint32_t step = ((texel[channel] - min_value) * 7 + range / 2) / range;
+            index               = step == 7 ? 0 : step == 0 ? 1 : 8 - step;
+        }
+        block_bits_write(&bits, index, 3);
+    }
+    memcpy(block, bits.bytes.data(), 8);
+}
+
+static void encode_bc5_block(const BlockTexels& texels, std::byte* block) {
+    encode_bc4_block(texels, 0, block);
+    encode_bc4_block(texels, 1, block + 8);
+}
+
+// 7 bit endpoint and shared p bit closest to value
+static void bc7_quantize_endpoint(glm::vec4 value, glm::u8vec4* endpoint, uint32_t* p_bit) {
+    float best_error = std::numeric_limits<float>::max();
+    for (uint32_t p = 0; p < 2; p++) {
+        const glm::vec4 quantized = glm::clamp(glm::round((value - static_cast<float>(p)) * 0.5f), 0.f, 127.f);
+        const glm::vec4 error     = quantized * 2.f + static_cast<float>(p) - value;
+        if (glm::dot(error, error) < best_error) {
+            best_error = glm::dot(error, error);
+            *endpoint  = glm::u8vec4(quantized);
+            *p_bit     = p;
+        }
+    }
+}
+
+// mode 6. the endpoints span the texels along their principal axis
+static void encode_bc7_block(const BlockTexels& texels, std::byte* block) {
+    glm::vec4 mean(0.f);
+    for (const std::array<uint8_t, 4>& texel : texels) {
+        mean += glm::vec4(texel[0], texel[1], texel[2], texel[3]);
+    }
+    mean /= 16.f;
+
+    glm::mat4 covariance(0.f);
+    for (const std::array<uint8_t, 4>& texel : texels) {
+        const glm::vec4 offset = glm::vec4(texel[0], texel[1], texel[2], texel[3]) - mean;
+        covariance += glm::outerProduct(offset, offset);
+    }
+
+    // a few rounds of power iteration are plenty for 16 texels
+    glm::vec4 axis(1.f);
+    for (uint32_t i = 0; i < 8; i++) {
+        axis = covariance * axis;
+        const float length = glm::length(axis);
+        if (length == 0.f) {
+            break;
+        }
+        axis /= length;
+    }
+
+    float min_projection = 0.f;
+    float max_projection = 0.f;
+    for (const std::array<uint8_t, 4>& texel : texels) {
+        const float projection = glm::dot(glm::vec4(texel[0], texel[1], texel[2], texel[3]) - mean, axis);
+        min_projection         = std::min(min_projection, projection);
+        max_projection         = std::max(max_projection, projection);
+    }
+
+    std::array<glm::u8vec4, 2> endpoints{};
+    std::array<uint32_t, 2>    p_bits{};
+    bc7_quantize_endpoint(glm::clamp(mean + axis * min_projection, 0.f, 255.f), &endpoints[0], &p_bits[0]);
+    bc7_quantize_endpoint(glm::clamp(mean + axis * max_projection, 0.f, 255.f), &endpoints[1], &p_bits[1]);
+
+    const glm::ivec4 color_0 = glm::ivec4(endpoints[0]) * 2 + static_cast<int>(p_bits[0]);
+    const glm::ivec4 color_1 = glm::ivec4(endpoints[1]) * 2 + static_cast<int>(p_bits[1]);
+
+    std::array<glm::ivec4, 16> palette{};
+    for (uint32_t i = 0; i < 16; i++) {
+        const int weight = bc7_weights[i];
+        palette[i]       = ((64 - weight) * color_0 + weight * color_1 + 32) >> 6;
+    }
+
+    std::array<uint32_t, 16> indices{};
+    for (uint32_t t = 0; t < 16; t++) {
+        const glm::ivec4 texel(texels[t][0], texels[t][1], texels[t][2], texels[t][3]);
+        int              best_error = std::numeric_limits<int>::max();
+        for (uint32_t i = 0; i < 16; i++) {
+            const glm::ivec4 error        = palette[i] - texel;
+            const int        error_length = error.x * error.x + error.y * error.y + error.z * error.z + error.w * error.w;
+            if (error_length < best_error) {
+                best_error = error_length;
+                indices[t] = i;
+            }
+        }
+    }
+
+    // the first index is stored without its top bit, so it has to be in the lower half
+    if (indices[0] >= 8) {
+        std::swap(endpoints[0], endpoints[1]);
+        std::swap(p_bits[0], p_bits[1]);
+        for (uint32_t& index : indices) {
+            index = 15 - index;
+        }
+    }
+
+    BlockBits bits{};
+    block_bits_write(&bits, 1 << 6, 7);
+    for (uint32_t channel = 0; channel < 4; channel++) {
+        block_bits_write(&bits, endpoints[0][channel], 7);
+        block_bits_write(&bits, endpoints[1][channel], 7);
+    }
+    block_bits_write(&bits, p_bits[0], 1);
+    block_bits_write(&bits, p_bits[1], 1);
+    block_bits_write(&bits, indices[0], 3);
+    for (uint32_t t = 1; t < 16; t++) {
+        block_bits_write(&bits, indices[t], 4);
+    }
+    memcpy(block, bits.bytes.data(), 16);
+}
+
+static void encode_block(VkFormat format, const BlockTexels& texels, std::byte* block) {
+    switch (format) {
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+        encode_bc4_block(texels, 0, block);
+        break;
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+        encode_bc5_block(texels, block);
+        break;
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        encode_bc7_block(texels, block);
+        break;
+    default:
+        abort_message(std::string("Can't encode textures to ") + string_VkFormat(format));
+    }
+}
+
+TextureSource texture_source_compress(const TextureSource* source, VkFormat format, JobSystem* job_system) {
+    TRACE_ZONE("texture_source_compress");
+    TextureSource compressed = texture_source_create(format, source->mips[0].extent);
+
+    // every row of blocks in every mip is a job
+    std::vector<std::pair<uint32_t, uint32_t>> block_rows;
+    for (uint32_t mip = 0; mip < compressed.mips.size(); mip++) {
+        for (uint32_t block_y = 0; block_y < (compressed.mips[mip].extent.height + 3) / 4; block_y++) {
+            block_rows.emplace_back(mip, block_y);
+        }
+    }
+
+    const uint32_t block_size = texture_format_block_size(format);
+    job_system_parallel_for(job_system, block_rows.size(), [&](uint32_t job_index, uint32_t) {
+        const auto [mip, block_y] = block_rows[job_index];
+
+        const TextureMip* texture_mip = &compressed.mips[mip];
+        const uint32_t    row_width   = (texture_mip->extent.width + 3) / 4;
+        std::byte*        row         = &compressed.data[texture_mip->offset + static_cast<VkDeviceSize>(block_y) * row_width * block_size];
+
+        BlockTexels texels{};
+        for (uint32_t block_x = 0; block_x < row_width; block_x++) {
+            fetch_block(source, mip, block_x, block_y, &texels);
+            encode_block(format, texels, row + block_x * block_size);
+        }
+    });
+    return compressed;
+}
+
+// fnv-1a over 8 byte words, with the layout mixed in so equal bytes in another shape don't collide
+uint64_t texture_source_hash(const TextureSource* source) {
+    TRACE_ZONE("texture_source_hash");
+    constexpr uint64_t fnv_prime = 0x100000001b3;
+
+    uint64_t   hash = 0xcbf29ce484222325;
+    const auto mix  = [&](uint64_t value) { hash = (hash ^ value) * fnv_prime; };
+
+    mix(source->format);
+    mix(source->mips[0].extent.width);
+    mix(source->mips[0].extent.height);
+    for (size_t offset = 0; offset < source->data.size(); offset += sizeof(uint64_t)) {
+        uint64_t word = 0;
+        memcpy(&word, &source->data[offset], std::min(sizeof(uint64_t), source->data.size() - offset));
+        mix(word);
+    }
+    return hash;
+}
+
+static std::filesystem::path texture_cache_path(const std::filesystem::path& cache_dir, uint64_t source_hash, VkFormat format) {
+    std::array<char, 64> file_name{};
+    snprintf(file_name.data(), file_name.size(), "%016llx_%u.tex", static_cast<unsigned long long>(source_hash), static_cast<uint32_t>(format));
+    return cache_dir / "textures" / file_name.data();
+}
+
+TextureSource texture_cache_load(const std::filesystem::path& cache_dir, uint64_t source_hash, VkFormat format, VkExtent3D extent) {
+    std::ifstream file(texture_cache_path(cache_dir, source_hash, format), std::ios::binary);
+    if (!file.is_open()) {
+        return {};
+    }
+
+    TextureCacheHeader header{};
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+    TextureSource compressed = texture_source_create(format, extent);
+    if (!file || header.magic != texture_cache_magic || header.version != texture_cache_version || header.source_hash != source_hash ||
+        header.format != format || header.width != extent.width || header.height != extent.height || header.mip_count != compressed.mips.size() ||
+        header.data_size != compressed.data.size()) {
+        return {};
+    }
+
+    file.read(reinterpret_cast<char*>(compressed.data.data()), compressed.data.size());
+    if (!file) {
+        return {};
+    }
+    return compressed;
+}
+
+void texture_cache_store(const std::filesystem::path& cache_dir, uint64_t source_hash, const TextureSource* compressed) {
+    const std::filesystem::path path = texture_cache_path(cache_dir, source_hash, compressed->format);
+    std::error_code             error;
+    std::filesystem::create_directories(path.parent_path(), error);
+
+    TextureCacheHeader header{};
+    header.magic       = texture_cache_magic;
+    header.version     = texture_cache_version;
+    header.source_hash = source_hash;
+    header.format      = compressed->format;
+    header.width       = compressed->mips[0].extent.width;
+    header.height      = compressed->mips[0].extent.height;
+    header.mip_count   = compressed->mips.size();
+    header.data_size   = compressed->data.size();
+
+    // written next to the entry and moved over it, so a load never sees half a file
+    std::filesystem::path temp_path = path;
+    temp_path += ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(compressed->data.data()), compressed->data.size());
+        if (!file) {
+            return;
+        }
+    }
+    std::filesystem::rename(temp_path, path, error);
+}
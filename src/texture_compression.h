@@ -0,0 +1,19 @@
+#pragma once
+#include "common.h"
+#include "job_system.h"
+#include "texture_source.h"
+
+// cpu block compression of texture sources. bc7 for color, bc5 for the xy of normal maps and bc4 for single channel
+// masks. bc7 only uses mode 6, one subset with rgba endpoints, which is fast to search and fine for most textures.
+// encoded chains are cached on disk by the hash of the source they came from, so later loads only pay for reading them
+
+// encodes every mip of source into format, one row of blocks per job
+[[nodiscard]] TextureSource texture_source_compress(const TextureSource* source, VkFormat format, JobSystem* job_system);
+
+[[nodiscard]] uint64_t texture_source_hash(const TextureSource* source);
+
+// the chain encoded into format from the source with source_hash. empty when it isn't cached or the entry doesn't match
+[[nodiscard]] TextureSource texture_cache_load(const std::filesystem::path& cache_dir, uint64_t source_hash, VkFormat format, VkExtent3D extent);
+
+// failing to write the cache only costs encoding again next time, so errors are ignored
+void texture_cache_store(const std::filesystem::path& cache_dir, uint64_t source_hash, const TextureSource* compressed);
@@ -0,0 +1,133 @@
+#include "texture_source.h"
+
+#include <bit>
+#include <cstring>
+
+uint32_t texture_format_texel_size(VkFormat format) {
+    switch (format) {
+    case VK_FORMAT_R8_UNORM:
+        return 1;
+    case VK_FORMAT_R8G8_UNORM:
+        return 2;
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+uint32_t texture_format_block_size(VkFormat format) {
+    switch (format) {
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+        return 8;
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+// mips smaller than a block still take a whole one
+static VkDeviceSize texture_mip_size(VkFormat format, VkExtent3D extent) {
+    const uint32_t block_size = texture_format_block_size(format);
+    if (block_size > 0) {
+        return static_cast<VkDeviceSize>((extent.width + 3) / 4) * ((extent.height + 3) / 4) * block_size;
+    }
+    return static_cast<VkDeviceSize>(extent.width) * extent.height * texture_format_texel_size(format);
+}
+
+TextureSource texture_source_create(VkFormat format, VkExtent3D extent) {
+    const uint32_t mip_count = std::bit_width(std::max(extent.width, extent.height));
+
+    TextureSource source{};
+    source.format = format;
+    source.mips.reserve(mip_count);
+
+    VkDeviceSize offset = 0;
+    for (uint32_t mip = 0; mip < mip_count; mip++) {
+        const VkExtent3D   mip_extent{std::max(extent.width >> mip, 1u), std::max(extent.height >> mip, 1u), 1};
+        const VkDeviceSize mip_size = texture_mip_size(format, mip_extent);
+        source.mips.push_back({mip_extent, offset, mip_size});
+        offset += mip_size;
+    }
+    source.data.resize(offset);
+    return source;
+}
+
+TextureSource texture_source_read_back(VkDevice device, VmaAllocator allocator, VkCommandPool command_pool, VkQueue queue, VkImage image,
+                                       VkFormat format, VkExtent3D extent, VkImageLayout layout) {
+    TextureSource source = texture_source_create(format, extent);
+
+    VkBufferCreateInfo      readback_buf_ci = vk_lib::buffer_create_info(VK_BUFFER_USAGE_TRANSFER_DST_BIT, source.data.size());
+    VmaAllocationCreateInfo readback_buf_allocation_ci{};
+    readback_buf_allocation_ci.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+    readback_buf_allocation_ci.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT;
+    AllocatedBuffer readback_buffer;
+    VK_CHECK(vmaCreateBuffer(allocator, &readback_buf_ci, &readback_buf_allocation_ci, &readback_buffer.buffer, &readback_buffer.allocation,
+                             &readback_buffer.allocation_info));
+
+    VkFence                 fence{};
+    const VkFenceCreateInfo fence_ci = vk_lib::fence_create_info();
+    VK_CHECK(vkCreateFence(device, &fence_ci, nullptr, &fence));
+
+    const VkCommandBufferAllocateInfo command_buffer_ai = vk_lib::command_buffer_allocate_info(command_pool);
+    VkCommandBuffer                   cmd_buf;
+    VK_CHECK(vkAllocateCommandBuffers(device, &command_buffer_ai, &cmd_buf));
+
+    const VkCommandBufferBeginInfo command_buffer_bi = vk_lib::command_buffer_begin_info();
+    VK_CHECK(vkBeginCommandBuffer(cmd_buf, &command_buffer_bi));
+
+    VkImageSubresourceRange subresource_range = vk_lib::image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT);
+    subresource_range.levelCount              = source.mips.size();
+
+    // the image is thrown away afterwards, so it stays in the transfer layout
+    const VkImageMemoryBarrier2 transfer_image_memory_barrier =
+        vk_lib::image_memory_barrier_2(image, subresource_range, layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                                       VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_MEMORY_WRITE_BIT, VK_ACCESS_2_TRANSFER_READ_BIT);
+    const VkDependencyInfo transfer_dependency_info = vk_lib::dependency_info(&transfer_image_memory_barrier, nullptr, nullptr);
+    vkCmdPipelineBarrier2(cmd_buf, &transfer_dependency_info);
+
+    std::vector<VkBufferImageCopy> copy_regions;
+    copy_regions.reserve(source.mips.size());
+    for (uint32_t mip = 0; mip < source.mips.size(); mip++) {
+        VkImageSubresourceLayers image_subresource_layers = vk_lib::image_subresource_layers(VK_IMAGE_ASPECT_COLOR_BIT);
+        image_subresource_layers.mipLevel                 = mip;
+
+        VkBufferImageCopy copy_region = vk_lib::buffer_image_copy(image_subresource_layers, source.mips[mip].extent);
+        copy_region.bufferOffset      = source.mips[mip].offset;
+        copy_regions.push_back(copy_region);
+    }
+    vkCmdCopyImageToBuffer(cmd_buf, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback_buffer.buffer, copy_regions.size(), copy_regions.data());
+
+    const VkBufferMemoryBarrier2 host_read_buffer_memory_barrier =
+        vk_lib::buffer_memory_barrier_2(readback_buffer.buffer, VK_PIPELINE_STAGE_2_COPY_BIT, VK_PIPELINE_STAGE_2_HOST_BIT,
+                                        VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_ACCESS_2_HOST_READ_BIT);
+    const VkDependencyInfo host_read_dependency_info = vk_lib::dependency_info(nullptr, &host_read_buffer_memory_barrier, nullptr);
+    vkCmdPipelineBarrier2(cmd_buf, &host_read_dependency_info);
+
+    VK_CHECK(vkEndCommandBuffer(cmd_buf));
+
+    const VkCommandBufferSubmitInfo command_buffer_submit_info = vk_lib::command_buffer_submit_info(cmd_buf);
+    const VkSubmitInfo2             submit_info_2              = vk_lib::submit_info_2(&command_buffer_submit_info);
+    VK_CHECK(vkQueueSubmit2(queue, 1, &submit_info_2, fence));
+    VK_CHECK(vkWaitForFences(device, 1, &fence, true, UINT64_MAX));
+
+    vkFreeCommandBuffers(device, command_pool, 1, &cmd_buf);
+    vkDestroyFence(device, fence, nullptr);
+
+    VK_CHECK(vmaInvalidateAllocation(allocator, readback_buffer.allocation, 0, VK_WHOLE_SIZE));
+    memcpy(source.data.data(), readback_buffer.allocation_info.pMappedData, source.data.size());
+    vmaDestroyBuffer(allocator, readback_buffer.buffer, readback_buffer.allocation);
+
+    return source;
+}
+
+std::span<const std::byte> texture_source_mip_data(const TextureSource* source, uint32_t mip) {
+    const TextureMip* texture_mip = &source->mips[mip];
+    return std::span(source->data).subspan(texture_mip->offset, texture_mip->size);
+}
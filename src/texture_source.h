@@ -0,0 +1,33 @@
+#pragma once
+#include "common.h"
+
+#include <span>
+
+// host copy of an image's mip chain, so the renderer can upload any part of it later without going back to the gltf.
+// mips are packed largest first
+struct TextureMip {
+    VkExtent3D   extent{};
+    VkDeviceSize offset{};
+    VkDeviceSize size{};
+};
+
+struct TextureSource {
+    VkFormat                format{};
+    std::vector<TextureMip> mips{};
+    std::vector<std::byte>  data{};
+};
+
+// bytes per texel of the uncompressed formats a source can hold. 0 for everything else
+[[nodiscard]] uint32_t texture_format_texel_size(VkFormat format);
+
+// bytes per 4x4 block of the block compressed formats a source can hold. 0 for everything else
+[[nodiscard]] uint32_t texture_format_block_size(VkFormat format);
+
+// lays out and allocates every mip of a full chain starting at extent
+[[nodiscard]] TextureSource texture_source_create(VkFormat format, VkExtent3D extent);
+
+// copies the full mip chain of image, which is in layout and owned by queue's family, into host memory. waits for the copy
+[[nodiscard]] TextureSource texture_source_read_back(VkDevice device, VmaAllocator allocator, VkCommandPool command_pool, VkQueue queue,
+                                                     VkImage image, VkFormat format, VkExtent3D extent, VkImageLayout layout);
+
+[[nodiscard]] std::span<const std::byte> texture_source_mip_data(const TextureSource* source, uint32_t mip);
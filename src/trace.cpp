@@ -0,0 +1,113 @@
+#include "trace.h"
+
+#ifdef PHOTOMETRIC_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+
+struct TraceEvent {
+    const char* name{};
+    uint64_t    begin_ns{};
+    uint64_t    end_ns{};
+};
+
+// per thread ring of completed zones. once full the oldest zones are overwritten
+static constexpr uint32_t trace_ring_capacity  = 1 << 16;
+static constexpr uint32_t trace_max_zone_depth = 64;
+
+struct TraceThreadBuffer {
+    std::array<TraceEvent, trace_ring_capacity> events{};
+    // only the owning thread writes. release stores let the exporter read completed events
+    std::atomic<uint64_t>    write_count{};
+    uint32_t                 thread_id{};
+    std::atomic<const char*> thread_name{};
+
+    std::array<TraceEvent, trace_max_zone_depth> open_zones{};
+    uint32_t                                     open_zone_count{};
+};
+
+static std::mutex                                      registry_mutex;
+static std::vector<std::unique_ptr<TraceThreadBuffer>> thread_buffers;
+static const auto                                      trace_epoch = std::chrono::steady_clock::now();
+
+static thread_local TraceThreadBuffer* local_thread_buffer = nullptr;
+
+static uint64_t trace_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - trace_epoch).count();
+}
+
+static TraceThreadBuffer* get_thread_buffer() {
+    if (local_thread_buffer == nullptr) {
+        std::lock_guard lock(registry_mutex);
+        thread_buffers.push_back(std::make_unique<TraceThreadBuffer>());
+        local_thread_buffer            = thread_buffers.back().get();
+        local_thread_buffer->thread_id = thread_buffers.size();
+    }
+    return local_thread_buffer;
+}
+
+static void record_event(TraceThreadBuffer* buffer, const char* name, uint64_t begin_ns, uint64_t end_ns) {
+    const uint64_t index                        = buffer->write_count.load(std::memory_order_relaxed);
+    buffer->events[index % trace_ring_capacity] = {name, begin_ns, end_ns};
+    buffer->write_count.store(index + 1, std::memory_order_release);
+}
+
+TraceZone::TraceZone(const char* zone_name) : name(zone_name), begin_ns(trace_now_ns()) {}
+
+TraceZone::~TraceZone() { record_event(get_thread_buffer(), name, begin_ns, trace_now_ns()); }
+
+void trace_zone_begin(const char* name) {
+    TraceThreadBuffer* buffer = get_thread_buffer();
+    if (buffer->open_zone_count == trace_max_zone_depth) {
+        abort_message("Trace zones nested too deeply");
+    }
+    buffer->open_zones[buffer->open_zone_count++] = {name, trace_now_ns(), 0};
+}
+
+void trace_zone_end() {
+    TraceThreadBuffer* buffer = get_thread_buffer();
+    if (buffer->open_zone_count == 0) {
+        abort_message("Trace zone ended without a matching begin");
+    }
+    const TraceEvent* zone = &buffer->open_zones[--buffer->open_zone_count];
+    record_event(buffer, zone->name, zone->begin_ns, trace_now_ns());
+}
+
+void trace_set_thread_name(const char* name) { get_thread_buffer()->thread_name.store(name, std::memory_order_relaxed); }
+
+void trace_write_chrome_json(const std::filesystem::path& path) {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        abort_message("Failed to open trace output file");
+    }
+
+    std::lock_guard lock(registry_mutex);
+
+    file << std::fixed << std::setprecision(3);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first_event = true;
+    for (const std::unique_ptr<TraceThreadBuffer>& buffer : thread_buffers) {
+        const char* thread_name = buffer->thread_name.load(std::memory_order_relaxed);
+        if (thread_name != nullptr) {
+            file << (first_event ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->thread_id
+                 << ",\"args\":{\"name\":\"" << thread_name << "\"}}";
+            first_event = false;
+        }
+
+        const uint64_t write_count = buffer->write_count.load(std::memory_order_acquire);
+        const uint64_t first_index = write_count > trace_ring_capacity ? write_count - trace_ring_capacity : 0;
+        for (uint64_t i = first_index; i < write_count; i++) {
+            const TraceEvent* event = &buffer->events[i % trace_ring_capacity];
+            // trace_event timestamps are in microseconds
+            file << (first_event ? "" : ",") << "\n{\"name\":\"" << event->name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->thread_id
+                 << ",\"ts\":" << event->begin_ns / 1000.0 << ",\"dur\":" << (event->end_ns - event->begin_ns) / 1000.0 << "}";
+            first_event = false;
+        }
+    }
+    file << "\n]}\n";
+}
+
+#endif
@@ -0,0 +1,46 @@
+#pragma once
+#include "common.h"
+
+// Lightweight scoped cpu zones exported as chrome trace_event json (chrome://tracing or ui.perfetto.dev).
+// Everything compiles out unless PHOTOMETRIC_TRACE is defined (cmake -DPHOTOMETRIC_TRACE=ON).
+// Zone names must be string literals, only the pointer is recorded.
+
+#ifdef PHOTOMETRIC_TRACE
+
+struct TraceZone {
+    const char* name{};
+    uint64_t    begin_ns{};
+
+    explicit TraceZone(const char* zone_name);
+    ~TraceZone();
+
+    TraceZone(const TraceZone&)            = delete;
+    TraceZone& operator=(const TraceZone&) = delete;
+};
+
+void trace_zone_begin(const char* name);
+
+void trace_zone_end();
+
+void trace_set_thread_name(const char* name);
+
+void trace_write_chrome_json(const std::filesystem::path& path);
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b)       TRACE_CONCAT_INNER(a, b)
+#define TRACE_ZONE(name)         TraceZone TRACE_CONCAT(trace_zone_, __LINE__){name}
+// for linear code where a scope would be awkward. begin/end pairs must nest on each thread
+#define TRACE_ZONE_BEGIN(name)   trace_zone_begin(name)
+#define TRACE_ZONE_END()         trace_zone_end()
+#define TRACE_THREAD_NAME(name)  trace_set_thread_name(name)
+
+#else
+
+inline void trace_write_chrome_json([[maybe_unused]] const std::filesystem::path& path) {}
+
+#define TRACE_ZONE(name)        ((void)0)
+#define TRACE_ZONE_BEGIN(name)  ((void)0)
+#define TRACE_ZONE_END()        ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+
+#endif
@@ -0,0 +1,266 @@
+#include "upload_manager.h"
+#include "trace.h"
+
+// covers the texel size of every format uploaded through the ring
+static constexpr VkDeviceSize staging_alignment = 16;
+
+void upload_manager_create(UploadManager* upload_manager, VkDevice device, VmaAllocator allocator, VkQueue queue, uint32_t queue_family,
+                           uint32_t graphics_queue_family, VkDeviceSize staging_capacity) {
+    *upload_manager                       = UploadManager{};
+    upload_manager->device                = device;
+    upload_manager->allocator             = allocator;
+    upload_manager->queue                 = queue;
+    upload_manager->queue_family          = queue_family;
+    upload_manager->graphics_queue_family = graphics_queue_family;
+    upload_manager->staging_capacity      = staging_capacity;
+
+    const VkCommandPoolCreateInfo command_pool_ci = vk_lib::command_pool_create_info(queue_family, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+    VK_CHECK(vkCreateCommandPool(device, &command_pool_ci, nullptr, &upload_manager->command_pool));
+
+    VkSemaphoreTypeCreateInfo timeline_semaphore_type_ci{};
+    timeline_semaphore_type_ci.sType         = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    timeline_semaphore_type_ci.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+
+    VkSemaphoreCreateInfo timeline_semaphore_ci = vk_lib::semaphore_create_info();
+    timeline_semaphore_ci.pNext                 = &timeline_semaphore_type_ci;
+    VK_CHECK(vkCreateSemaphore(device, &timeline_semaphore_ci, nullptr, &upload_manager->timeline_semaphore));
+
+    VkBufferCreateInfo      staging_buf_ci = vk_lib::buffer_create_info(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, staging_capacity);
+    VmaAllocationCreateInfo staging_buf_allocation_ci{};
+    staging_buf_allocation_ci.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+    staging_buf_allocation_ci.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+    AllocatedBuffer* staging_buffer = &upload_manager->staging_buffer;
+    VK_CHECK(vmaCreateBuffer(allocator, &staging_buf_ci, &staging_buf_allocation_ci, &staging_buffer->buffer, &staging_buffer->allocation,
+                             &staging_buffer->allocation_info));
+}
+
+static bool has_dedicated_queue_family(const UploadManager* upload_manager) {
+    return upload_manager->queue_family != upload_manager->graphics_queue_family;
+}
+
+// frees the staging ranges and command buffers of every batch that finished
+static void retire_completed_batches(UploadManager* upload_manager) {
+    uint64_t completed_value;
+    VK_CHECK(vkGetSemaphoreCounterValue(upload_manager->device, upload_manager->timeline_semaphore, &completed_value));
+
+    while (!upload_manager->submitted_batches.empty() && upload_manager->submitted_batches.front().timeline_value <= completed_value) {
+        const UploadBatch* batch     = &upload_manager->submitted_batches.front();
+        upload_manager->staging_tail = batch->staging_end;
+        upload_manager->free_command_buffers.push_back(batch->command_buffer);
+        upload_manager->submitted_batches.pop_front();
+    }
+}
+
+static void wait_for_value(const UploadManager* upload_manager, uint64_t value) {
+    VkSemaphoreWaitInfo wait_info{};
+    wait_info.sType          = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    wait_info.semaphoreCount = 1;
+    wait_info.pSemaphores    = &upload_manager->timeline_semaphore;
+    wait_info.pValues        = &value;
+    VK_CHECK(vkWaitSemaphores(upload_manager->device, &wait_info, UINT64_MAX));
+}
+
+// returns the ring offset of size free bytes. a range never wraps around the end of the ring, and when the ring is full
+// this waits for the oldest batch
+static VkDeviceSize allocate_staging(UploadManager* upload_manager, VkDeviceSize size) {
+    const VkDeviceSize capacity = upload_manager->staging_capacity;
+
+    VkDeviceSize offset = (upload_manager->staging_head + staging_alignment - 1) / staging_alignment * staging_alignment;
+    if (offset % capacity + size > capacity) {
+        offset = (offset / capacity + 1) * capacity;
+    }
+
+    retire_completed_batches(upload_manager);
+    while (offset + size - upload_manager->staging_tail > capacity) {
+        // the batch being recorded holds the rest of the ring
+        if (upload_manager->submitted_batches.empty()) {
+            upload_manager_flush(upload_manager);
+        }
+        wait_for_value(upload_manager, upload_manager->submitted_batches.front().timeline_value);
+        retire_completed_batches(upload_manager);
+    }
+
+    upload_manager->staging_head = offset + size;
+    return offset % capacity;
+}
+
+static VkCommandBuffer recording_command_buffer(UploadManager* upload_manager) {
+    if (upload_manager->recording_command_buffer != nullptr) {
+        return upload_manager->recording_command_buffer;
+    }
+
+    VkCommandBuffer command_buffer;
+    if (upload_manager->free_command_buffers.empty()) {
+        const VkCommandBufferAllocateInfo command_buffer_ai = vk_lib::command_buffer_allocate_info(upload_manager->command_pool);
+        VK_CHECK(vkAllocateCommandBuffers(upload_manager->device, &command_buffer_ai, &command_buffer));
+    } else {
+        command_buffer = upload_manager->free_command_buffers.back();
+        upload_manager->free_command_buffers.pop_back();
+        VK_CHECK(vkResetCommandBuffer(command_buffer, 0));
+    }
+
+    const VkCommandBufferBeginInfo begin_info = vk_lib::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    VK_CHECK(vkBeginCommandBuffer(command_buffer, &begin_info));
+
+    upload_manager->recording_command_buffer = command_buffer;
+    return command_buffer;
+}
+
+static VkDeviceSize write_staging(UploadManager* upload_manager, std::span<const std::byte> data) {
+    const VkDeviceSize staging_offset = allocate_staging(upload_manager, data.size());
+    memcpy(static_cast<std::byte*>(upload_manager->staging_buffer.allocation_info.pMappedData) + staging_offset, data.data(), data.size());
+    VK_CHECK(vmaFlushAllocation(upload_manager->allocator, upload_manager->staging_buffer.allocation, staging_offset, data.size()));
+    return staging_offset;
+}
+
+UploadTicket upload_manager_upload_buffer(UploadManager* upload_manager, VkBuffer buffer, VkDeviceSize offset, std::span<const std::byte> data) {
+    if (data.empty()) {
+        return upload_manager->submitted_value;
+    }
+
+    const VkDeviceSize max_copy_size = upload_manager->staging_capacity / 4;
+    for (VkDeviceSize copied = 0; copied < data.size(); copied += max_copy_size) {
+        const std::span<const std::byte> copy_data      = data.subspan(copied, std::min(data.size() - copied, max_copy_size));
+        const VkDeviceSize               staging_offset = write_staging(upload_manager, copy_data);
+
+        const VkBufferCopy buffer_copy = vk_lib::buffer_copy(copy_data.size(), staging_offset, offset + copied);
+        vkCmdCopyBuffer(recording_command_buffer(upload_manager), upload_manager->staging_buffer.buffer, buffer, 1, &buffer_copy);
+    }
+
+    // earlier parts may have gone out with an earlier batch. the barrier still covers them since they were submitted first
+    VkCommandBuffer command_buffer = recording_command_buffer(upload_manager);
+    if (has_dedicated_queue_family(upload_manager)) {
+        VkBufferMemoryBarrier2 release_buffer_memory_barrier = vk_lib::buffer_memory_barrier_2(
+            buffer, VK_PIPELINE_STAGE_2_COPY_BIT, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_ACCESS_2_NONE);
+        release_buffer_memory_barrier.srcQueueFamilyIndex = upload_manager->queue_family;
+        release_buffer_memory_barrier.dstQueueFamilyIndex = upload_manager->graphics_queue_family;
+
+        const VkDependencyInfo release_dependency_info = vk_lib::dependency_info(nullptr, &release_buffer_memory_barrier, nullptr);
+        vkCmdPipelineBarrier2(command_buffer, &release_dependency_info);
+
+        VkBufferMemoryBarrier2 acquire_buffer_memory_barrier = vk_lib::buffer_memory_barrier_2(
+            buffer, VK_PIPELINE_STAGE_2_NONE, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_NONE, VK_ACCESS_2_MEMORY_READ_BIT);
+        acquire_buffer_memory_barrier.srcQueueFamilyIndex = upload_manager->queue_family;
+        acquire_buffer_memory_barrier.dstQueueFamilyIndex = upload_manager->graphics_queue_family;
+        upload_manager->pending_buffer_acquires.push_back(acquire_buffer_memory_barrier);
+    } else {
+        // same queue as the frames, which come later in submission order
+        const VkBufferMemoryBarrier2 read_buffer_memory_barrier = vk_lib::buffer_memory_barrier_2(
+            buffer, VK_PIPELINE_STAGE_2_COPY_BIT, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_ACCESS_2_MEMORY_READ_BIT);
+        const VkDependencyInfo read_dependency_info = vk_lib::dependency_info(nullptr, &read_buffer_memory_barrier, nullptr);
+        vkCmdPipelineBarrier2(command_buffer, &read_dependency_info);
+    }
+
+    return upload_manager->submitted_value + 1;
+}
+
+UploadTicket upload_manager_upload_image(UploadManager* upload_manager, VkImage image, uint32_t mip_level, VkExtent3D extent,
+                                         std::span<const std::byte> data, VkImageLayout final_layout) {
+    if (data.size() > upload_manager->staging_capacity / 4) {
+        abort_message("Image upload doesn't fit in the staging ring");
+    }
+
+    const VkDeviceSize staging_offset = write_staging(upload_manager, data);
+    VkCommandBuffer    command_buffer = recording_command_buffer(upload_manager);
+
+    VkImageSubresourceRange subresource_range = vk_lib::image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT);
+    subresource_range.baseMipLevel            = mip_level;
+
+    const VkImageMemoryBarrier2 transfer_image_memory_barrier =
+        vk_lib::image_memory_barrier_2(image, subresource_range, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                       VK_PIPELINE_STAGE_2_NONE, VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_NONE, VK_ACCESS_2_TRANSFER_WRITE_BIT);
+    const VkDependencyInfo transfer_dependency_info = vk_lib::dependency_info(&transfer_image_memory_barrier, nullptr, nullptr);
+    vkCmdPipelineBarrier2(command_buffer, &transfer_dependency_info);
+
+    VkImageSubresourceLayers image_subresource_layers = vk_lib::image_subresource_layers(VK_IMAGE_ASPECT_COLOR_BIT);
+    image_subresource_layers.mipLevel                 = mip_level;
+
+    VkBufferImageCopy copy_region = vk_lib::buffer_image_copy(image_subresource_layers, extent);
+    copy_region.bufferOffset      = staging_offset;
+    vkCmdCopyBufferToImage(command_buffer, upload_manager->staging_buffer.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy_region);
+
+    // the layout change happens as part of the ownership transfer
+    if (has_dedicated_queue_family(upload_manager)) {
+        VkImageMemoryBarrier2 release_image_memory_barrier =
+            vk_lib::image_memory_barrier_2(image, subresource_range, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, final_layout, VK_PIPELINE_STAGE_2_COPY_BIT,
+                                           VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_ACCESS_2_NONE);
+        release_image_memory_barrier.srcQueueFamilyIndex = upload_manager->queue_family;
+        release_image_memory_barrier.dstQueueFamilyIndex = upload_manager->graphics_queue_family;
+
+        const VkDependencyInfo release_dependency_info = vk_lib::dependency_info(&release_image_memory_barrier, nullptr, nullptr);
+        vkCmdPipelineBarrier2(command_buffer, &release_dependency_info);
+
+        VkImageMemoryBarrier2 acquire_image_memory_barrier =
+            vk_lib::image_memory_barrier_2(image, subresource_range, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, final_layout, VK_PIPELINE_STAGE_2_NONE,
+                                           VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_NONE, VK_ACCESS_2_MEMORY_READ_BIT);
+        acquire_image_memory_barrier.srcQueueFamilyIndex = upload_manager->queue_family;
+        acquire_image_memory_barrier.dstQueueFamilyIndex = upload_manager->graphics_queue_family;
+        upload_manager->pending_image_acquires.push_back(acquire_image_memory_barrier);
+    } else {
+        const VkImageMemoryBarrier2 read_image_memory_barrier = vk_lib::image_memory_barrier_2(
+            image, subresource_range, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, final_layout, VK_PIPELINE_STAGE_2_COPY_BIT,
+            VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_ACCESS_2_MEMORY_READ_BIT);
+        const VkDependencyInfo read_dependency_info = vk_lib::dependency_info(&read_image_memory_barrier, nullptr, nullptr);
+        vkCmdPipelineBarrier2(command_buffer, &read_dependency_info);
+    }
+
+    return upload_manager->submitted_value + 1;
+}
+
+void upload_manager_flush(UploadManager* upload_manager) {
+    VkCommandBuffer command_buffer = upload_manager->recording_command_buffer;
+    if (command_buffer == nullptr) {
+        return;
+    }
+    TRACE_ZONE("upload_manager_flush");
+
+    VK_CHECK(vkEndCommandBuffer(command_buffer));
+
+    upload_manager->submitted_value++;
+
+    VkSemaphoreSubmitInfo signal_semaphore_submit_info =
+        vk_lib::semaphore_submit_info(upload_manager->timeline_semaphore, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT);
+    signal_semaphore_submit_info.value = upload_manager->submitted_value;
+
+    const VkCommandBufferSubmitInfo command_buffer_submit_info = vk_lib::command_buffer_submit_info(command_buffer);
+    VkSubmitInfo2                   submit_info_2              = vk_lib::submit_info_2(&command_buffer_submit_info);
+    submit_info_2.signalSemaphoreInfoCount                     = 1;
+    submit_info_2.pSignalSemaphoreInfos                        = &signal_semaphore_submit_info;
+    VK_CHECK(vkQueueSubmit2(upload_manager->queue, 1, &submit_info_2, nullptr));
+
+    upload_manager->submitted_batches.push_back({command_buffer, upload_manager->submitted_value, upload_manager->staging_head});
+    upload_manager->recording_command_buffer = nullptr;
+}
+
+bool upload_manager_is_complete(const UploadManager* upload_manager, UploadTicket ticket) {
+    uint64_t completed_value;
+    VK_CHECK(vkGetSemaphoreCounterValue(upload_manager->device, upload_manager->timeline_semaphore, &completed_value));
+    return completed_value >= ticket;
+}
+
+void upload_manager_wait(UploadManager* upload_manager, UploadTicket ticket) {
+    if (ticket > upload_manager->submitted_value) {
+        upload_manager_flush(upload_manager);
+    }
+    wait_for_value(upload_manager, ticket);
+    retire_completed_batches(upload_manager);
+}
+
+uint64_t upload_manager_record_acquires(UploadManager* upload_manager, VkCommandBuffer command_buffer) {
+    upload_manager_flush(upload_manager);
+
+    if (!upload_manager->pending_buffer_acquires.empty() || !upload_manager->pending_image_acquires.empty()) {
+        const VkDependencyInfo acquire_dependency_info =
+            vk_lib::dependency_info_batch(upload_manager->pending_image_acquires, upload_manager->pending_buffer_acquires, {});
+        vkCmdPipelineBarrier2(command_buffer, &acquire_dependency_info);
+
+        upload_manager->pending_buffer_acquires.clear();
+        upload_manager->pending_image_acquires.clear();
+    }
+
+    return upload_manager->submitted_value;
+}
+
+void upload_manager_forget_buffer(UploadManager* upload_manager, VkBuffer buffer) {
+    std::erase_if(upload_manager->pending_buffer_acquires, [&](const VkBufferMemoryBarrier2& barrier) { return barrier.buffer == buffer; });
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "common.h"
+
+#include <deque>
+#include <span>
+
+// host to device uploads through a persistently mapped staging ring. copies are batched into one command buffer on the
+// transfer queue and submitted without waiting. every submitted batch signals the next value of timeline_semaphore, and an
+// UploadTicket is the value whose batch holds the upload
+using UploadTicket = uint64_t;
+
+// submitted batch. its staging range is free again once timeline_value has been reached
+struct UploadBatch {
+    VkCommandBuffer command_buffer{};
+    uint64_t        timeline_value{};
+    VkDeviceSize    staging_end{};
+};
+
+struct UploadManager {
+    VkDevice      device{};
+    VmaAllocator  allocator{};
+    VkQueue       queue{};
+    uint32_t      queue_family{};
+    uint32_t      graphics_queue_family{};
+    VkCommandPool command_pool{};
+    VkSemaphore   timeline_semaphore{};
+    // value signaled by the last submitted batch
+    uint64_t submitted_value{};
+
+    // head and tail only ever grow. staging_head % staging_capacity is where the next upload goes
+    AllocatedBuffer staging_buffer{};
+    VkDeviceSize    staging_capacity{};
+    VkDeviceSize    staging_head{};
+    VkDeviceSize    staging_tail{};
+
+    // the batch being recorded, null until something is uploaded
+    VkCommandBuffer              recording_command_buffer{};
+    std::deque<UploadBatch>      submitted_batches{};
+    std::vector<VkCommandBuffer> free_command_buffers{};
+
+    // with a dedicated transfer family every upload is released to the graphics family. these are the matching acquires,
+    // recorded into the next graphics command buffer
+    std::vector<VkBufferMemoryBarrier2> pending_buffer_acquires{};
+    std::vector<VkImageMemoryBarrier2>  pending_image_acquires{};
+};
+
+void upload_manager_create(UploadManager* upload_manager, VkDevice device, VmaAllocator allocator, VkQueue queue, uint32_t queue_family,
+                           uint32_t graphics_queue_family, VkDeviceSize staging_capacity);
+
+// uploads larger than a quarter of the staging ring are split across several copies. the ticket can be dropped when the
+// data is only read by frames, since those already wait for every upload released before they were recorded
+UploadTicket upload_manager_upload_buffer(UploadManager* upload_manager, VkBuffer buffer, VkDeviceSize offset, std::span<const std::byte> data);
+
+// fills one mip of a single layer color image and leaves it in final_layout. extent is the mip's. data has to fit in a
+// quarter of the staging ring
+UploadTicket upload_manager_upload_image(UploadManager* upload_manager, VkImage image, uint32_t mip_level, VkExtent3D extent,
+                                         std::span<const std::byte> data, VkImageLayout final_layout);
+
+// submits the batch being recorded, if any
+void upload_manager_flush(UploadManager* upload_manager);
+
+[[nodiscard]] bool upload_manager_is_complete(const UploadManager* upload_manager, UploadTicket ticket);
+
+// flushes first when the ticket's batch hasn't been submitted yet
+void upload_manager_wait(UploadManager* upload_manager, UploadTicket ticket);
+
+// flushes and records the acquire side of every upload released so far. the submit of command_buffer has to wait on
+// timeline_semaphore for the returned value
+[[nodiscard]] uint64_t upload_manager_record_acquires(UploadManager* upload_manager, VkCommandBuffer command_buffer);
+
+// drops the pending acquire of a buffer that's destroyed before the next graphics command buffer is recorded
+void upload_manager_forget_buffer(UploadManager* upload_manager, VkBuffer buffer);
@@ -1,11 +1,17 @@
 #include "vk_context.h"
 
-VkInstance create_instance() {
-    if (!glfwVulkanSupported()) {
-        abort_message("GLFW cannot find the vulkan loader and an ICD");
+#include <cstring>
+#include <span>
+
+VkInstance create_instance(bool headless) {
+    uint32_t     glfw_extension_count = 0;
+    const char** glfw_extensions      = nullptr;
+    if (!headless) {
+        if (!glfwVulkanSupported()) {
+            abort_message("GLFW cannot find the vulkan loader and an ICD");
+        }
+        glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
     }
-    uint32_t                 glfw_extension_count = 0;
-    const char**             glfw_extensions      = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
     std::vector<const char*> extensions{};
     extensions.reserve(glfw_extension_count + 2);
     extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
@@ -28,8 +34,21 @@ VkInstance create_instance() {
     return instance;
 }
 
+// features every path relies on. optional ones are looked up in vk_context_create and only enabled when supported
+static bool supports_required_features(VkPhysicalDevice physical_device) {
+    VkPhysicalDeviceVulkan12Features vk_1_2_features = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+    VkPhysicalDeviceVulkan11Features vk_1_1_features = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES};
+    VkPhysicalDeviceFeatures2        features_2      = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+    vk_1_1_features.pNext                            = &vk_1_2_features;
+    features_2.pNext                                 = &vk_1_1_features;
+    vkGetPhysicalDeviceFeatures2(physical_device, &features_2);
+
+    // the arena copy reads 16 bit index buffers to widen them, and uploads are tracked with a timeline semaphore
+    return vk_1_1_features.storageBuffer16BitAccess && vk_1_2_features.timelineSemaphore;
+}
+
 static VkPhysicalDevice select_physical_device(VkInstance instance) {
-    // Find a device that supports vulkan 1.3. Prefer discrete GPU's
+    // Find a device that supports vulkan 1.3 and the required features. Prefer discrete GPU's
     std::vector<VkPhysicalDevice> physical_devices;
 
     uint32_t physical_device_count = 0;
@@ -41,7 +60,7 @@ static VkPhysicalDevice select_physical_device(VkInstance instance) {
     for (const VkPhysicalDevice& physical_device : physical_devices) {
         VkPhysicalDeviceProperties properties;
         vkGetPhysicalDeviceProperties(physical_device, &properties);
-        if (properties.apiVersion < VK_API_VERSION_1_3) {
+        if (properties.apiVersion < VK_API_VERSION_1_3 || !supports_required_features(physical_device)) {
             continue;
         }
         chosen_device = physical_device;
@@ -63,10 +82,13 @@ static uint32_t select_queue_family(VkPhysicalDevice physical_device, VkSurfaceK
     queue_family_properties.resize(family_property_count);
     vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_property_count, queue_family_properties.data());
 
-    // Find a queue family with both graphics and presentation capabilities
+    // Find a queue family with both graphics and presentation capabilities. Without a surface, any graphics family will do
     for (uint32_t i = 0; i < queue_family_properties.size(); i++) {
         const VkQueueFamilyProperties* family_properties = &queue_family_properties[i];
         if (family_properties->queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+            if (surface == nullptr) {
+                return i;
+            }
             VkBool32 present_supported = VK_FALSE;
             vkGetPhysicalDeviceSurfaceSupportKHR(physical_device, i, surface, &present_supported);
             if (present_supported) {
@@ -77,13 +99,71 @@ static uint32_t select_queue_family(VkPhysicalDevice physical_device, VkSurfaceK
     abort_message("Could not find a queue family with both graphics and presentation supported.");
 }
 
-VkDevice create_logical_device(VkPhysicalDevice physical_device, uint32_t queue_family) {
-    std::array              queue_priorities   = {1.f};
-    VkDeviceQueueCreateInfo queue_ci           = vk_lib::device_queue_create_info(queue_family, queue_priorities);
-    std::array              queue_create_infos = {queue_ci};
+// first family that has the wanted flags and none of the excluded ones. returns fallback_queue_family when there's none
+static uint32_t select_dedicated_queue_family(VkPhysicalDevice physical_device, VkQueueFlags wanted_flags, VkQueueFlags excluded_flags,
+                                              uint32_t fallback_queue_family) {
+    std::vector<VkQueueFamilyProperties> queue_family_properties;
+    uint32_t                             family_property_count;
+
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_property_count, nullptr);
+    queue_family_properties.resize(family_property_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_property_count, queue_family_properties.data());
+
+    for (uint32_t i = 0; i < queue_family_properties.size(); i++) {
+        const VkQueueFlags queue_flags = queue_family_properties[i].queueFlags;
+        if ((queue_flags & wanted_flags) == wanted_flags && (queue_flags & excluded_flags) == 0) {
+            return i;
+        }
+    }
+    return fallback_queue_family;
+}
+
+static uint32_t queue_family_queue_count(VkPhysicalDevice physical_device, uint32_t queue_family) {
+    std::vector<VkQueueFamilyProperties> queue_family_properties;
+    uint32_t                             family_property_count;
+
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_property_count, nullptr);
+    queue_family_properties.resize(family_property_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_property_count, queue_family_properties.data());
+
+    return queue_family_properties[queue_family].queueCount;
+}
 
-    std::array device_extensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME,
-                                    VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME, VK_KHR_SHADER_RELAXED_EXTENDED_INSTRUCTION_EXTENSION_NAME};
+static bool device_supports_extension(VkPhysicalDevice physical_device, const char* extension_name) {
+    std::vector<VkExtensionProperties> extension_properties;
+    uint32_t                           extension_count;
+
+    VK_CHECK(vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extension_count, nullptr));
+    extension_properties.resize(extension_count);
+    VK_CHECK(vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extension_count, extension_properties.data()));
+
+    return std::ranges::any_of(extension_properties,
+                               [&](const VkExtensionProperties& properties) { return strcmp(properties.extensionName, extension_name) == 0; });
+}
+
+// one queue from every distinct family in queue_families, except the graphics family queue_families[0] which gets
+// graphics_queue_count. the queues after the first one are for background loading and run at a lower priority
+// optional features and extensions are enabled when vk_context says the device has them
+VkDevice create_logical_device(const VkContext* vk_context, std::span<const uint32_t> queue_families, uint32_t graphics_queue_count, bool headless) {
+    std::array         queue_priorities = {1.f};
+    std::vector<float> graphics_queue_priorities(graphics_queue_count, 0.5f);
+    graphics_queue_priorities[0] = 1.f;
+
+    std::vector<VkDeviceQueueCreateInfo> queue_create_infos = {vk_lib::device_queue_create_info(queue_families[0], graphics_queue_priorities)};
+    for (uint32_t i = 1; i < queue_families.size(); i++) {
+        if (std::find(queue_families.begin(), queue_families.begin() + i, queue_families[i]) == queue_families.begin() + i) {
+            queue_create_infos.push_back(vk_lib::device_queue_create_info(queue_families[i], queue_priorities));
+        }
+    }
+
+    std::vector<const char*> device_extensions = {VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME,
+                                                  VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME, VK_KHR_SHADER_RELAXED_EXTENDED_INSTRUCTION_EXTENSION_NAME};
+    if (!headless) {
+        device_extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    }
+    if (vk_context->memory_budget) {
+        device_extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
 
     VkPhysicalDeviceVulkan13Features vk_1_3_features = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES};
     vk_1_3_features.dynamicRendering                 = VK_TRUE;
@@ -92,36 +172,100 @@ VkDevice create_logical_device(VkPhysicalDevice physical_device, uint32_t queue_
     VkPhysicalDeviceVulkan12Features vk_1_2_features              = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
     vk_1_2_features.descriptorBindingVariableDescriptorCount      = VK_TRUE;
     vk_1_2_features.descriptorBindingUniformBufferUpdateAfterBind = VK_TRUE;
+    vk_1_2_features.descriptorBindingSampledImageUpdateAfterBind  = VK_TRUE;
+    vk_1_2_features.descriptorBindingUpdateUnusedWhilePending     = VK_TRUE;
     vk_1_2_features.shaderSampledImageArrayNonUniformIndexing     = VK_TRUE;
     vk_1_2_features.runtimeDescriptorArray                        = VK_TRUE;
     vk_1_2_features.bufferDeviceAddress                           = VK_TRUE;
     vk_1_2_features.descriptorIndexing                            = VK_TRUE;
     vk_1_2_features.scalarBlockLayout                             = VK_TRUE;
+    vk_1_2_features.drawIndirectCount                             = vk_context->draw_indirect_count;
+    vk_1_2_features.timelineSemaphore                             = VK_TRUE;
     vk_1_2_features.pNext                                         = &vk_1_3_features;
 
-    VkPhysicalDeviceFeatures2 physical_device_features_2  = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR};
-    physical_device_features_2.features.samplerAnisotropy = VK_TRUE;
-    physical_device_features_2.pNext                      = &vk_1_2_features;
+    // 16 bit index buffers are widened to 32 bits on the gpu when they're copied into the geometry arena
+    VkPhysicalDeviceVulkan11Features vk_1_1_features = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES};
+    vk_1_1_features.storageBuffer16BitAccess         = VK_TRUE;
+    vk_1_1_features.pNext                            = &vk_1_2_features;
+
+    VkPhysicalDeviceFeatures2 physical_device_features_2          = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR};
+    physical_device_features_2.features.samplerAnisotropy         = VK_TRUE;
+    physical_device_features_2.features.drawIndirectFirstInstance = vk_context->draw_indirect_count;
+    physical_device_features_2.features.textureCompressionBC      = vk_context->texture_compression_bc;
+    // the tone map stores into the swapchain or headless target without naming its format
+    physical_device_features_2.features.shaderStorageImageWriteWithoutFormat = vk_context->storage_write_without_format;
+    physical_device_features_2.pNext                                         = &vk_1_1_features;
 
     VkDeviceCreateInfo device_ci = vk_lib::device_create_info(queue_create_infos, device_extensions, nullptr, &physical_device_features_2);
     VkDevice           device;
 
-    VK_CHECK(vkCreateDevice(physical_device, &device_ci, nullptr, &device));
+    VK_CHECK(vkCreateDevice(vk_context->physical_device, &device_ci, nullptr, &device));
 
     volkLoadDevice(device);
 
     return device;
 }
 
-VkContext vk_context_create(GLFWwindow* window) {
+VkContext vk_context_create(GLFWwindow* window, bool async_compute) {
+    // no window means headless: no surface, no swapchain extension and no presentation requirement on the queue
+    const bool headless = window == nullptr;
+
     VkContext vk_context{};
-    vk_context.instance        = create_instance();
+    vk_context.instance        = create_instance(headless);
     vk_context.physical_device = select_physical_device(vk_context.instance);
-    VK_CHECK(glfwCreateWindowSurface(vk_context.instance, window, nullptr, &vk_context.surface));
+    if (!headless) {
+        VK_CHECK(glfwCreateWindowSurface(vk_context.instance, window, nullptr, &vk_context.surface));
+    }
     // only using one queue family for now. we need graphics and present on the same family
     vk_context.queue_family = select_queue_family(vk_context.physical_device, vk_context.surface);
-    vk_context.device       = create_logical_device(vk_context.physical_device, vk_context.queue_family);
+    // post processing can run on a second, compute only family. without one everything stays on the graphics queue
+    vk_context.compute_queue_family = vk_context.queue_family;
+    if (async_compute) {
+        vk_context.compute_queue_family =
+            select_dedicated_queue_family(vk_context.physical_device, VK_QUEUE_COMPUTE_BIT, VK_QUEUE_GRAPHICS_BIT, vk_context.queue_family);
+        if (vk_context.compute_queue_family == vk_context.queue_family) {
+            std::cout << "Async compute disabled: no compute only queue family" << std::endl;
+        }
+    }
+    // uploads go through the copy engine when there is one, so they don't queue up behind rendering
+    vk_context.transfer_queue_family = select_dedicated_queue_family(vk_context.physical_device, VK_QUEUE_TRANSFER_BIT,
+                                                                     VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT, vk_context.queue_family);
+
+    // spare queues of the graphics family let asset loads submit their uploads without locking the queue frames go to
+    const uint32_t loader_queue_count =
+        std::min(queue_family_queue_count(vk_context.physical_device, vk_context.queue_family) - 1, max_loader_queue_count);
+
+    // without it vma estimates the budget from the heap sizes and what it allocated itself
+    vk_context.memory_budget = device_supports_extension(vk_context.physical_device, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+    VkPhysicalDeviceVulkan12Features supported_1_2_features = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+    VkPhysicalDeviceFeatures2        supported_features_2   = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+    supported_features_2.pNext                              = &supported_1_2_features;
+    vkGetPhysicalDeviceFeatures2(vk_context.physical_device, &supported_features_2);
+
+    vk_context.texture_compression_bc       = supported_features_2.features.textureCompressionBC;
+    vk_context.draw_indirect_count          = supported_1_2_features.drawIndirectCount && supported_features_2.features.drawIndirectFirstInstance;
+    vk_context.storage_write_without_format = supported_features_2.features.shaderStorageImageWriteWithoutFormat;
+
+    const std::array queue_families = {vk_context.queue_family, vk_context.compute_queue_family, vk_context.transfer_queue_family};
+    vk_context.device               = create_logical_device(&vk_context, queue_families, loader_queue_count + 1, headless);
     vkGetDeviceQueue(vk_context.device, vk_context.queue_family, 0, &vk_context.graphics_queue);
     vkGetDeviceQueue(vk_context.device, vk_context.queue_family, 0, &vk_context.present_queue);
+    vkGetDeviceQueue(vk_context.device, vk_context.compute_queue_family, 0, &vk_context.compute_queue);
+    vkGetDeviceQueue(vk_context.device, vk_context.transfer_queue_family, 0, &vk_context.transfer_queue);
+    vk_context.loader_queues.resize(loader_queue_count);
+    for (uint32_t i = 0; i < loader_queue_count; i++) {
+        vkGetDeviceQueue(vk_context.device, vk_context.queue_family, i + 1, &vk_context.loader_queues[i]);
+    }
     return vk_context;
-}
\ No newline at end of file
+}
+
+void vk_context_wait_idle(const VkContext* vk_context) {
+    VK_CHECK(vkQueueWaitIdle(vk_context->graphics_queue));
+    if (vk_context->compute_queue != vk_context->graphics_queue) {
+        VK_CHECK(vkQueueWaitIdle(vk_context->compute_queue));
+    }
+    if (vk_context->transfer_queue != vk_context->graphics_queue) {
+        VK_CHECK(vkQueueWaitIdle(vk_context->transfer_queue));
+    }
+}
@@ -10,6 +10,36 @@ struct VkContext {
     VkQueue          present_queue{};
     uint32_t         queue_family{};
     VkSurfaceKHR     surface{};
+    // a compute only family when async compute was asked for and the device has one. otherwise these alias the graphics
+    // queue, its family and frame_command_pool
+    VkCommandPool compute_command_pool{};
+    VkQueue       compute_queue{};
+    uint32_t      compute_queue_family{};
+    // a transfer only family, usually the copy engine, when the device has one. otherwise the graphics queue and its family
+    VkQueue  transfer_queue{};
+    uint32_t transfer_queue_family{};
+    // spare queues of the graphics family, one per background asset load. empty when the family only has one queue
+    std::vector<VkQueue> loader_queues{};
+    // VK_EXT_memory_budget is enabled, so vma reports the driver's per heap usage and budget
+    bool memory_budget{};
+    // bc1 through bc7 can be sampled
+    bool texture_compression_bc{};
+    // vkCmdDrawIndexedIndirectCount and indirect draws with a non zero firstInstance, which gpu driven drawing needs
+    bool draw_indirect_count{};
+    // storage images can be written without a format qualifier, which the compute tone map relies on
+    bool storage_write_without_format{};
 };
 
-[[nodiscard]] VkContext vk_context_create(GLFWwindow* window);
+// caps the number of asset loads running at once
+inline constexpr uint32_t max_loader_queue_count = 4;
+
+// a null window creates a headless context without a surface or swapchain support
+[[nodiscard]] VkContext vk_context_create(GLFWwindow* window, bool async_compute);
+
+[[nodiscard]] inline bool vk_context_has_async_compute(const VkContext* vk_context) {
+    return vk_context->compute_queue_family != vk_context->queue_family;
+}
+
+// waits for the queues the main thread submits to. vkDeviceWaitIdle would also touch the loader queues, which belong to
+// the asset loader's workers
+void vk_context_wait_idle(const VkContext* vk_context);